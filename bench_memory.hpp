@@ -0,0 +1,551 @@
+// Shared memory setup for the synthetic benchmarks (zipf_bench, stream_bench).
+//
+// Both benchmarks map one anonymous region and fault it in before the timed
+// loop. Doing that from the main thread takes minutes for 50+ GiB and puts
+// every page on the main thread's NUMA node. populate() instead lets each
+// pinned worker first-touch the part of the region it will access, so pages
+// land on the node that uses them and faults proceed in parallel.
+//
+//   --populate=serial        main thread touches one byte per page (old behaviour)
+//   --populate=parallel      worker t first-touches parts[t] from CPU cpu_start+t
+//   --populate=madv_populate like parallel, but each worker uses
+//                            madvise(MADV_POPULATE_WRITE) (Linux 5.14+) instead of
+//                            touching, falling back to touching if unsupported
+//   --populate=map_populate  MAP_POPULATE at mmap time (kernel, calling thread)
+//
+// map_region() also picks the page backing:
+//
+//   --page-backing=4k      plain anonymous memory (default)
+//   --page-backing=thp     2 MiB-aligned mapping + madvise(MADV_HUGEPAGE)
+//   --page-backing=huge2m  MAP_HUGETLB | MAP_HUGE_2MB (needs nr_hugepages)
+//   --page-backing=huge1g  MAP_HUGETLB | MAP_HUGE_1GB
+//
+// Region::page is the logical page size the benchmarks index by (2 MiB for
+// thp). A failed hugetlb mapping falls back to 4k; backing_report() reads
+// /proc/self/smaps to say what the kernel actually gave us. map_region() also
+// applies the --numa policy (see the NUMA section below).
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+namespace bench_memory {
+
+// Stride used when touching pages. Touching every base page is also correct
+// for huge pages (the first write faults the whole page in) and for THP that
+// silently fell back to 4 KiB.
+constexpr size_t kBasePage = 4096;
+
+enum class Populate { kSerial, kParallel, kMadvPopulate, kMapPopulate };
+
+inline bool parse_populate(const char* s, Populate* out) {
+  if (std::strcmp(s, "serial") == 0) {
+    *out = Populate::kSerial;
+  } else if (std::strcmp(s, "parallel") == 0) {
+    *out = Populate::kParallel;
+  } else if (std::strcmp(s, "madv_populate") == 0) {
+    *out = Populate::kMadvPopulate;
+  } else if (std::strcmp(s, "map_populate") == 0) {
+    *out = Populate::kMapPopulate;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline const char* populate_name(Populate p) {
+  switch (p) {
+    case Populate::kSerial: return "serial";
+    case Populate::kParallel: return "parallel";
+    case Populate::kMadvPopulate: return "madv_populate";
+    case Populate::kMapPopulate: return "map_populate";
+  }
+  return "?";
+}
+
+enum class Backing { k4k, kThp, kHuge2m, kHuge1g };
+
+inline bool parse_backing(const char* s, Backing* out) {
+  if (std::strcmp(s, "4k") == 0) {
+    *out = Backing::k4k;
+  } else if (std::strcmp(s, "thp") == 0) {
+    *out = Backing::kThp;
+  } else if (std::strcmp(s, "huge2m") == 0) {
+    *out = Backing::kHuge2m;
+  } else if (std::strcmp(s, "huge1g") == 0) {
+    *out = Backing::kHuge1g;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline const char* backing_name(Backing b) {
+  switch (b) {
+    case Backing::k4k: return "4k";
+    case Backing::kThp: return "thp";
+    case Backing::kHuge2m: return "huge2m";
+    case Backing::kHuge1g: return "huge1g";
+  }
+  return "?";
+}
+
+inline size_t backing_page_bytes(Backing b) {
+  switch (b) {
+    case Backing::k4k: return kBasePage;
+    case Backing::kThp:
+    case Backing::kHuge2m: return size_t{2} << 20;
+    case Backing::kHuge1g: return size_t{1} << 30;
+  }
+  return kBasePage;
+}
+
+inline void pin_to_cpu(int cpu) {
+  if (cpu < 0) return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  (void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// A byte range [lo, lo + bytes) that one worker first-touches.
+struct Range {
+  char* lo;
+  size_t bytes;
+};
+
+inline void touch_range(const Range& r) {
+  volatile char* p = r.lo;
+  for (size_t off = 0; off < r.bytes; off += kBasePage) p[off] = 1;
+}
+
+// Per-worker ranges.
+using Parts = std::vector<std::vector<Range>>;
+
+// Append to `parts` the share of [base, base + bytes) that each of `threads`
+// workers accesses when the region is cut into equal contiguous chunks of
+// `unit`-byte elements (stream_bench's chunk pattern). Chunk edges round down
+// to a `page` boundary and the final edge rounds up, so every range is page
+// aligned and neighbouring workers within one region never share a page.
+// `base + bytes` rounded up must stay inside the mapping.
+inline void add_chunks(Parts* parts, char* base, size_t bytes, int threads, size_t unit, size_t page) {
+  parts->resize(std::max<size_t>(parts->size(), static_cast<size_t>(threads)));
+  const size_t n = bytes / unit;
+  const size_t chunk = (n + static_cast<size_t>(threads) - 1) / static_cast<size_t>(threads);
+  auto edge = [&](size_t elem) {
+    const uintptr_t addr = reinterpret_cast<uintptr_t>(base) + ((elem >= n) ? bytes : elem * unit);
+    return (elem >= n) ? (addr + page - 1) / page * page : addr / page * page;
+  };
+  for (int t = 0; t < threads; t++) {
+    const uintptr_t lo = edge(static_cast<size_t>(t) * chunk);
+    const uintptr_t hi = edge(static_cast<size_t>(t + 1) * chunk);
+    if (hi > lo) (*parts)[static_cast<size_t>(t)].push_back({reinterpret_cast<char*>(lo), hi - lo});
+  }
+}
+
+// Even page-aligned split of the whole region.
+inline Parts split_even(char* base, size_t bytes, int threads, size_t page) {
+  Parts parts;
+  add_chunks(&parts, base, bytes, threads, page, page);
+  return parts;
+}
+
+inline size_t round_up(size_t v, size_t a) { return (v + a - 1) / a * a; }
+
+// ---- NUMA placement --------------------------------------------------------
+//
+// Policies are set with raw mbind(2) on the region before it is populated, so
+// no libnuma is needed:
+//
+//   --numa=local             no policy: pages land where they are first touched
+//   --numa=interleave[:N]    MPOL_INTERLEAVE over nodes N (default: all memory nodes)
+//   --numa=bind:N            MPOL_BIND to nodes N, e.g. bind:1 or bind:0,2-3
+//   --numa=split:R[:F,S]     first R of the region bound to node F ("fast"), the
+//                            rest to node S ("slow"), split on a page boundary.
+//                            Default F = lowest node with CPUs, S = lowest
+//                            memory-only node (CXL/far memory) or else the next
+//                            memory node.
+//
+// numa_report() asks move_pages(2) where the pages actually are.
+
+enum class NumaMode { kLocal, kInterleave, kBind, kSplit };
+
+struct NumaPolicy {
+  NumaMode mode = NumaMode::kLocal;
+  std::vector<int> nodes;      // interleave/bind; split: {fast, slow} (empty => discover)
+  double fast_fraction = 0.0;  // split only
+};
+
+constexpr int kMaxNodes = 1024;
+constexpr int kMpolBind = 2;        // MPOL_BIND
+constexpr int kMpolInterleave = 3;  // MPOL_INTERLEAVE
+
+// "0,2-3" -> {0, 2, 3}.
+inline bool parse_node_list(const std::string& s, std::vector<int>* out) {
+  out->clear();
+  std::stringstream ss(s);
+  std::string part;
+  while (std::getline(ss, part, ',')) {
+    if (part.empty()) return false;
+    char* end = nullptr;
+    const long lo = std::strtol(part.c_str(), &end, 10);
+    long hi = lo;
+    if (*end == '-') hi = std::strtol(end + 1, &end, 10);
+    if (*end != '\0' || lo < 0 || hi < lo || hi >= kMaxNodes) return false;
+    for (long n = lo; n <= hi; n++) out->push_back(static_cast<int>(n));
+  }
+  return !out->empty();
+}
+
+inline bool parse_numa(const char* s, NumaPolicy* out) {
+  const std::string v(s);
+  NumaPolicy p;
+  if (v == "local") {
+    p.mode = NumaMode::kLocal;
+  } else if (v == "interleave") {
+    p.mode = NumaMode::kInterleave;
+  } else if (v.compare(0, 11, "interleave:") == 0) {
+    p.mode = NumaMode::kInterleave;
+    if (!parse_node_list(v.substr(11), &p.nodes)) return false;
+  } else if (v.compare(0, 5, "bind:") == 0) {
+    p.mode = NumaMode::kBind;
+    if (!parse_node_list(v.substr(5), &p.nodes)) return false;
+  } else if (v.compare(0, 6, "split:") == 0) {
+    p.mode = NumaMode::kSplit;
+    const std::string rest = v.substr(6);
+    const size_t colon = rest.find(':');
+    char* end = nullptr;
+    const std::string ratio = rest.substr(0, colon);
+    p.fast_fraction = std::strtod(ratio.c_str(), &end);
+    if (ratio.empty() || *end != '\0' || !(p.fast_fraction >= 0.0 && p.fast_fraction <= 1.0)) return false;
+    if (colon != std::string::npos) {
+      if (!parse_node_list(rest.substr(colon + 1), &p.nodes) || p.nodes.size() != 2) return false;
+    }
+  } else {
+    return false;
+  }
+  *out = p;
+  return true;
+}
+
+// Node list from a sysfs file such as /sys/devices/system/node/has_memory.
+inline std::vector<int> read_node_list(const char* path) {
+  std::ifstream in(path);
+  std::string line;
+  std::vector<int> nodes;
+  if (std::getline(in, line)) {
+    while (!line.empty() && (line.back() == '\n' || line.back() == ' ')) line.pop_back();
+    if (!parse_node_list(line, &nodes)) nodes.clear();
+  }
+  return nodes;
+}
+
+inline std::string node_list_str(const std::vector<int>& nodes) {
+  std::string s;
+  for (size_t i = 0; i < nodes.size(); i++) s += (i ? "," : "") + std::to_string(nodes[i]);
+  return s;
+}
+
+// Fill in nodes left to discovery. Returns false (with *err) if the machine
+// cannot satisfy the policy.
+inline bool resolve_numa(NumaPolicy* p, std::string* err) {
+  if (p->mode == NumaMode::kLocal || !p->nodes.empty()) return true;
+  std::vector<int> mem = read_node_list("/sys/devices/system/node/has_memory");
+  if (mem.empty()) mem = read_node_list("/sys/devices/system/node/online");
+  if (mem.empty()) {
+    *err = "--numa: cannot read NUMA nodes from /sys/devices/system/node";
+    return false;
+  }
+  if (p->mode == NumaMode::kInterleave) {
+    p->nodes = mem;
+    return true;
+  }
+  // split: fast = lowest node with CPUs; slow = lowest memory-only node, else
+  // the next memory node after fast.
+  const std::vector<int> cpu = read_node_list("/sys/devices/system/node/has_cpu");
+  const int fast = cpu.empty() ? mem.front() : cpu.front();
+  int slow = -1;
+  for (int n : mem) {
+    if (n != fast && std::find(cpu.begin(), cpu.end(), n) == cpu.end()) {
+      slow = n;
+      break;
+    }
+  }
+  for (size_t i = 0; slow < 0 && i < mem.size(); i++) {
+    if (mem[i] > fast) slow = mem[i];
+  }
+  if (slow < 0) {
+    *err = "--numa=split needs two memory nodes (only " + node_list_str(mem) + " found)";
+    return false;
+  }
+  p->nodes = {fast, slow};
+  return true;
+}
+
+inline std::string numa_name(const NumaPolicy& p) {
+  switch (p.mode) {
+    case NumaMode::kLocal: return "local";
+    case NumaMode::kInterleave: return "interleave:" + node_list_str(p.nodes);
+    case NumaMode::kBind: return "bind:" + node_list_str(p.nodes);
+    case NumaMode::kSplit: {
+      std::ostringstream os;
+      os << "split:" << p.fast_fraction << ":" << node_list_str(p.nodes);
+      return os.str();
+    }
+  }
+  return "?";
+}
+
+inline bool mbind_nodes(char* addr, size_t len, int mode, const std::vector<int>& nodes, std::string* err) {
+  if (len == 0) return true;
+  unsigned long mask[kMaxNodes / (8 * sizeof(unsigned long))] = {};
+  for (int n : nodes) mask[n / (8 * sizeof(unsigned long))] |= 1UL << (n % (8 * sizeof(unsigned long)));
+  if (syscall(SYS_mbind, addr, len, mode, mask, static_cast<unsigned long>(kMaxNodes) + 1, 0U) != 0) {
+    *err = std::string("mbind(") + node_list_str(nodes) + ") failed: " + std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+// Apply `p` to [base, base + bytes). Split points round to `page`.
+inline bool apply_numa(char* base, size_t bytes, size_t page, const NumaPolicy& p, std::string* err) {
+  switch (p.mode) {
+    case NumaMode::kLocal: return true;
+    case NumaMode::kInterleave: return mbind_nodes(base, bytes, kMpolInterleave, p.nodes, err);
+    case NumaMode::kBind: return mbind_nodes(base, bytes, kMpolBind, p.nodes, err);
+    case NumaMode::kSplit: {
+      const size_t fast = std::min(bytes, round_up(static_cast<size_t>(p.fast_fraction * bytes), page));
+      return mbind_nodes(base, fast, kMpolBind, {p.nodes[0]}, err) &&
+             mbind_nodes(base + fast, bytes - fast, kMpolBind, {p.nodes[1]}, err);
+    }
+  }
+  return true;
+}
+
+// One anonymous mapping. `bytes` is a multiple of `page`.
+struct Region {
+  char* base = nullptr;
+  size_t bytes = 0;
+  size_t page = kBasePage;
+  Backing backing = Backing::k4k;  // what was mapped (may differ from the request)
+  std::string note;                // why it differs, if it does
+
+  void unmap() {
+    if (base) munmap(base, bytes);
+    base = nullptr;
+  }
+};
+
+// Map at least `min_bytes` (rounded up to the backing's page size) with the
+// requested backing and NUMA policy. A hugetlb request that the kernel refuses
+// is retried as 4k and noted in Region::note. Populate::kMapPopulate uses
+// MAP_POPULATE unless a policy or THP must be set first; then the region is
+// populated with MADV_POPULATE_WRITE right after.
+inline bool map_region(size_t min_bytes, Backing want, Populate p, const NumaPolicy& numa, Region* out,
+                       std::string* err) {
+  const bool late_populate =
+      p == Populate::kMapPopulate && (want == Backing::kThp || numa.mode != NumaMode::kLocal);
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  if (p == Populate::kMapPopulate && !late_populate) flags |= MAP_POPULATE;
+  Region r;
+  r.backing = want;
+  r.page = backing_page_bytes(want);
+  r.bytes = round_up(std::max<size_t>(min_bytes, 1), r.page);
+
+  if (want == Backing::kHuge2m || want == Backing::kHuge1g) {
+    const int huge = MAP_HUGETLB | (want == Backing::kHuge2m ? MAP_HUGE_2MB : MAP_HUGE_1GB);
+    void* m = mmap(nullptr, r.bytes, PROT_READ | PROT_WRITE, flags | huge, -1, 0);
+    if (m != MAP_FAILED) {
+      r.base = static_cast<char*>(m);
+    } else {
+      r.note = std::string("MAP_HUGETLB failed (") + std::strerror(errno) +
+               "; check /sys/kernel/mm/hugepages/*/nr_hugepages), using 4k pages";
+      r.backing = Backing::k4k;
+      r.page = kBasePage;
+    }
+  }
+
+  if (!r.base && r.backing == Backing::kThp) {
+    // Over-map by one huge page and trim, so the region starts on a 2 MiB
+    // boundary and every logical page can be backed by one PMD.
+    const size_t span = r.bytes + r.page;
+    void* m = mmap(nullptr, span, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (m == MAP_FAILED) {
+      *err = std::string("mmap failed: ") + std::strerror(errno);
+      return false;
+    }
+    char* raw = static_cast<char*>(m);
+    char* aligned = reinterpret_cast<char*>(round_up(reinterpret_cast<uintptr_t>(raw), r.page));
+    if (aligned > raw) munmap(raw, static_cast<size_t>(aligned - raw));
+    char* tail = aligned + r.bytes;
+    if (raw + span > tail) munmap(tail, static_cast<size_t>(raw + span - tail));
+    r.base = aligned;
+    if (madvise(r.base, r.bytes, MADV_HUGEPAGE) != 0) {
+      r.note = std::string("MADV_HUGEPAGE failed (") + std::strerror(errno) + ")";
+    }
+  }
+
+  if (!r.base) {
+    void* m = mmap(nullptr, r.bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (m == MAP_FAILED) {
+      *err = std::string("mmap failed: ") + std::strerror(errno);
+      return false;
+    }
+    r.base = static_cast<char*>(m);
+  }
+
+  if (!apply_numa(r.base, r.bytes, r.page, numa, err)) {
+    r.unmap();
+    return false;
+  }
+  if (late_populate && madvise(r.base, r.bytes, MADV_POPULATE_WRITE) != 0) {
+    touch_range(Range{r.base, r.bytes});
+  }
+  *out = r;
+  return true;
+}
+
+// Where the region's pages are, by node, from move_pages(2) on one address per
+// logical page (at most `max_samples`, evenly strided). Call after populating.
+inline std::string numa_report(const Region& r, size_t max_samples = size_t{1} << 20) {
+  const size_t pages = r.bytes / r.page;
+  const size_t stride = std::max<size_t>(1, (pages + max_samples - 1) / max_samples);
+  std::vector<void*> addrs;
+  for (size_t i = 0; i < pages; i += stride) addrs.push_back(r.base + i * r.page);
+  std::vector<int> status(addrs.size(), -1);
+  constexpr size_t kBatch = 4096;
+  for (size_t i = 0; i < addrs.size(); i += kBatch) {
+    const size_t n = std::min(kBatch, addrs.size() - i);
+    if (syscall(SYS_move_pages, 0, n, addrs.data() + i, nullptr, status.data() + i, 0) != 0) {
+      return std::string("move_pages failed: ") + std::strerror(errno);
+    }
+  }
+  std::vector<size_t> per_node;
+  size_t absent = 0;
+  for (int st : status) {
+    if (st < 0) {
+      absent++;
+      continue;
+    }
+    if (static_cast<size_t>(st) >= per_node.size()) per_node.resize(static_cast<size_t>(st) + 1, 0);
+    per_node[static_cast<size_t>(st)]++;
+  }
+  std::ostringstream os;
+  os.setf(std::ios::fixed);
+  os.precision(1);
+  for (size_t n = 0; n < per_node.size(); n++) {
+    if (per_node[n] == 0) continue;
+    os << "node" << n << "=" << per_node[n] << " (" << 100.0 * per_node[n] / status.size() << "%) ";
+  }
+  if (absent) os << "not_present=" << absent << " ";
+  os << "[" << status.size() << " of " << pages << " pages sampled]";
+  return os.str();
+}
+
+// One line describing the backing the kernel gave `r`, from the smaps entries
+// of the VMAs overlapping it: kernel page size, RSS and (for THP) how much of
+// it sits in huge pages. Call after populating.
+inline std::string backing_report(const Region& r) {
+  std::ifstream in("/proc/self/smaps");
+  const uintptr_t lo = reinterpret_cast<uintptr_t>(r.base);
+  const uintptr_t hi = lo + r.bytes;
+  bool inside = false;
+  size_t rss_kb = 0, anon_huge_kb = 0, hugetlb_kb = 0, kernel_page_kb = 0;
+  std::string line;
+  while (std::getline(in, line)) {
+    uintptr_t vlo = 0, vhi = 0;
+    char dash = 0;
+    std::istringstream ls(line);
+    if (line.find(':') == std::string::npos || line.find('-') < line.find(':')) {
+      // VMA header: "start-end perms offset dev inode path".
+      if (ls >> std::hex >> vlo >> dash >> vhi && dash == '-') {
+        inside = vlo < hi && vhi > lo;
+        continue;
+      }
+    }
+    if (!inside) continue;
+    std::string key;
+    size_t kb = 0;
+    if (!(ls >> key >> std::dec >> kb)) continue;
+    if (key == "Rss:") rss_kb += kb;
+    else if (key == "AnonHugePages:") anon_huge_kb += kb;
+    else if (key == "Private_Hugetlb:" || key == "Shared_Hugetlb:") hugetlb_kb += kb;
+    else if (key == "KernelPageSize:") kernel_page_kb = std::max(kernel_page_kb, kb);
+  }
+
+  std::ostringstream os;
+  os << backing_name(r.backing) << " (logical page " << (r.page >> 10) << " KiB, kernel page "
+     << kernel_page_kb << " KiB";
+  if (r.backing == Backing::kThp) {
+    os << ", AnonHugePages " << anon_huge_kb << " of " << rss_kb << " KiB RSS";
+  } else if (r.backing == Backing::kHuge2m || r.backing == Backing::kHuge1g) {
+    os << ", hugetlb " << hugetlb_kb << " KiB";
+  } else {
+    os << ", RSS " << rss_kb << " KiB";
+  }
+  os << ")";
+  return os.str();
+}
+
+// Fault in every range of `parts` according to `p`. Worker t is pinned to
+// cpu_start + t (no pinning if cpu_start < 0). Returns a short note about any
+// fallback taken (empty if none).
+inline std::string populate(const Parts& parts, Populate p, int cpu_start) {
+  if (p == Populate::kMapPopulate) return "";
+  if (p == Populate::kSerial) {
+    for (const auto& rs : parts) {
+      for (const Range& r : rs) touch_range(r);
+    }
+    return "";
+  }
+
+  std::vector<int> madv_failed(parts.size(), 0);
+  auto work = [&](size_t t) {
+    pin_to_cpu(cpu_start < 0 ? -1 : cpu_start + static_cast<int>(t));
+    for (const Range& r : parts[t]) {
+      if (p == Populate::kMadvPopulate && madvise(r.lo, r.bytes, MADV_POPULATE_WRITE) == 0) continue;
+      if (p == Populate::kMadvPopulate) madv_failed[t] = errno;
+      touch_range(r);
+    }
+  };
+  std::vector<std::thread> th;
+  th.reserve(parts.size());
+  for (size_t t = 0; t < parts.size(); t++) th.emplace_back(work, t);
+  for (auto& x : th) x.join();
+
+  for (int e : madv_failed) {
+    if (e != 0) return std::string("MADV_POPULATE_WRITE failed (") + std::strerror(e) + "), touched pages instead";
+  }
+  return "";
+}
+
+}  // namespace bench_memory
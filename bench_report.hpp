@@ -0,0 +1,206 @@
+// Machine-readable run reports for the synthetic benchmarks (zipf_bench,
+// stream_bench), so the runners no longer have to scrape the human log.
+//
+//   --json=<path>        on exit, write a JSON summary: config, mapping range,
+//                        CLOCK_MONOTONIC timestamps, results, per-thread stats
+//   --ready-file=<path>  when the hot loop starts, write one line
+//                          ready pid=<pid> time_sec=<t> addr_lo=0x.. addr_hi=0x..
+//                        If <path> is a FIFO the line is written to it, and a
+//                        runner blocked in `read` wakes up exactly then.
+//                        Otherwise a regular file is created with rename(2), so
+//                        the file never appears half written.
+//
+// Addresses are written as hex strings, because JSON numbers above 2^53 lose
+// precision in most readers. Times are CLOCK_MONOTONIC seconds, the clock used
+// by `perf record -k CLOCK_MONOTONIC`.
+
+#pragma once
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bench_report {
+
+inline double monotonic_sec() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) * 1e-9;
+}
+
+inline std::string hex_addr(const void* p) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "0x%llx", static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(p)));
+  return buf;
+}
+
+// Minimal streaming JSON writer with two-space indentation. Keys are only
+// passed inside objects; begin/end calls must nest correctly.
+class Json {
+ public:
+  Json() { first_.push_back(true); }
+
+  Json& begin_object(const char* key = nullptr) { return open(key, '{'); }
+  Json& end_object() { return close('}'); }
+  Json& begin_array(const char* key = nullptr) { return open(key, '['); }
+  Json& end_array() { return close(']'); }
+
+  Json& field(const char* key, const std::string& v) {
+    item(key);
+    quote(v);
+    return *this;
+  }
+  Json& field(const char* key, const char* v) { return field(key, std::string(v)); }
+  Json& field(const char* key, bool v) {
+    item(key);
+    out_ += v ? "true" : "false";
+    return *this;
+  }
+  Json& field(const char* key, double v) {
+    item(key);
+    if (std::isfinite(v)) {
+      char buf[32];
+      std::snprintf(buf, sizeof(buf), "%.15g", v);
+      out_ += buf;
+    } else {
+      out_ += "null";
+    }
+    return *this;
+  }
+  Json& field(const char* key, uint64_t v) {
+    item(key);
+    out_ += std::to_string(v);
+    return *this;
+  }
+  Json& field(const char* key, int64_t v) {
+    item(key);
+    out_ += std::to_string(v);
+    return *this;
+  }
+  Json& field(const char* key, int v) { return field(key, static_cast<int64_t>(v)); }
+  Json& field(const char* key, unsigned v) { return field(key, static_cast<uint64_t>(v)); }
+  Json& field(const char* key, long long v) { return field(key, static_cast<int64_t>(v)); }
+  Json& field(const char* key, unsigned long long v) { return field(key, static_cast<uint64_t>(v)); }
+
+  // Array element (no key).
+  template <typename T>
+  Json& value(T v) {
+    return field(nullptr, v);
+  }
+
+  const std::string& str() const { return out_; }
+
+ private:
+  Json& open(const char* key, char c) {
+    item(key);
+    out_ += c;
+    first_.push_back(true);
+    return *this;
+  }
+
+  Json& close(char c) {
+    const bool empty = first_.back();
+    first_.pop_back();
+    if (!empty) newline();
+    out_ += c;
+    return *this;
+  }
+
+  void item(const char* key) {
+    if (!first_.back()) out_ += ',';
+    first_.back() = false;
+    if (first_.size() > 1) newline();
+    if (key) {
+      quote(key);
+      out_ += ": ";
+    }
+  }
+
+  void newline() {
+    out_ += '\n';
+    out_.append(2 * (first_.size() - 1), ' ');
+  }
+
+  void quote(const std::string& s) {
+    out_ += '"';
+    for (char ch : s) {
+      const unsigned char u = static_cast<unsigned char>(ch);
+      if (ch == '"' || ch == '\\') {
+        out_ += '\\';
+        out_ += ch;
+      } else if (u < 0x20) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\u%04x", u);
+        out_ += buf;
+      } else {
+        out_ += ch;
+      }
+    }
+    out_ += '"';
+  }
+
+  std::string out_;
+  std::vector<bool> first_;  // per open container: no element written yet
+};
+
+// Write `data` to `path` via a temporary file and rename(2).
+inline bool write_file_atomic(const std::string& path, const std::string& data, std::string* err) {
+  const std::string tmp = path + ".tmp." + std::to_string(getpid());
+  FILE* f = std::fopen(tmp.c_str(), "w");
+  if (!f) {
+    *err = "cannot open " + tmp + ": " + std::strerror(errno);
+    return false;
+  }
+  const bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+  if (std::fclose(f) != 0 || !ok) {
+    *err = "cannot write " + tmp + ": " + std::strerror(errno);
+    std::remove(tmp.c_str());
+    return false;
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    *err = "cannot rename " + tmp + " to " + path + ": " + std::strerror(errno);
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+// The --ready-file line for a mapping [lo, hi) at time `t` (monotonic_sec()).
+inline std::string ready_line(double t, const void* lo, const void* hi) {
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "%.6f", t);
+  return "ready pid=" + std::to_string(getpid()) + " time_sec=" + buf + " addr_lo=" + hex_addr(lo) +
+         " addr_hi=" + hex_addr(hi) + "\n";
+}
+
+// Deliver `line` to `path` (FIFO or regular file, see above). A FIFO with no
+// reader is an error rather than a hang: the open is non-blocking.
+inline bool signal_ready(const std::string& path, const std::string& line, std::string* err) {
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0 && S_ISFIFO(st.st_mode)) {
+    const int fd = open(path.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+      *err = "cannot open FIFO " + path + ": " + std::strerror(errno);
+      return false;
+    }
+    const ssize_t n = write(fd, line.data(), line.size());
+    close(fd);
+    if (n != static_cast<ssize_t>(line.size())) {
+      *err = "short write to FIFO " + path;
+      return false;
+    }
+    return true;
+  }
+  return write_file_atomic(path, line, err);
+}
+
+}  // namespace bench_report
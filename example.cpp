@@ -11,7 +11,9 @@
 
 #include <chrono>
 #include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 #include "cache/accessor.hpp"
 #include "data_structure/far_vector.hpp"
@@ -21,6 +23,7 @@
 #include "utils/debug.hpp"
 #include "utils/parallel.hpp"
 #include "utils/perf.hpp"
+#include "llama_quant.hpp"
 #if defined _WIN32
 #include "win.h"
 #else
@@ -37,6 +40,10 @@ static std::unordered_map<std::string, size_t> cnts;
 using namespace FarLib;
 using namespace FarLib::rdma;
 using namespace std::chrono_literals;
+using llama_quant::BlockQ4;
+using llama_quant::BlockQ8;
+using llama_quant::WeightType;
+static constexpr size_t QK = llama_quant::kGroup;
 static constexpr size_t UTHREAD_FACTOR = FarVector<float>::UTHREAD_FACTOR;
 static inline size_t get_thread_count() {
     return uthread::get_worker_count() * UTHREAD_FACTOR;
@@ -73,25 +80,78 @@ typedef struct {
     int seq_len;     // max sequence length
 } Config;
 
+// A weight matrix in far memory: fp32 from a llama2.c checkpoint, or QK-weight
+// blocks from a quantize_llama checkpoint (see llama_quant.hpp). Indices are
+// always in weights; a block tensor holds weight i in block i / QK.
+struct Weight {
+    WeightType type = WeightType::kF32;
+    FarVector<float> f32;
+    FarVector<BlockQ8> q8;
+    FarVector<BlockQ4> q4;
+
+    void assign_all(float* ptr, size_t n) {
+        type = WeightType::kF32;
+        f32.assign_all(ptr, n);
+    }
+
+    // n weights of type t from ptr; returns the bytes consumed
+    size_t assign_all(WeightType t, char* ptr, size_t n) {
+        type = t;
+        switch (t) {
+            case WeightType::kF32:
+                f32.assign_all(reinterpret_cast<float*>(ptr), n);
+                break;
+            case WeightType::kQ8:
+                q8.assign_all(reinterpret_cast<BlockQ8*>(ptr), n / QK);
+                break;
+            case WeightType::kQ4:
+                q4.assign_all(reinterpret_cast<BlockQ4*>(ptr), n / QK);
+                break;
+        }
+        return llama_quant::weight_bytes(t, n);
+    }
+
+    // dequantize weights [start, start + n) into dst
+    void copy_to_local(float* dst, size_t start, size_t n) {
+        if (type == WeightType::kF32) {
+            f32.copy_to_local(dst, start, n);
+        } else if (type == WeightType::kQ8) {
+            std::vector<BlockQ8> blocks(n / QK);
+            q8.copy_to_local(blocks.data(), start / QK, n / QK);
+            llama_quant::dequantize(blocks.data(), dst, n / QK);
+        } else {
+            std::vector<BlockQ4> blocks(n / QK);
+            q4.copy_to_local(blocks.data(), start / QK, n / QK);
+            llama_quant::dequantize(blocks.data(), dst, n / QK);
+        }
+    }
+
+    void clear() {
+        f32.clear();
+        q8.clear();
+        q4.clear();
+    }
+};
+
 struct TransformerWeights {
     // token embedding table
-    FarVector<float> token_embedding_table;  // (vocab_size, dim)
+    Weight token_embedding_table;  // (vocab_size, dim)
     // weights for rmsnorms
     FarVector<float> rms_att_weight;  // (layer, dim) rmsnorm weights
     FarVector<float> rms_ffn_weight;  // (layer, dim)
     // weights for matmuls. note dim == n_heads * head_size
-    FarVector<float> wq;  // (layer, dim, n_heads * head_size)
-    FarVector<float> wk;  // (layer, dim, n_kv_heads * head_size)
-    FarVector<float> wv;  // (layer, dim, n_kv_heads * head_size)
-    FarVector<float> wo;  // (layer, n_heads * head_size, dim)
+    Weight wq;  // (layer, dim, n_heads * head_size)
+    Weight wk;  // (layer, dim, n_kv_heads * head_size)
+    Weight wv;  // (layer, dim, n_kv_heads * head_size)
+    Weight wo;  // (layer, n_heads * head_size, dim)
     // weights for ffn
-    FarVector<float> w1;  // (layer, hidden_dim, dim)
-    FarVector<float> w2;  // (layer, dim, hidden_dim)
-    FarVector<float> w3;  // (layer, hidden_dim, dim)
+    Weight w1;  // (layer, hidden_dim, dim)
+    Weight w2;  // (layer, dim, hidden_dim)
+    Weight w3;  // (layer, hidden_dim, dim)
     // final rmsnorm
     FarVector<float> rms_final_weight;  // (dim,)
     // (optional) classifier weights for the logits, on the last layer
-    FarVector<float> wcls;
+    Weight wcls;
 
     void free() {
         token_embedding_table.clear();
@@ -241,6 +301,34 @@ void memory_map_weights(TransformerWeights* w, Config* p, float* ptr,
                        wcls_size);
 }
 
+// Same tensors from a quantize_llama checkpoint: fp32 rmsnorm weights, then
+// the matrices as blocks of type `type` (layout in llama_quant.hpp).
+void memory_map_qweights(TransformerWeights* w, Config* p, char* ptr,
+                         int shared_weights, WeightType type) {
+    int head_size = p->dim / p->n_heads;
+    unsigned long long n_layers = p->n_layers;
+    const size_t dim = p->dim;
+    const size_t kv_dim = p->n_kv_heads * head_size;
+    const size_t hidden_dim = p->hidden_dim;
+    w->rms_att_weight.assign_all(reinterpret_cast<float*>(ptr), n_layers * dim);
+    ptr += n_layers * dim * sizeof(float);
+    w->rms_ffn_weight.assign_all(reinterpret_cast<float*>(ptr), n_layers * dim);
+    ptr += n_layers * dim * sizeof(float);
+    w->rms_final_weight.assign_all(reinterpret_cast<float*>(ptr), dim);
+    ptr += dim * sizeof(float);
+    char* token_embedding_table_ptr = ptr;
+    ptr += w->token_embedding_table.assign_all(type, ptr, p->vocab_size * dim);
+    ptr += w->wq.assign_all(type, ptr, n_layers * dim * dim);
+    ptr += w->wk.assign_all(type, ptr, n_layers * dim * kv_dim);
+    ptr += w->wv.assign_all(type, ptr, n_layers * dim * kv_dim);
+    ptr += w->wo.assign_all(type, ptr, n_layers * dim * dim);
+    ptr += w->w1.assign_all(type, ptr, n_layers * dim * hidden_dim);
+    ptr += w->w2.assign_all(type, ptr, n_layers * hidden_dim * dim);
+    ptr += w->w3.assign_all(type, ptr, n_layers * dim * hidden_dim);
+    w->wcls.assign_all(type, shared_weights ? token_embedding_table_ptr : ptr,
+                       p->vocab_size * dim);
+}
+
 void read_checkpoint(const char* checkpoint, Config* config,
                      TransformerWeights* weights, int* fd, float** data,
                      ssize_t* file_size) {
@@ -253,9 +341,26 @@ void read_checkpoint(const char* checkpoint, Config* config,
     if (fread(config, sizeof(Config), 1, file) != 1) {
         exit(EXIT_FAILURE);
     }
+    // quantize_llama checkpoints start with their own header instead
+    llama_quant::FileHeader qheader;
+    const bool quantized =
+        static_cast<uint32_t>(config->dim) == llama_quant::kMagic;
+    if (quantized) {
+        rewind(file);
+        if (fread(&qheader, sizeof(qheader), 1, file) != 1 ||
+            qheader.version != llama_quant::kVersion ||
+            qheader.group != QK ||
+            qheader.type > static_cast<uint32_t>(WeightType::kQ4)) {
+            fprintf(stderr, "unsupported quantized checkpoint %s\n",
+                    checkpoint);
+            exit(EXIT_FAILURE);
+        }
+        memcpy(config, qheader.config, sizeof(Config));
+    }
     // negative vocab size is hacky way of signaling unshared weights. bit
     // yikes.
-    int shared_weights = config->vocab_size > 0 ? 1 : 0;
+    int shared_weights = quantized ? qheader.shared_classifier != 0
+                                   : config->vocab_size > 0 ? 1 : 0;
     config->vocab_size = abs(config->vocab_size);
     // figure out the file size
     fseek(file, 0, SEEK_END);  // move file pointer to end of file
@@ -273,6 +378,15 @@ void read_checkpoint(const char* checkpoint, Config* config,
         fprintf(stderr, "mmap failed!\n");
         exit(EXIT_FAILURE);
     }
+    if (quantized) {
+        const WeightType type = static_cast<WeightType>(qheader.type);
+        fprintf(stderr, "%s weights, %zu per block\n",
+                llama_quant::weight_type_name(type), QK);
+        memory_map_qweights(weights, config,
+                            reinterpret_cast<char*>(*data) + sizeof(qheader),
+                            shared_weights, type);
+        return;
+    }
     float* weights_ptr = *data + sizeof(Config) / sizeof(float);
     memory_map_weights(weights, config, weights_ptr, shared_weights);
 }
@@ -298,6 +412,69 @@ void free_transformer(Transformer* t) {
     free_run_state(&t->state);
 }
 
+// ----------------------------------------------------------------------------
+// chunked FarVector traversal
+
+// Elements per FarVector<T> chunk. A chunk is one far object, so once the lite
+// iterator has dereferenced it, [&*it, &*it + span_len<T>(...)) is contiguous
+// local memory that stays valid until the iterator is moved again.
+template <typename T>
+static constexpr size_t CHUNK_ELEMS = FarVector<T>::GROUP_SIZE;
+
+// Elements from idx up to the end of its chunk, capped at end.
+template <typename T>
+static inline size_t span_len(size_t idx, size_t end) {
+    return std::min(end - idx, CHUNK_ELEMS<T> - idx % CHUNK_ELEMS<T>);
+}
+
+template <bool kMut, typename T, typename F>
+static void walk_spans(FarVector<T>& fv, size_t start, size_t end,
+                       DereferenceScope& scope, F&& f) {
+    if (start >= end) {
+        return;
+    }
+    using it_t = std::conditional_t<kMut, decltype(fv.lbegin()),
+                                    decltype(fv.clbegin())>;
+    struct Scope : public DereferenceScope {
+        it_t it;
+
+        void pin() const override { it.pin(); }
+
+        void unpin() const override { it.unpin(); }
+
+        Scope(DereferenceScope* scope) : DereferenceScope(scope) {}
+    } scp(&scope);
+    if constexpr (kMut) {
+        scp.it = fv.get_lite_iter(start, scp, start, end);
+    } else {
+        scp.it = fv.get_const_lite_iter(start, scp, start, end);
+    }
+    for (size_t idx = start; idx < end;) {
+        const size_t len = span_len<T>(idx, end);
+        f(&*(scp.it), len);
+        idx += len;
+        if (idx < end) {
+            scp.it.nextn(len, scp);
+        }
+    }
+}
+
+// Call f(const T* ptr, size_t len) once per resident chunk of fv[start, end),
+// in order. The chunk is only valid during the call; f must not dereference
+// other far objects.
+template <typename T, typename F>
+static void for_each_span(FarVector<T>& fv, size_t start, size_t end,
+                          DereferenceScope& scope, F&& f) {
+    walk_spans<false>(fv, start, end, scope, std::forward<F>(f));
+}
+
+// Same, with f(T* ptr, size_t len) writing into the chunk.
+template <typename T, typename F>
+static void for_each_span_mut(FarVector<T>& fv, size_t start, size_t end,
+                              DereferenceScope& scope, F&& f) {
+    walk_spans<true>(fv, start, end, scope, std::forward<F>(f));
+}
+
 // ----------------------------------------------------------------------------
 // neural net blocks; the dynamics of the Transformer
 
@@ -331,30 +508,16 @@ void rmsnorm(float* o, float* x, FarVector<float>& weight_fv, size_t start,
     const size_t block = (size + thread_cnt - 1) / thread_cnt;
     uthread::parallel_for_with_scope<1>(
         thread_cnt, thread_cnt, [&](size_t i, DereferenceScope& scope) {
-            using it_t = decltype(weight_fv.clbegin());
             const size_t o_start = i * block;
             const size_t o_end =
                 std::min(o_start + block, static_cast<size_t>(size));
-            const size_t idx_start = o_start + start;
-            const size_t idx_end = o_end + start;
-
-            if (idx_start >= idx_end) {
-                return;
-            }
-            struct Scope : public DereferenceScope {
-                it_t it;
-
-                void pin() const override { it.pin(); }
-
-                void unpin() const override { it.unpin(); }
-
-                Scope(DereferenceScope* scope) : DereferenceScope(scope) {}
-            } scp(&scope);
-            scp.it = weight_fv.get_const_lite_iter(idx_start, scp, idx_start,
-                                                   idx_end);
-            for (size_t oi = o_start; oi < o_end; oi++, scp.it.next(scp)) {
-                o[oi] = *(scp.it) * (ss * x[oi]);
-            }
+            size_t oi = o_start;
+            for_each_span(weight_fv, o_start + start, o_end + start, scope,
+                          [&](const float* w, size_t len) {
+                              for (size_t j = 0; j < len; j++, oi++) {
+                                  o[oi] = w[j] * (ss * x[oi]);
+                              }
+                          });
         });
 }
 
@@ -378,22 +541,455 @@ void softmax(float* x, int size) {
     }
 }
 
+// ----------------------------------------------------------------------------
+// SIMD kernels over local floats
+
+static float dot_f32_scalar(const float* a, const float* b, size_t n) {
+    float val = 0.0f;
+    for (size_t j = 0; j < n; j++) {
+        val += a[j] * b[j];
+    }
+    return val;
+}
+
+__attribute__((target("avx2"))) static inline float hsum_avx2(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v),
+                          _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+__attribute__((target("avx2,fma"))) static float dot_f32_avx2(const float* a,
+                                                              const float* b,
+                                                              size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    __m256 acc3 = _mm256_setzero_ps();
+    size_t j = 0;
+    for (; j + 32 <= n; j += 32) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j),
+                               acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j + 8),
+                               _mm256_loadu_ps(b + j + 8), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j + 16),
+                               _mm256_loadu_ps(b + j + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j + 24),
+                               _mm256_loadu_ps(b + j + 24), acc3);
+    }
+    for (; j + 8 <= n; j += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j),
+                               acc0);
+    }
+    float val = hsum_avx2(_mm256_add_ps(_mm256_add_ps(acc0, acc1),
+                                        _mm256_add_ps(acc2, acc3)));
+    for (; j < n; j++) {
+        val += a[j] * b[j];
+    }
+    return val;
+}
+
+__attribute__((target("avx512f"))) static float dot_f32_avx512(const float* a,
+                                                               const float* b,
+                                                               size_t n) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    __m512 acc2 = _mm512_setzero_ps();
+    __m512 acc3 = _mm512_setzero_ps();
+    size_t j = 0;
+    for (; j + 64 <= n; j += 64) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j), _mm512_loadu_ps(b + j),
+                               acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j + 16),
+                               _mm512_loadu_ps(b + j + 16), acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j + 32),
+                               _mm512_loadu_ps(b + j + 32), acc2);
+        acc3 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j + 48),
+                               _mm512_loadu_ps(b + j + 48), acc3);
+    }
+    for (; j + 16 <= n; j += 16) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + j), _mm512_loadu_ps(b + j),
+                               acc0);
+    }
+    if (j < n) {
+        const __mmask16 m = static_cast<__mmask16>((1u << (n - j)) - 1);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, a + j),
+                               _mm512_maskz_loadu_ps(m, b + j), acc1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(acc0, acc1),
+                                              _mm512_add_ps(acc2, acc3)));
+}
+
+// Register-blocked matmul: MATMUL_ROWS rows are multiplied together so each
+// load of x feeds MATMUL_ROWS FMAs, each row with its own accumulators. x is
+// consumed in MATMUL_X_TILE pieces (8 KiB) that stay in L1 while a block of
+// MATMUL_ROW_BLOCK rows streams past them.
+static constexpr size_t MATMUL_ROWS = 4;
+static constexpr size_t MATMUL_X_TILE = 2048;
+static constexpr int MATMUL_ROW_BLOCK = 64;
+
+// out[k] += w[k] . x for k < MATMUL_ROWS
+static void dot_rows_f32_scalar(const float* const* w, const float* x,
+                                size_t n, float* out) {
+    float acc[MATMUL_ROWS] = {};
+    for (size_t j = 0; j < n; j++) {
+        const float xj = x[j];
+        for (size_t k = 0; k < MATMUL_ROWS; k++) {
+            acc[k] += w[k][j] * xj;
+        }
+    }
+    for (size_t k = 0; k < MATMUL_ROWS; k++) {
+        out[k] += acc[k];
+    }
+}
+
+__attribute__((target("avx2,fma"))) static void dot_rows_f32_avx2(
+    const float* const* w, const float* x, size_t n, float* out) {
+    __m256 acc0[MATMUL_ROWS];
+    __m256 acc1[MATMUL_ROWS];
+    for (size_t k = 0; k < MATMUL_ROWS; k++) {
+        acc0[k] = _mm256_setzero_ps();
+        acc1[k] = _mm256_setzero_ps();
+    }
+    size_t j = 0;
+    for (; j + 16 <= n; j += 16) {
+        const __m256 x0 = _mm256_loadu_ps(x + j);
+        const __m256 x1 = _mm256_loadu_ps(x + j + 8);
+        for (size_t k = 0; k < MATMUL_ROWS; k++) {
+            acc0[k] = _mm256_fmadd_ps(_mm256_loadu_ps(w[k] + j), x0, acc0[k]);
+            acc1[k] =
+                _mm256_fmadd_ps(_mm256_loadu_ps(w[k] + j + 8), x1, acc1[k]);
+        }
+    }
+    for (size_t k = 0; k < MATMUL_ROWS; k++) {
+        float val = hsum_avx2(_mm256_add_ps(acc0[k], acc1[k]));
+        for (size_t jj = j; jj < n; jj++) {
+            val += w[k][jj] * x[jj];
+        }
+        out[k] += val;
+    }
+}
+
+__attribute__((target("avx512f"))) static void dot_rows_f32_avx512(
+    const float* const* w, const float* x, size_t n, float* out) {
+    __m512 acc0[MATMUL_ROWS];
+    __m512 acc1[MATMUL_ROWS];
+    for (size_t k = 0; k < MATMUL_ROWS; k++) {
+        acc0[k] = _mm512_setzero_ps();
+        acc1[k] = _mm512_setzero_ps();
+    }
+    size_t j = 0;
+    for (; j + 32 <= n; j += 32) {
+        const __m512 x0 = _mm512_loadu_ps(x + j);
+        const __m512 x1 = _mm512_loadu_ps(x + j + 16);
+        for (size_t k = 0; k < MATMUL_ROWS; k++) {
+            acc0[k] = _mm512_fmadd_ps(_mm512_loadu_ps(w[k] + j), x0, acc0[k]);
+            acc1[k] =
+                _mm512_fmadd_ps(_mm512_loadu_ps(w[k] + j + 16), x1, acc1[k]);
+        }
+    }
+    for (; j < n; j += 16) {
+        const __mmask16 m =
+            n - j >= 16 ? static_cast<__mmask16>(0xffff)
+                        : static_cast<__mmask16>((1u << (n - j)) - 1);
+        const __m512 x0 = _mm512_maskz_loadu_ps(m, x + j);
+        for (size_t k = 0; k < MATMUL_ROWS; k++) {
+            acc0[k] = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, w[k] + j), x0,
+                                      acc0[k]);
+        }
+    }
+    for (size_t k = 0; k < MATMUL_ROWS; k++) {
+        out[k] += _mm512_reduce_add_ps(_mm512_add_ps(acc0[k], acc1[k]));
+    }
+}
+
+// Dot products of nb quantized blocks with x[0, nb * QK): weights are widened
+// to fp32 in registers, so only the blocks cross the far-memory boundary.
+static float dot_q8_f32_scalar(const BlockQ8* b, const float* x, size_t nb) {
+    float val = 0.0f;
+    for (size_t i = 0; i < nb; i++, x += QK) {
+        float s = 0.0f;
+        for (size_t j = 0; j < QK; j++) {
+            s += b[i].q[j] * x[j];
+        }
+        val += s * b[i].d;
+    }
+    return val;
+}
+
+static float dot_q4_f32_scalar(const BlockQ4* b, const float* x, size_t nb) {
+    float val = 0.0f;
+    for (size_t i = 0; i < nb; i++, x += QK) {
+        float s = 0.0f;
+        for (size_t j = 0; j < QK / 2; j++) {
+            s += ((b[i].q[j] & 0x0f) - 8) * x[j] +
+                 ((b[i].q[j] >> 4) - 8) * x[j + QK / 2];
+        }
+        val += s * b[i].d;
+    }
+    return val;
+}
+
+__attribute__((target("avx2,fma"))) static float dot_q8_f32_avx2(
+    const BlockQ8* b, const float* x, size_t nb) {
+    __m256 acc = _mm256_setzero_ps();
+    for (size_t i = 0; i < nb; i++, x += QK) {
+        __m256 s = _mm256_setzero_ps();
+        for (size_t j = 0; j < QK; j += 8) {
+            const __m256 w = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b[i].q + j))));
+            s = _mm256_fmadd_ps(w, _mm256_loadu_ps(x + j), s);
+        }
+        acc = _mm256_fmadd_ps(s, _mm256_set1_ps(b[i].d), acc);
+    }
+    return hsum_avx2(acc);
+}
+
+__attribute__((target("avx2,fma"))) static float dot_q4_f32_avx2(
+    const BlockQ4* b, const float* x, size_t nb) {
+    const __m256i lo_mask = _mm256_set1_epi32(0x0f);
+    const __m256i off = _mm256_set1_epi32(8);
+    __m256 acc = _mm256_setzero_ps();
+    for (size_t i = 0; i < nb; i++, x += QK) {
+        __m256 s = _mm256_setzero_ps();
+        for (size_t j = 0; j < QK / 2; j += 8) {
+            const __m256i v = _mm256_cvtepu8_epi32(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b[i].q + j)));
+            const __m256 lo = _mm256_cvtepi32_ps(
+                _mm256_sub_epi32(_mm256_and_si256(v, lo_mask), off));
+            const __m256 hi = _mm256_cvtepi32_ps(
+                _mm256_sub_epi32(_mm256_srli_epi32(v, 4), off));
+            s = _mm256_fmadd_ps(lo, _mm256_loadu_ps(x + j), s);
+            s = _mm256_fmadd_ps(hi, _mm256_loadu_ps(x + j + QK / 2), s);
+        }
+        acc = _mm256_fmadd_ps(s, _mm256_set1_ps(b[i].d), acc);
+    }
+    return hsum_avx2(acc);
+}
+
+__attribute__((target("avx512f"))) static float dot_q8_f32_avx512(
+    const BlockQ8* b, const float* x, size_t nb) {
+    __m512 acc = _mm512_setzero_ps();
+    for (size_t i = 0; i < nb; i++, x += QK) {
+        __m512 s = _mm512_setzero_ps();
+        for (size_t j = 0; j < QK; j += 16) {
+            const __m512 w = _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b[i].q + j))));
+            s = _mm512_fmadd_ps(w, _mm512_loadu_ps(x + j), s);
+        }
+        acc = _mm512_fmadd_ps(s, _mm512_set1_ps(b[i].d), acc);
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+
+__attribute__((target("avx512f"))) static float dot_q4_f32_avx512(
+    const BlockQ4* b, const float* x, size_t nb) {
+    static_assert(QK == 32, "one 16-byte load must cover a BlockQ4");
+    const __m512i lo_mask = _mm512_set1_epi32(0x0f);
+    const __m512i off = _mm512_set1_epi32(8);
+    __m512 acc = _mm512_setzero_ps();
+    for (size_t i = 0; i < nb; i++, x += QK) {
+        const __m512i v = _mm512_cvtepu8_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b[i].q)));
+        const __m512 lo = _mm512_cvtepi32_ps(
+            _mm512_sub_epi32(_mm512_and_si512(v, lo_mask), off));
+        const __m512 hi = _mm512_cvtepi32_ps(
+            _mm512_sub_epi32(_mm512_srli_epi32(v, 4), off));
+        __m512 s = _mm512_mul_ps(lo, _mm512_loadu_ps(x));
+        s = _mm512_fmadd_ps(hi, _mm512_loadu_ps(x + QK / 2), s);
+        acc = _mm512_fmadd_ps(s, _mm512_set1_ps(b[i].d), acc);
+    }
+    return _mm512_reduce_add_ps(acc);
+}
+
+enum class Simd { kScalar, kAvx2, kAvx512 };
+
+// Pick the widest instruction set this CPU supports, once at startup.
+static Simd resolve_simd() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return Simd::kAvx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return Simd::kAvx2;
+    }
+    return Simd::kScalar;
+}
+
+static const Simd simd = resolve_simd();
+
+using dot_f32_t = float (*)(const float*, const float*, size_t);
+using dot_rows_f32_t = void (*)(const float* const*, const float*, size_t,
+                                float*);
+
+static const dot_f32_t dot_f32 = simd == Simd::kAvx512 ? dot_f32_avx512
+                                 : simd == Simd::kAvx2 ? dot_f32_avx2
+                                                       : dot_f32_scalar;
+static const dot_rows_f32_t dot_rows_f32 =
+    simd == Simd::kAvx512 ? dot_rows_f32_avx512
+    : simd == Simd::kAvx2 ? dot_rows_f32_avx2
+                          : dot_rows_f32_scalar;
+static float (*const dot_q8_f32)(const BlockQ8*, const float*, size_t) =
+    simd == Simd::kAvx512 ? dot_q8_f32_avx512
+    : simd == Simd::kAvx2 ? dot_q8_f32_avx2
+                          : dot_q8_f32_scalar;
+static float (*const dot_q4_f32)(const BlockQ4*, const float*, size_t) =
+    simd == Simd::kAvx512 ? dot_q4_f32_avx512
+    : simd == Simd::kAvx2 ? dot_q4_f32_avx2
+                          : dot_q4_f32_scalar;
+
+static inline float dot_blocks(const BlockQ8* b, const float* x, size_t nb) {
+    return dot_q8_f32(b, x, nb);
+}
+
+static inline float dot_blocks(const BlockQ4* b, const float* x, size_t nb) {
+    return dot_q4_f32(b, x, nb);
+}
+
 void matmul(float* xout, float* x, float* w, int n, int d) {
     // W (d,n) @ x (n,) -> xout (d,)
     // by far the most amount of time is spent inside this little function
-    int i;
-#pragma omp parallel for private(i)
-    for (i = 0; i < d; i++) {
-        float val = 0.0f;
-        for (int j = 0; j < n; j++) {
-            val += w[i * n + j] * x[j];
+    int b;
+#pragma omp parallel for private(b)
+    for (b = 0; b < d; b += MATMUL_ROW_BLOCK) {
+        const size_t r_end = std::min(b + MATMUL_ROW_BLOCK, d);
+        memset(xout + b, 0, (r_end - b) * sizeof(float));
+        for (size_t j = 0; j < n; j += MATMUL_X_TILE) {
+            const size_t len = std::min(MATMUL_X_TILE, n - j);
+            size_t r = b;
+            for (; r + MATMUL_ROWS <= r_end; r += MATMUL_ROWS) {
+                const float* rows[MATMUL_ROWS];
+                for (size_t k = 0; k < MATMUL_ROWS; k++) {
+                    rows[k] = w + (r + k) * n + j;
+                }
+                dot_rows_f32(rows, x + j, len, xout + r);
+            }
+            for (; r < r_end; r++) {
+                xout[r] += dot_f32(w + r * n + j, x + j, len);
+            }
+        }
+    }
+}
+
+// out[r] = W[r] . x for the rows r < rows of W (rows, n) stored from
+// weight_fv[idx_start]. Rows go MATMUL_ROWS at a time: their iterators advance
+// in lockstep, each step covering the longest stretch resident in all of
+// them. Leftover rows take one dot per chunk; chunks may end inside a row or
+// hold several rows.
+static void matmul_rows(float* out, const float* x,
+                        FarVector<float>& weight_fv, size_t idx_start,
+                        size_t n, size_t rows, DereferenceScope& scope) {
+    using it_t = decltype(weight_fv.clbegin());
+    struct Scope : public DereferenceScope {
+        it_t it[MATMUL_ROWS];
+
+        void pin() const override {
+            for (auto& i : it) {
+                i.pin();
+            }
+        }
+
+        void unpin() const override {
+            for (auto& i : it) {
+                i.unpin();
+            }
+        }
+
+        Scope(DereferenceScope* scope) : DereferenceScope(scope) {}
+    } scp(&scope);
+    size_t r = 0;
+    for (; r + MATMUL_ROWS <= rows; r += MATMUL_ROWS) {
+        size_t row[MATMUL_ROWS];
+        for (size_t k = 0; k < MATMUL_ROWS; k++) {
+            row[k] = idx_start + (r + k) * n;
+            scp.it[k] = weight_fv.get_const_lite_iter(row[k], scp, row[k],
+                                                      row[k] + n);
+            out[r + k] = 0.0f;
         }
-        xout[i] = val;
+        for (size_t j = 0; j < n;) {
+            size_t len = n - j;
+            const float* w[MATMUL_ROWS];
+            for (size_t k = 0; k < MATMUL_ROWS; k++) {
+                len = std::min(len, span_len<float>(row[k] + j, row[k] + n));
+                w[k] = &*(scp.it[k]);
+            }
+            dot_rows_f32(w, x + j, len, out + r);
+            j += len;
+            if (j < n) {
+                for (size_t k = 0; k < MATMUL_ROWS; k++) {
+                    scp.it[k].nextn(len, scp);
+                }
+            }
+        }
+    }
+
+    size_t j = 0;
+    float val = 0.0f;
+    for_each_span(weight_fv, idx_start + r * n, idx_start + rows * n, scope,
+                  [&](const float* w, size_t len) {
+                      while (len > 0) {
+                          const size_t m = std::min(len, n - j);
+                          val += dot_f32(w, x + j, m);
+                          w += m;
+                          len -= m;
+                          j += m;
+                          if (j == n) {
+                              out[r++] = val;
+                              val = 0.0f;
+                              j = 0;
+                          }
+                      }
+                  });
+}
+
+// matmul_rows for block-quantized rows: one dequantizing dot per resident
+// chunk of whole blocks. bstart and nb (blocks per row) are in blocks.
+template <typename B>
+static void matmul_rows(float* out, const float* x, FarVector<B>& weight_fv,
+                        size_t bstart, size_t nb, size_t rows,
+                        DereferenceScope& scope) {
+    size_t r = 0;
+    size_t j = 0;
+    float val = 0.0f;
+    for_each_span(weight_fv, bstart, bstart + rows * nb, scope,
+                  [&](const B* w, size_t len) {
+                      while (len > 0) {
+                          const size_t m = std::min(len, nb - j);
+                          val += dot_blocks(w, x + j * QK, m);
+                          w += m;
+                          len -= m;
+                          j += m;
+                          if (j == nb) {
+                              out[r++] = val;
+                              val = 0.0f;
+                              j = 0;
+                          }
+                      }
+                  });
+}
+
+// idx_start is a weight index; quantized rows are converted to blocks
+static void matmul_rows(float* out, const float* x, Weight& weight,
+                        size_t idx_start, size_t n, size_t rows,
+                        DereferenceScope& scope) {
+    switch (weight.type) {
+        case WeightType::kF32:
+            matmul_rows(out, x, weight.f32, idx_start, n, rows, scope);
+            break;
+        case WeightType::kQ8:
+            matmul_rows(out, x, weight.q8, idx_start / QK, n / QK, rows,
+                        scope);
+            break;
+        case WeightType::kQ4:
+            matmul_rows(out, x, weight.q4, idx_start / QK, n / QK, rows,
+                        scope);
+            break;
     }
 }
 
-void matmul(float* xout, float* x, FarVector<float>& weight_fv, size_t wstart,
-            int n, int d) {
+void matmul(float* xout, float* x, Weight& weight, size_t wstart, int n,
+            int d) {
     // W (d,n) @ x (n,) -> xout (d,)
     // by far the most amount of time is spent inside this little function
     const size_t thread_cnt = get_thread_count();
@@ -403,35 +999,16 @@ void matmul(float* xout, float* x, FarVector<float>& weight_fv, size_t wstart,
             const size_t d_start = i * block;
             const size_t d_end =
                 std::min(d_start + block, static_cast<size_t>(d));
-            const size_t idx_start = wstart + d_start * n;
-            const size_t idx_end = wstart + d_end * n;
             if (d_start >= d_end) {
                 return;
             }
-            using it_t = decltype(weight_fv.clbegin());
-            struct Scope : public DereferenceScope {
-                it_t it;
-
-                void pin() const override { it.pin(); }
-
-                void unpin() const override { it.unpin(); }
-
-                Scope(DereferenceScope* scope) : DereferenceScope(scope) {}
-            } scp(&scope);
-            scp.it = weight_fv.get_const_lite_iter(idx_start, scp, idx_start,
-                                                   idx_end);
-            for (size_t dd = d_start; dd < d_end; dd++) {
-                float val = 0.0f;
-                for (size_t j = 0; j < n; j++, scp.it.next(scp)) {
-                    val += *(scp.it) * x[j];
-                }
-                xout[dd] = val;
-            }
+            matmul_rows(xout + d_start, x, weight, wstart + d_start * n, n,
+                        d_end - d_start, scope);
         });
 }
 
 void matmul(FarVector<float>& xout_fv, size_t xout_start, float* x,
-            FarVector<float>& weight_fv, size_t wstart, int n, int d) {
+            Weight& weight, size_t wstart, int n, int d) {
     // W (d,n) @ x (n,) -> xout (d,)
     // by far the most amount of time is spent inside this little function
     const size_t thread_cnt = get_thread_count();
@@ -441,40 +1018,127 @@ void matmul(FarVector<float>& xout_fv, size_t xout_start, float* x,
             const size_t d_start = i * block;
             const size_t d_end =
                 std::min(d_start + block, static_cast<size_t>(d));
-            const size_t out_start = xout_start + d_start;
-            const size_t out_end = xout_start + d_end;
-            if (d_start >= d_end) {
-                return;
+            // rows are computed into a local tile, then stored span by span
+            constexpr size_t TILE = 64;
+            float vals[TILE];
+            for (size_t dd = d_start; dd < d_end; dd += TILE) {
+                const size_t rows = std::min(TILE, d_end - dd);
+                matmul_rows(vals, x, weight, wstart + dd * n, n, rows,
+                            scope);
+                const float* v = vals;
+                for_each_span_mut(xout_fv, xout_start + dd,
+                                  xout_start + dd + rows, scope,
+                                  [&](float* out, size_t len) {
+                                      memcpy(out, v, len * sizeof(float));
+                                      v += len;
+                                  });
             }
-            using w_it_t = decltype(weight_fv.clbegin());
-            using out_it_t = decltype(xout_fv.lbegin());
-            struct Scope : public DereferenceScope {
-                w_it_t w_it;
-                out_it_t out_it;
-                void pin() const override {
-                    w_it.pin();
-                    out_it.pin();
-                }
+        });
+}
+
+// RoPE relative positional encoding: complex-valued rotate vec[0, len), whose
+// first element is at the even index i0 of a q or k vector
+static void rope(float* vec, size_t i0, size_t len, int head_size, int pos) {
+    for (size_t j = 0; j < len; j += 2) {
+        int head_dim = (i0 + j) % head_size;
+        float freq = 1.0f / powf(10000.0f, head_dim / (float)head_size);
+        float val = pos * freq;
+        float fcr = cosf(val);
+        float fci = sinf(val);
+        float v0 = vec[j];
+        float v1 = vec[j + 1];
+        vec[j] = v0 * fcr - v1 * fci;
+        vec[j + 1] = v0 * fci + v1 * fcr;
+    }
+}
 
-                void unpin() const override {
-                    w_it.unpin();
-                    out_it.unpin();
+// Rows per task are a multiple of MATMUL_ROWS so RoPE pairs stay together.
+static size_t fused_block(size_t rows, size_t thread_cnt) {
+    const size_t per = thread_cnt * MATMUL_ROWS;
+    return (rows + per - 1) / per * MATMUL_ROWS;
+}
+
+// q = RoPE(Wq x), k = RoPE(Wk x) and v = Wv x in one parallel region. The
+// rows of Wq, Wk and Wv are split across tasks as one (dim + 2 * kv_dim) row
+// space; k and v are stored straight into the caches at kv_start.
+void matmul_qkv(float* q, FarVector<float>& key_cache,
+                FarVector<float>& value_cache, size_t kv_start, float* x,
+                TransformerWeights* w, size_t wq_start, size_t wkv_start,
+                int dim, int kv_dim, int head_size, int pos) {
+    struct Segment {
+        Weight* w;
+        size_t wstart;
+        size_t rows;
+        FarVector<float>* cache;  // nullptr: write to q
+        bool rope;
+    } const segs[] = {
+        {&w->wq, wq_start, static_cast<size_t>(dim), nullptr, true},
+        {&w->wk, wkv_start, static_cast<size_t>(kv_dim), &key_cache, true},
+        {&w->wv, wkv_start, static_cast<size_t>(kv_dim), &value_cache, false},
+    };
+    const size_t rows = dim + 2 * kv_dim;
+    const size_t thread_cnt = get_thread_count();
+    const size_t block = fused_block(rows, thread_cnt);
+    uthread::parallel_for_with_scope<1>(
+        thread_cnt, thread_cnt, [&](size_t i, DereferenceScope& scope) {
+            const size_t r_end = std::min((i + 1) * block, rows);
+            constexpr size_t TILE = 64;
+            float vals[TILE];
+            size_t seg_start = 0;
+            for (const Segment& seg : segs) {
+                const size_t seg_end = seg_start + seg.rows;
+                size_t r = std::max(i * block, seg_start);
+                for (; r < std::min(r_end, seg_end);) {
+                    const size_t row = r - seg_start;
+                    const size_t cnt =
+                        std::min({TILE, r_end - r, seg_end - r});
+                    matmul_rows(vals, x, *seg.w, seg.wstart + row * dim, dim,
+                                cnt, scope);
+                    if (seg.rope) {
+                        rope(vals, row, cnt, head_size, pos);
+                    }
+                    if (seg.cache == nullptr) {
+                        memcpy(q + row, vals, cnt * sizeof(float));
+                    } else {
+                        const float* v = vals;
+                        for_each_span_mut(*seg.cache, kv_start + row,
+                                          kv_start + row + cnt, scope,
+                                          [&](float* out, size_t len) {
+                                              memcpy(out, v,
+                                                     len * sizeof(float));
+                                              v += len;
+                                          });
+                    }
+                    r += cnt;
                 }
+                seg_start = seg_end;
+            }
+        });
+}
 
-                Scope(DereferenceScope* scope) : DereferenceScope(scope) {}
-            } scp(&scope);
-            scp.out_it =
-                xout_fv.get_lite_iter(out_start, scp, out_start, out_end);
-            for (size_t dd = d_start; dd < d_end; dd++, scp.out_it.next(scp)) {
-                float val = 0.0f;
-                const size_t idx_start = wstart + dd * n;
-                const size_t idx_end = wstart + (dd + 1) * n;
-                scp.w_it = weight_fv.get_const_lite_iter(idx_start, scp,
-                                                         idx_start, idx_end);
-                for (size_t j = 0; j < n; j++, scp.w_it.next(scp)) {
-                    val += *(scp.w_it) * x[j];
+// hb = silu(W1 x) * (W3 x) in one parallel region, W1 and W3 (d,n)
+void matmul_w13_swiglu(float* hb, float* x, Weight& w1, Weight& w3,
+                       size_t wstart, int n, int d) {
+    const size_t thread_cnt = get_thread_count();
+    const size_t block = fused_block(d, thread_cnt);
+    uthread::parallel_for_with_scope<1>(
+        thread_cnt, thread_cnt, [&](size_t i, DereferenceScope& scope) {
+            const size_t d_end =
+                std::min((i + 1) * block, static_cast<size_t>(d));
+            constexpr size_t TILE = 64;
+            float h1[TILE];
+            float h3[TILE];
+            for (size_t dd = i * block; dd < d_end; dd += TILE) {
+                const size_t cnt = std::min(TILE, d_end - dd);
+                matmul_rows(h1, x, w1, wstart + dd * n, n, cnt, scope);
+                matmul_rows(h3, x, w3, wstart + dd * n, n, cnt, scope);
+                for (size_t k = 0; k < cnt; k++) {
+                    float val = h1[k];
+                    // silu(x)=x*σ(x), where σ(x) is the logistic sigmoid
+                    val *= (1.0f / (1.0f + expf(-val)));
+                    // elementwise multiply with w3(x)
+                    hb[dd + k] = val * h3[k];
                 }
-                *(scp.out_it) = val;
             }
         });
 }
@@ -506,98 +1170,14 @@ float* forward(Transformer* transformer, int token, int pos) {
         int loff =
             l * p->seq_len * kv_dim;  // kv cache layer offset for convenience
 
-        // qkv matmuls for this position
-        const size_t key_cache_start = loff + pos * kv_dim;
-        const size_t value_cache_start = loff + pos * kv_dim;
-        prof("matmul1",
-             [&] { matmul(s->q, s->xb, w->wq, l * dim * dim, dim, dim); });
-
-        prof(
-            "matmul2",
-            [&] {
-                matmul(s->key_cache, loff + pos * kv_dim, s->xb, w->wk,
-                       l * dim * kv_dim, dim, kv_dim);
-                matmul(s->value_cache, loff + pos * kv_dim, s->xb, w->wv,
-                       l * dim * kv_dim, dim, kv_dim);
-            },
-            2);
-
-        // RoPE relative positional encoding: complex-valued rotate q and k in
-        // each head
-        prof("uth1", [&] {
-            const int min_dim = std::min(dim, kv_dim);
-            const size_t thread_cnt = get_thread_count();
-            const size_t block = (min_dim / 2 + thread_cnt - 1) / thread_cnt;
-            uthread::parallel_for_with_scope<1>(
-                thread_cnt, thread_cnt, [&](size_t i, DereferenceScope& scope) {
-                    const int idx_start = i * block * 2;
-                    const int idx_end = std::min(
-                        min_dim, static_cast<int>(idx_start + block * 2));
-                    if (idx_start >= idx_end) {
-                        return;
-                    }
-                    using it_t = decltype(s->key_cache.lbegin());
-                    struct Scope : public DereferenceScope {
-                        it_t it;
-                        it_t it1;
-
-                        void pin() const override {
-                            it.pin();
-                            it1.pin();
-                        }
-
-                        void unpin() const override {
-                            it.unpin();
-                            it1.unpin();
-                        }
-
-                        void next2() {
-                            it.nextn(2, *this);
-                            it1.nextn(2, *this);
-                        }
-
-                        Scope(DereferenceScope* scope)
-                            : DereferenceScope(scope) {}
-                    } scp(&scope);
-                    scp.it = s->key_cache.get_lite_iter(
-                        key_cache_start + idx_start, scp,
-                        key_cache_start + idx_start, key_cache_start + idx_end);
-                    scp.it1 = s->key_cache.get_lite_iter(
-                        key_cache_start + idx_start + 1, scp,
-                        key_cache_start + idx_start, key_cache_start + idx_end);
-                    for (int i = idx_start; i < idx_end; i += 2, scp.next2()) {
-                        int head_dim = i % head_size;
-                        float freq =
-                            1.0f / powf(10000.0f, head_dim / (float)head_size);
-                        float val = pos * freq;
-                        float fcr = cosf(val);
-                        float fci = sinf(val);
-
-                        int rotn =
-                            2;  // how many vectors? 2 = q & k, 1 = q only
-                        float v0 = *(scp.it);
-                        float v1 = *(scp.it1);
-                        *(scp.it) = v0 * fcr - v1 * fci;
-                        *(scp.it1) = v0 * fci + v1 * fcr;
-                    }
-                });
+        // qkv matmuls for this position, with RoPE relative positional
+        // encoding applied to q and k before they are stored
+        prof("qkv", [&] {
+            matmul_qkv(s->q, s->key_cache, s->value_cache, loff + pos * kv_dim,
+                       s->xb, w, l * dim * dim, l * dim * kv_dim, dim, kv_dim,
+                       head_size, pos);
         });
 
-        for (int i = 0; i < dim; i += 2) {
-            int head_dim = i % head_size;
-            float freq = 1.0f / powf(10000.0f, head_dim / (float)head_size);
-            float val = pos * freq;
-            float fcr = cosf(val);
-            float fci = sinf(val);
-
-            int rotn = 1;       // how many vectors? 2 = q & k, 1 = q only
-            float* vec = s->q;  // the vector to rotate (query or key)
-            float v0 = vec[i];
-            float v1 = vec[i + 1];
-            vec[i] = v0 * fcr - v1 * fci;
-            vec[i + 1] = v0 * fci + v1 * fcr;
-        }
-
         prof("multihead", [&] {
             // multihead attention. iterate over all heads
             const size_t thread_cnt = get_thread_count();
@@ -616,32 +1196,21 @@ float* forward(Transformer* transformer, int token, int pos) {
                         // attention scores for this head
                         float* att = s->att + h * p->seq_len;
                         // iterate over all timesteps, including the current one
-                        using it_t = decltype(s->key_cache.clbegin());
-                        struct Scope : public DereferenceScope {
-                            it_t it;
-
-                            void pin() const override { it.pin(); }
-
-                            void unpin() const override { it.unpin(); }
-
-                            Scope(DereferenceScope* scope)
-                                : DereferenceScope(scope) {}
-                        } scp(&scope);
                         for (int t = 0; t <= pos; t++) {
                             // get the key vector for this head and at this
                             // timestep
                             const size_t key_cache_base =
                                 loff + t * kv_dim + (h / kv_mul) * head_size;
-                            scp.it = s->key_cache.get_const_lite_iter(
-                                key_cache_base, scp, key_cache_base,
-                                key_cache_base + head_size);
                             // calculate the attention score as the dot
                             // product of q and k
                             float score = 0.0f;
-                            for (int i = 0; i < head_size;
-                                 i++, scp.it.next(scp)) {
-                                score += q[i] * (*(scp.it));
-                            }
+                            const float* qi = q;
+                            for_each_span(s->key_cache, key_cache_base,
+                                          key_cache_base + head_size, scope,
+                                          [&](const float* k, size_t len) {
+                                              score += dot_f32(qi, k, len);
+                                              qi += len;
+                                          });
                             score /= sqrtf(head_size);
                             // save the score to the attention buffer
                             att[t] = score;
@@ -659,16 +1228,18 @@ float* forward(Transformer* transformer, int token, int pos) {
                             // timestep
                             const size_t value_cache_base =
                                 loff + t * kv_dim + (h / kv_mul) * head_size;
-                            scp.it = s->value_cache.get_const_lite_iter(
-                                value_cache_base, scp, value_cache_base,
-                                value_cache_base + head_size);
                             // get the attention weight for this timestep
                             float a = att[t];
                             // accumulate the weighted value into xb
-                            for (int i = 0; i < head_size;
-                                 i++, scp.it.next(scp)) {
-                                xb[i] += a * (*(scp.it));
-                            }
+                            float* xi = xb;
+                            for_each_span(s->value_cache, value_cache_base,
+                                          value_cache_base + head_size, scope,
+                                          [&](const float* v, size_t len) {
+                                              for (size_t i = 0; i < len; i++) {
+                                                  xi[i] += a * v[i];
+                                              }
+                                              xi += len;
+                                          });
                         }
                     }
                 });
@@ -687,26 +1258,12 @@ float* forward(Transformer* transformer, int token, int pos) {
         rmsnorm(s->xb, x, w->rms_ffn_weight, l * dim, dim);
 
         // Now for FFN in PyTorch we have: self.w2(F.silu(self.w1(x)) *
-        // self.w3(x)) first calculate self.w1(x) and self.w3(x)
-        prof(
-            "matmul1",
-            [&] {
-                matmul(s->hb, s->xb, w->w1, l * dim * hidden_dim, dim,
-                       hidden_dim);
-                matmul(s->hb2, s->xb, w->w3, l * dim * hidden_dim, dim,
-                       hidden_dim);
-            },
-            2);
-
-        // SwiGLU non-linearity
-        for (int i = 0; i < hidden_dim; i++) {
-            float val = s->hb[i];
-            // silu(x)=x*σ(x), where σ(x) is the logistic sigmoid
-            val *= (1.0f / (1.0f + expf(-val)));
-            // elementwise multiply with w3(x)
-            val *= s->hb2[i];
-            s->hb[i] = val;
-        }
+        // self.w3(x)); w1 and w3 share one parallel region with the SwiGLU
+        // non-linearity applied as each tile of rows completes
+        prof("ffn13", [&] {
+            matmul_w13_swiglu(s->hb, s->xb, w->w1, w->w3, l * dim * hidden_dim,
+                              dim, hidden_dim);
+        });
 
         prof("matmul1", [&] {
             // final matmul to get the output of the ffn
@@ -0,0 +1,657 @@
+// Time-vs-address heatmap binner (C++ side of plot_phys_addr.py).
+//
+// Streams a sample file or points.txt once, bins samples into per-thread 2-D
+// histograms (time bin x address bin) and merges them at the end. Output is a
+// small pre-binned matrix that plot_phys_addr.py draws directly, instead of
+// loading hundreds of millions of samples into numpy for hexbin:
+//
+//   <output>.npy   uint64 counts, shape (ybins, xbins), row 0 = lowest address
+//   <output>.json  extents and metadata (x in seconds, y in bytes)
+//
+// --addr-min/--addr-max/--time-zero/--y-offset/--auto-ylim follow
+// plot_phys_addr.py: t=0 is the first sample of the chosen event in file order
+// unless --time-zero is given, and --auto-ylim tightens the y range to the
+// [lo_pct, hi_pct] sample percentiles plus padding, clamped to the window.
+//
+// --png=<path> also renders the matrix (log scale, Blues) without Python.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "sample_format.hpp"
+
+namespace {
+
+constexpr double kGiB = 1024.0 * 1024.0 * 1024.0;
+constexpr int kAutoYlimOversample = 8;  // fine rows per output row when --auto-ylim crops
+
+struct Config {
+  std::string input;
+  std::string output = "heatmap.npy";
+  std::string png;
+  std::string event = "cpu/mem-loads/pp";
+  bool have_addr_min = false;
+  bool have_addr_max = false;
+  uint64_t addr_min = 0;
+  uint64_t addr_max = 0;
+  bool have_time_zero = false;
+  double time_zero = 0.0;
+  bool have_xmin = false;
+  bool have_xmax = false;
+  double xmin_sec = 0.0;
+  double xmax_sec = 0.0;
+  double time_bin_ms = 100.0;
+  int ybins = 500;
+  bool y_offset = false;
+  bool auto_ylim = false;
+  double auto_ylim_lo_pct = 0.1;
+  double auto_ylim_hi_pct = 99.9;
+  double auto_ylim_pad_gb = 0.5;
+  double vmax_percentile = 0.0;  // 0 => use max count
+  int png_scale = 2;
+  int threads = 0;               // 0 => hardware_concurrency
+};
+
+// Per-thread histogram: absolute time bin -> column of address-bin counts.
+// Padded so workers never share a cache line with each other's hot fields.
+struct alignas(64) ThreadHist {
+  std::unordered_map<int64_t, std::vector<uint64_t>> cols;
+  int64_t cached_bin = std::numeric_limits<int64_t>::min();
+  uint64_t* cached = nullptr;
+  uint64_t first_seq = std::numeric_limits<uint64_t>::max();
+  uint64_t first_time_ns = 0;
+  uint64_t samples = 0;
+  uint64_t min_addr = std::numeric_limits<uint64_t>::max();
+  uint64_t max_addr = 0;
+};
+
+static bool parse_flag(const char* arg, const char* name, const char** out_val) {
+  const size_t n = std::strlen(name);
+  if (std::strncmp(arg, name, n) != 0) return false;
+  if (arg[n] == '\0') {
+    *out_val = nullptr;
+    return true;
+  }
+  if (arg[n] != '=') return false;
+  *out_val = arg + n + 1;
+  return true;
+}
+
+static void usage(const char* argv0) {
+  std::cerr
+      << "Usage: " << argv0 << " --input=<samples.bin|points.txt|-> [options]\n"
+      << "\n"
+      << "Options:\n"
+      << "  --output=<path.npy>      Binned matrix; metadata goes to <path>.json (default: heatmap.npy)\n"
+      << "  --png=<path>             Also render a PNG (log scale, Blues)\n"
+      << "  --event=<name>           Only keep this event (default: cpu/mem-loads/pp)\n"
+      << "  --addr-min=<hex>         Keep addresses >= this (default: data min; needs a file input)\n"
+      << "  --addr-max=<hex>         Keep addresses < this (default: data max + 1)\n"
+      << "  --time-zero=<sec>        Absolute time used as t=0 (default: first sample of --event)\n"
+      << "  --xmin-sec=<sec>         Crop x axis (relative to time zero)\n"
+      << "  --xmax-sec=<sec>         Crop x axis (relative to time zero)\n"
+      << "  --time-bin-ms=<ms>       Time bin width (default: 100)\n"
+      << "  --ybins=<N>              Address bins (default: 500)\n"
+      << "  --y-offset=0|1           Report y as (addr - addr_min) (default: 0)\n"
+      << "  --auto-ylim=0|1          Crop y to the dense region (default: 0)\n"
+      << "  --auto-ylim-lo-pct=<p>   Lower percentile (default: 0.1)\n"
+      << "  --auto-ylim-hi-pct=<p>   Upper percentile (default: 99.9)\n"
+      << "  --auto-ylim-pad-gb=<g>   Padding in GiB (default: 0.5)\n"
+      << "  --vmax-percentile=<p>    PNG color cap at this percentile of non-zero bins (default: max)\n"
+      << "  --png-scale=<k>          PNG pixels per bin (default: 2)\n"
+      << "  --threads=<N>            Worker threads (default: all CPUs)\n";
+}
+
+static bool parse_args(int argc, char** argv, Config* cfg) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = nullptr;
+
+    if (std::strcmp(a, "--help") == 0 || std::strcmp(a, "-h") == 0) {
+      usage(argv[0]);
+      return false;
+    }
+    if (parse_flag(a, "--input", &v) && v) {
+      cfg->input = v;
+      continue;
+    }
+    if (parse_flag(a, "--output", &v) && v) {
+      cfg->output = v;
+      continue;
+    }
+    if (parse_flag(a, "--png", &v) && v) {
+      cfg->png = v;
+      continue;
+    }
+    if (parse_flag(a, "--event", &v) && v) {
+      cfg->event = v;
+      continue;
+    }
+    if (parse_flag(a, "--addr-min", &v) && v) {
+      cfg->addr_min = std::stoull(v, nullptr, 16);
+      cfg->have_addr_min = true;
+      continue;
+    }
+    if (parse_flag(a, "--addr-max", &v) && v) {
+      cfg->addr_max = std::stoull(v, nullptr, 16);
+      cfg->have_addr_max = true;
+      continue;
+    }
+    if (parse_flag(a, "--time-zero", &v) && v) {
+      cfg->time_zero = std::stod(v);
+      cfg->have_time_zero = true;
+      continue;
+    }
+    if (parse_flag(a, "--xmin-sec", &v) && v) {
+      cfg->xmin_sec = std::stod(v);
+      cfg->have_xmin = true;
+      continue;
+    }
+    if (parse_flag(a, "--xmax-sec", &v) && v) {
+      cfg->xmax_sec = std::stod(v);
+      cfg->have_xmax = true;
+      continue;
+    }
+    if (parse_flag(a, "--time-bin-ms", &v) && v) {
+      cfg->time_bin_ms = std::stod(v);
+      if (!(cfg->time_bin_ms > 0.0)) {
+        std::cerr << "--time-bin-ms must be > 0\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--ybins", &v) && v) {
+      cfg->ybins = std::max(1, std::stoi(v));
+      continue;
+    }
+    if (parse_flag(a, "--y-offset", &v) && v) {
+      cfg->y_offset = (std::stoi(v) != 0);
+      continue;
+    }
+    if (parse_flag(a, "--auto-ylim", &v) && v) {
+      cfg->auto_ylim = (std::stoi(v) != 0);
+      continue;
+    }
+    if (parse_flag(a, "--auto-ylim-lo-pct", &v) && v) {
+      cfg->auto_ylim_lo_pct = std::stod(v);
+      continue;
+    }
+    if (parse_flag(a, "--auto-ylim-hi-pct", &v) && v) {
+      cfg->auto_ylim_hi_pct = std::stod(v);
+      continue;
+    }
+    if (parse_flag(a, "--auto-ylim-pad-gb", &v) && v) {
+      cfg->auto_ylim_pad_gb = std::stod(v);
+      continue;
+    }
+    if (parse_flag(a, "--vmax-percentile", &v) && v) {
+      cfg->vmax_percentile = std::stod(v);
+      continue;
+    }
+    if (parse_flag(a, "--png-scale", &v) && v) {
+      cfg->png_scale = std::max(1, std::stoi(v));
+      continue;
+    }
+    if (parse_flag(a, "--threads", &v) && v) {
+      cfg->threads = std::max(1, std::stoi(v));
+      continue;
+    }
+
+    std::cerr << "Unknown arg: " << a << "\n";
+    usage(argv[0]);
+    return false;
+  }
+  if (cfg->input.empty()) {
+    std::cerr << "--input is required\n";
+    usage(argv[0]);
+    return false;
+  }
+  if (cfg->auto_ylim && !(0.0 <= cfg->auto_ylim_lo_pct && cfg->auto_ylim_lo_pct < cfg->auto_ylim_hi_pct &&
+                          cfg->auto_ylim_hi_pct <= 100.0)) {
+    std::cerr << "--auto-ylim requires 0 <= lo_pct < hi_pct <= 100\n";
+    return false;
+  }
+  return true;
+}
+
+// ---- output writers --------------------------------------------------------
+
+static bool write_npy(const std::string& path, const std::vector<uint64_t>& m, size_t rows, size_t cols) {
+  FILE* f = std::fopen(path.c_str(), "wb");
+  if (!f) {
+    std::cerr << "open " << path << " failed: " << std::strerror(errno) << "\n";
+    return false;
+  }
+  std::string dict = "{'descr': '<u8', 'fortran_order': False, 'shape': (" + std::to_string(rows) + ", " +
+                     std::to_string(cols) + "), }";
+  // Magic (6) + version (2) + header len (2) + dict + '\n' must be 64-byte aligned.
+  const size_t unpadded = 10 + dict.size() + 1;
+  dict.append((64 - unpadded % 64) % 64, ' ');
+  dict.push_back('\n');
+  const uint16_t hlen = static_cast<uint16_t>(dict.size());
+  bool ok = std::fwrite("\x93NUMPY\x01\x00", 1, 8, f) == 8;
+  ok = ok && std::fwrite(&hlen, sizeof(hlen), 1, f) == 1;
+  ok = ok && std::fwrite(dict.data(), 1, dict.size(), f) == dict.size();
+  ok = ok && std::fwrite(m.data(), sizeof(uint64_t), m.size(), f) == m.size();
+  ok = (std::fclose(f) == 0) && ok;
+  if (!ok) std::cerr << "write " << path << " failed\n";
+  return ok;
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t* p, size_t n) {
+  static uint32_t table[256];
+  static bool init = false;
+  if (!init) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+    init = true;
+  }
+  crc = ~crc;
+  for (size_t i = 0; i < n; i++) crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void put_be32(std::vector<uint8_t>* out, uint32_t v) {
+  out->push_back(static_cast<uint8_t>(v >> 24));
+  out->push_back(static_cast<uint8_t>(v >> 16));
+  out->push_back(static_cast<uint8_t>(v >> 8));
+  out->push_back(static_cast<uint8_t>(v));
+}
+
+static void png_chunk(std::vector<uint8_t>* out, const char* type, const std::vector<uint8_t>& data) {
+  put_be32(out, static_cast<uint32_t>(data.size()));
+  const size_t start = out->size();
+  out->insert(out->end(), type, type + 4);
+  out->insert(out->end(), data.begin(), data.end());
+  put_be32(out, crc32_update(0, out->data() + start, out->size() - start));
+}
+
+// Minimal RGB PNG encoder: zlib stream with stored (uncompressed) deflate blocks,
+// so no zlib dependency is needed. Heatmaps are small, size is not a concern.
+static bool write_png(const std::string& path, const std::vector<uint8_t>& rgb, uint32_t w, uint32_t h) {
+  std::vector<uint8_t> raw;
+  raw.reserve(static_cast<size_t>(h) * (1 + 3 * static_cast<size_t>(w)));
+  for (uint32_t y = 0; y < h; y++) {
+    raw.push_back(0);  // filter: none
+    const uint8_t* row = rgb.data() + static_cast<size_t>(y) * w * 3;
+    raw.insert(raw.end(), row, row + static_cast<size_t>(w) * 3);
+  }
+
+  std::vector<uint8_t> z = {0x78, 0x01};
+  size_t off = 0;
+  do {
+    const size_t n = std::min<size_t>(65535, raw.size() - off);
+    z.push_back(off + n == raw.size() ? 1 : 0);
+    z.push_back(static_cast<uint8_t>(n));
+    z.push_back(static_cast<uint8_t>(n >> 8));
+    z.push_back(static_cast<uint8_t>(~n));
+    z.push_back(static_cast<uint8_t>(~n >> 8));
+    z.insert(z.end(), raw.begin() + static_cast<long>(off), raw.begin() + static_cast<long>(off + n));
+    off += n;
+  } while (off < raw.size());
+  uint32_t a = 1, b = 0;
+  for (uint8_t c : raw) {
+    a = (a + c) % 65521;
+    b = (b + a) % 65521;
+  }
+  put_be32(&z, (b << 16) | a);
+
+  std::vector<uint8_t> ihdr;
+  put_be32(&ihdr, w);
+  put_be32(&ihdr, h);
+  ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0});  // 8-bit RGB
+
+  std::vector<uint8_t> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  png_chunk(&out, "IHDR", ihdr);
+  png_chunk(&out, "IDAT", z);
+  png_chunk(&out, "IEND", {});
+
+  FILE* f = std::fopen(path.c_str(), "wb");
+  if (!f) {
+    std::cerr << "open " << path << " failed: " << std::strerror(errno) << "\n";
+    return false;
+  }
+  const bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+  return (std::fclose(f) == 0) && ok;
+}
+
+// matplotlib "Blues" anchors, light to dark.
+static void blues(double v, uint8_t* rgb) {
+  static const uint8_t kStops[9][3] = {{247, 251, 255}, {222, 235, 247}, {198, 219, 239},
+                                       {158, 202, 225}, {107, 174, 214}, {66, 146, 198},
+                                       {33, 113, 181},  {8, 81, 156},    {8, 48, 107}};
+  v = std::min(1.0, std::max(0.0, v)) * 8.0;
+  const int i = std::min(7, static_cast<int>(v));
+  const double f = v - i;
+  for (int c = 0; c < 3; c++) {
+    rgb[c] = static_cast<uint8_t>(kStops[i][c] + f * (kStops[i + 1][c] - kStops[i][c]) + 0.5);
+  }
+}
+
+// Time of the first sample of `event` in file order, before any address
+// filtering, i.e. the t=0 plot_phys_addr.py uses. Stops at that sample, which
+// is normally in the first block.
+static bool first_event_ns(const std::string& path, const std::string& event, uint64_t* out) {
+  sample_format::Source src;
+  if (!src.open(path)) return false;
+  const int ev = src.intern_event(event);
+  sample_format::Block b;
+  while (src.next(&b)) {
+    for (size_t i = 0; i < b.size(); i++) {
+      if (b.event[i] == ev) {
+        *out = b.time_ns[i];
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static uint64_t now_ms() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config cfg;
+  if (!parse_args(argc, argv, &cfg)) {
+    return 1;
+  }
+  const int threads = cfg.threads > 0 ? cfg.threads : std::max(1u, std::thread::hardware_concurrency());
+  const uint64_t t_begin = now_ms();
+
+  // Address window. Without explicit bounds we need a pre-pass over the data
+  // (legacy plot_phys_addr.py just used the data extent). The pre-pass also
+  // yields t=0: the first sample of the event, before address filtering.
+  bool have_origin = false;
+  uint64_t origin_ns = 0;
+  if (!cfg.have_addr_min || !cfg.have_addr_max) {
+    if (cfg.input == "-") {
+      std::cerr << "--addr-min/--addr-max are required when reading stdin\n";
+      return 1;
+    }
+    sample_format::Source pre;
+    if (!pre.open(cfg.input)) {
+      std::cerr << pre.error() << "\n";
+      return 1;
+    }
+    const int ev = pre.intern_event(cfg.event);
+    const bool phys = pre.has_phys();
+    std::vector<ThreadHist> ext(static_cast<size_t>(threads));
+    const bool ok = sample_format::for_each_block(&pre, threads, [&](int w, uint64_t seq, const sample_format::Block& b) {
+      ThreadHist& h = ext[static_cast<size_t>(w)];
+      const std::vector<uint64_t>& addr = phys ? b.phys_addr : b.addr;
+      for (size_t i = 0; i < b.size(); i++) {
+        if (b.event[i] != ev) continue;
+        if (seq < h.first_seq) {
+          h.first_seq = seq;
+          h.first_time_ns = b.time_ns[i];
+        }
+        if (addr[i] == 0) continue;
+        h.min_addr = std::min(h.min_addr, addr[i]);
+        h.max_addr = std::max(h.max_addr, addr[i]);
+      }
+    });
+    if (!ok) {
+      std::cerr << cfg.input << ": " << (pre.error().empty() ? "corrupt input" : pre.error()) << "\n";
+      return 1;
+    }
+    uint64_t lo = std::numeric_limits<uint64_t>::max(), hi = 0;
+    uint64_t first_seq = std::numeric_limits<uint64_t>::max();
+    for (const auto& h : ext) {
+      lo = std::min(lo, h.min_addr);
+      hi = std::max(hi, h.max_addr);
+      if (h.first_seq < first_seq) {
+        first_seq = h.first_seq;
+        origin_ns = h.first_time_ns;
+      }
+    }
+    have_origin = first_seq != std::numeric_limits<uint64_t>::max();
+    if (lo > hi) {
+      std::cerr << "No samples found for event '" << cfg.event << "' in " << cfg.input << "\n";
+      return 1;
+    }
+    if (!cfg.have_addr_min) cfg.addr_min = lo;
+    if (!cfg.have_addr_max) cfg.addr_max = hi + 1;
+  }
+  if (cfg.addr_max <= cfg.addr_min) {
+    std::cerr << "--addr-max must be > --addr-min\n";
+    return 1;
+  }
+
+  const uint64_t lo = cfg.addr_min;
+  const uint64_t span = cfg.addr_max - cfg.addr_min;
+  const int fine_rows = cfg.ybins * (cfg.auto_ylim ? kAutoYlimOversample : 1);
+  const double row_scale = static_cast<double>(fine_rows) / static_cast<double>(span);
+  const uint64_t bin_ns = std::max<uint64_t>(1, static_cast<uint64_t>(cfg.time_bin_ms * 1e6));
+
+  // Time bins start at t=0 so the x axis lines up with the Python plot. When
+  // t=0 is not known up front (stdin without --time-zero) bins fall back to
+  // whole multiples of the bin width and t=0 is recovered after the pass.
+  if (cfg.have_time_zero) {
+    origin_ns = static_cast<uint64_t>(std::llround(cfg.time_zero * 1e9));
+    have_origin = true;
+  } else if (!have_origin && cfg.input != "-") {
+    have_origin = first_event_ns(cfg.input, cfg.event, &origin_ns);
+  }
+
+  sample_format::Source src;
+  if (!src.open(cfg.input)) {
+    std::cerr << src.error() << "\n";
+    return 1;
+  }
+
+  const int ev = src.intern_event(cfg.event);
+  const bool phys = src.has_phys();
+  std::vector<ThreadHist> hist(static_cast<size_t>(threads));
+  const bool ok = sample_format::for_each_block(&src, threads, [&](int w, uint64_t seq, const sample_format::Block& b) {
+    ThreadHist& h = hist[static_cast<size_t>(w)];
+    const std::vector<uint64_t>& addr = phys ? b.phys_addr : b.addr;
+    for (size_t i = 0; i < b.size(); i++) {
+      if (b.event[i] != ev) continue;
+      const uint64_t t = b.time_ns[i];
+      if (seq < h.first_seq) {
+        h.first_seq = seq;
+        h.first_time_ns = t;
+      }
+      const uint64_t a = addr[i];
+      if (a == 0 || a < lo || a - lo >= span) continue;
+      const int64_t d = static_cast<int64_t>(t - origin_ns);
+      const int64_t tb = d >= 0 ? d / static_cast<int64_t>(bin_ns)
+                                : -((-d + static_cast<int64_t>(bin_ns) - 1) / static_cast<int64_t>(bin_ns));
+      if (tb != h.cached_bin) {
+        auto& col = h.cols[tb];
+        if (col.empty()) col.assign(static_cast<size_t>(fine_rows), 0);
+        h.cached_bin = tb;
+        h.cached = col.data();
+      }
+      const int row = std::min(fine_rows - 1, static_cast<int>(static_cast<double>(a - lo) * row_scale));
+      h.cached[row]++;
+      h.samples++;
+    }
+  });
+  if (!ok) {
+    std::cerr << cfg.input << ": " << (src.error().empty() ? "corrupt input" : src.error()) << "\n";
+    return 1;
+  }
+
+  // Merge: time zero, x range, then the dense matrix.
+  uint64_t samples = 0;
+  uint64_t first_seq = std::numeric_limits<uint64_t>::max();
+  uint64_t first_time = 0;
+  int64_t bin_lo = std::numeric_limits<int64_t>::max();
+  int64_t bin_hi = std::numeric_limits<int64_t>::min();
+  for (const auto& h : hist) {
+    samples += h.samples;
+    if (h.first_seq < first_seq) {
+      first_seq = h.first_seq;
+      first_time = h.first_time_ns;
+    }
+    for (const auto& kv : h.cols) {
+      bin_lo = std::min(bin_lo, kv.first);
+      bin_hi = std::max(bin_hi, kv.first);
+    }
+  }
+  if (samples == 0) {
+    std::cerr << "No samples found for event '" << cfg.event << "' in " << cfg.input << "\n";
+    return 1;
+  }
+  const double t0_sec = cfg.have_time_zero ? cfg.time_zero
+                                            : static_cast<double>(have_origin ? origin_ns : first_time) / 1e9;
+  const double bin_sec = static_cast<double>(bin_ns) / 1e9;
+  const double origin_sec = static_cast<double>(origin_ns) / 1e9;
+  auto bin_start_rel = [&](int64_t tb) { return origin_sec + static_cast<double>(tb) * bin_sec - t0_sec; };
+  if (cfg.have_xmin) {
+    while (bin_lo <= bin_hi && bin_start_rel(bin_lo) + bin_sec <= cfg.xmin_sec) bin_lo++;
+  }
+  if (cfg.have_xmax) {
+    while (bin_hi >= bin_lo && bin_start_rel(bin_hi) >= cfg.xmax_sec) bin_hi--;
+  }
+  if (bin_hi < bin_lo) {
+    std::cerr << "No samples inside --xmin-sec/--xmax-sec\n";
+    return 1;
+  }
+
+  const size_t xbins = static_cast<size_t>(bin_hi - bin_lo + 1);
+  std::vector<uint64_t> fine(static_cast<size_t>(fine_rows) * xbins, 0);
+  for (const auto& h : hist) {
+    for (const auto& kv : h.cols) {
+      if (kv.first < bin_lo || kv.first > bin_hi) continue;
+      const size_t x = static_cast<size_t>(kv.first - bin_lo);
+      for (int r = 0; r < fine_rows; r++) fine[static_cast<size_t>(r) * xbins + x] += kv.second[static_cast<size_t>(r)];
+    }
+  }
+  hist.clear();
+
+  // Rows to keep. --auto-ylim picks percentile rows from the fine histogram,
+  // pads, clamps to the window and folds the crop back to ~ybins rows.
+  const double row_h = static_cast<double>(span) / fine_rows;
+  int r0 = 0, r1 = fine_rows;
+  int fold = 1;
+  if (cfg.auto_ylim) {
+    std::vector<uint64_t> row_tot(static_cast<size_t>(fine_rows), 0);
+    uint64_t total = 0;
+    for (int r = 0; r < fine_rows; r++) {
+      for (size_t x = 0; x < xbins; x++) row_tot[static_cast<size_t>(r)] += fine[static_cast<size_t>(r) * xbins + x];
+      total += row_tot[static_cast<size_t>(r)];
+    }
+    auto pct_row = [&](double pct) {
+      const double target = pct / 100.0 * static_cast<double>(total);
+      uint64_t acc = 0;
+      for (int r = 0; r < fine_rows; r++) {
+        acc += row_tot[static_cast<size_t>(r)];
+        if (static_cast<double>(acc) >= target && acc > 0) return r;
+      }
+      return fine_rows - 1;
+    };
+    const int pad_rows = static_cast<int>(std::ceil(cfg.auto_ylim_pad_gb * kGiB / row_h));
+    r0 = std::max(0, pct_row(cfg.auto_ylim_lo_pct) - pad_rows);
+    r1 = std::min(fine_rows, pct_row(cfg.auto_ylim_hi_pct) + 1 + pad_rows);
+    if (r1 <= r0) r1 = std::min(fine_rows, r0 + 1);
+    fold = std::max(1, (r1 - r0 + cfg.ybins - 1) / cfg.ybins);
+  }
+  const size_t ybins = static_cast<size_t>((r1 - r0 + fold - 1) / fold);
+  std::vector<uint64_t> m(ybins * xbins, 0);
+  for (int r = r0; r < r1; r++) {
+    const size_t y = static_cast<size_t>((r - r0) / fold);
+    for (size_t x = 0; x < xbins; x++) m[y * xbins + x] += fine[static_cast<size_t>(r) * xbins + x];
+  }
+  fine.clear();
+
+  const double y_base = cfg.y_offset && cfg.have_addr_min ? static_cast<double>(cfg.addr_min) : 0.0;
+  const double y0 = static_cast<double>(lo) + r0 * row_h - y_base;
+  const double y1 = std::min(static_cast<double>(cfg.addr_max), static_cast<double>(lo) + (r0 + ybins * fold) * row_h) - y_base;
+  const double x0 = bin_start_rel(bin_lo);
+  const double x1 = bin_start_rel(bin_hi) + bin_sec;
+
+  if (!write_npy(cfg.output, m, ybins, xbins)) return 1;
+
+  std::string json_path = cfg.output;
+  if (json_path.size() > 4 && json_path.compare(json_path.size() - 4, 4, ".npy") == 0) {
+    json_path.resize(json_path.size() - 4);
+  }
+  json_path += ".json";
+  FILE* jf = std::fopen(json_path.c_str(), "w");
+  if (!jf) {
+    std::cerr << "open " << json_path << " failed: " << std::strerror(errno) << "\n";
+    return 1;
+  }
+  std::fprintf(jf,
+               "{\n"
+               "  \"event\": \"%s\",\n"
+               "  \"samples\": %llu,\n"
+               "  \"xbins\": %zu,\n"
+               "  \"ybins\": %zu,\n"
+               "  \"x0\": %.9f,\n"
+               "  \"x1\": %.9f,\n"
+               "  \"y0\": %.1f,\n"
+               "  \"y1\": %.1f,\n"
+               "  \"time_zero\": %.9f,\n"
+               "  \"time_bin_sec\": %.9f,\n"
+               "  \"addr_min\": \"0x%llx\",\n"
+               "  \"addr_max\": \"0x%llx\",\n"
+               "  \"y_offset\": %s,\n"
+               "  \"auto_ylim\": %s\n"
+               "}\n",
+               cfg.event.c_str(), static_cast<unsigned long long>(samples), xbins, ybins, x0, x1, y0, y1, t0_sec,
+               bin_sec, static_cast<unsigned long long>(cfg.addr_min), static_cast<unsigned long long>(cfg.addr_max),
+               (cfg.y_offset && cfg.have_addr_min) ? "true" : "false", cfg.auto_ylim ? "true" : "false");
+  std::fclose(jf);
+
+  if (!cfg.png.empty()) {
+    uint64_t vmax = 0;
+    std::vector<uint64_t> nz;
+    for (uint64_t c : m) {
+      if (c == 0) continue;
+      vmax = std::max(vmax, c);
+      if (cfg.vmax_percentile > 0.0) nz.push_back(c);
+    }
+    if (cfg.vmax_percentile > 0.0 && !nz.empty()) {
+      const size_t k = std::min(nz.size() - 1, static_cast<size_t>(cfg.vmax_percentile / 100.0 * (nz.size() - 1)));
+      std::nth_element(nz.begin(), nz.begin() + static_cast<long>(k), nz.end());
+      vmax = std::max<uint64_t>(1, nz[k]);
+    }
+    const double log_max = std::log(static_cast<double>(std::max<uint64_t>(2, vmax)));
+    const uint32_t s = static_cast<uint32_t>(cfg.png_scale);
+    const uint32_t w = static_cast<uint32_t>(xbins) * s;
+    const uint32_t hgt = static_cast<uint32_t>(ybins) * s;
+    std::vector<uint8_t> rgb(static_cast<size_t>(w) * hgt * 3, 255);
+    for (size_t y = 0; y < ybins; y++) {
+      for (size_t x = 0; x < xbins; x++) {
+        const uint64_t c = m[y * xbins + x];
+        if (c == 0) continue;
+        uint8_t px[3];
+        blues(0.15 + 0.85 * std::log(static_cast<double>(c)) / log_max, px);
+        // Image row 0 is the top, i.e. the highest address.
+        for (uint32_t dy = 0; dy < s; dy++) {
+          const size_t iy = (ybins - 1 - y) * s + dy;
+          for (uint32_t dx = 0; dx < s; dx++) {
+            std::memcpy(&rgb[(iy * w + x * s + dx) * 3], px, 3);
+          }
+        }
+      }
+    }
+    if (!write_png(cfg.png, rgb, w, hgt)) return 1;
+  }
+
+  std::cout << "Wrote " << cfg.output << " (samples=" << samples << " bins=" << xbins << "x" << ybins
+            << " threads=" << threads << " elapsed_ms=" << (now_ms() - t_begin) << ")\n";
+  return 0;
+}
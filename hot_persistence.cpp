@@ -0,0 +1,449 @@
+// Streaming hot-page persistence engine (C++ side of hot_persistence.py).
+//
+// One pass over a sample file or points.txt computes the "% of baseline Top-K
+// pages still hot" series for several baseline windows and several K values at
+// once, so REF_WINDOW/TOPK sweeps don't re-read multi-GB captures:
+//
+//   ./hot_persistence --input=points.bin --ref-windows=1,2,5 --topk=1024,2048,8192
+//       --bin=5 --output=persist.csv   (one command)
+//   python3 hot_persistence.py --input=persist.csv --ref-window=2 --topk=2048 --output=persist.png
+//
+// Semantics follow hot_persistence.py: t=0 is the first sample of --event
+// inside the address window, the baseline is [ref_start, ref_start+ref_window),
+// later samples land in --bin sized bins starting at ref_start+ref_window, and
+// a bin's hot set is its Top-K pages by sample count. Count ties are broken by
+// lower page address (Python breaks them by first appearance).
+//
+// Each bin keeps an open-addressing page->count table that is reduced to its
+// Top-K and freed once the stream has moved --reorder-slack-sec past the bin
+// end, so memory is bounded by the pages touched in a few bins, not the run.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "sample_format.hpp"
+
+namespace {
+
+struct Config {
+  std::string input;
+  std::string output = "-";
+  std::string event = "cpu/mem-loads/pp";
+  bool have_addr_min = false;
+  bool have_addr_max = false;
+  uint64_t addr_min = 0;
+  uint64_t addr_max = 0;
+  uint64_t page_size = 4096;
+  double ref_start = 0.0;
+  std::vector<double> ref_windows = {1.0};
+  std::vector<size_t> topk = {1024};
+  double bin_sec = 5.0;
+  bool have_max_time = false;
+  double max_time = 0.0;
+  double reorder_slack_sec = -1.0;  // <0 => one bin
+};
+
+// Open-addressing page -> count table (linear probing, power-of-two capacity).
+class PageCounter {
+ public:
+  PageCounter() { reset(kInitialCap); }
+
+  void add(uint64_t page) {
+    if ((size_ + 1) * 10 > keys_.size() * 7) grow();
+    size_t i = slot(page);
+    while (keys_[i] != kEmpty && keys_[i] != page) i = (i + 1) & mask_;
+    if (keys_[i] == kEmpty) {
+      keys_[i] = page;
+      size_++;
+    }
+    counts_[i]++;
+  }
+
+  // Top-`k` pages by count (ties: lower page first), best first.
+  std::vector<uint64_t> top(size_t k) const {
+    std::vector<std::pair<uint64_t, uint64_t>> e;  // (count, page)
+    e.reserve(size_);
+    for (size_t i = 0; i < keys_.size(); i++) {
+      if (keys_[i] != kEmpty) e.emplace_back(counts_[i], keys_[i]);
+    }
+    k = std::min(k, e.size());
+    auto better = [](const std::pair<uint64_t, uint64_t>& a, const std::pair<uint64_t, uint64_t>& b) {
+      return a.first != b.first ? a.first > b.first : a.second < b.second;
+    };
+    std::partial_sort(e.begin(), e.begin() + static_cast<long>(k), e.end(), better);
+    std::vector<uint64_t> out(k);
+    for (size_t i = 0; i < k; i++) out[i] = e[i].second;
+    return out;
+  }
+
+  size_t size() const { return size_; }
+
+ private:
+  static constexpr uint64_t kEmpty = std::numeric_limits<uint64_t>::max();
+  static constexpr size_t kInitialCap = 1 << 12;
+
+  size_t slot(uint64_t page) const { return static_cast<size_t>((page * 0x9e3779b97f4a7c15ull) >> shift_); }
+
+  void reset(size_t cap) {
+    keys_.assign(cap, kEmpty);
+    counts_.assign(cap, 0);
+    mask_ = cap - 1;
+    shift_ = 64 - __builtin_ctzll(cap);
+    size_ = 0;
+  }
+
+  void grow() {
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> counts;
+    keys.swap(keys_);
+    counts.swap(counts_);
+    reset(keys.size() * 2);
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (keys[i] == kEmpty) continue;
+      size_t j = slot(keys[i]);
+      while (keys_[j] != kEmpty) j = (j + 1) & mask_;
+      keys_[j] = keys[i];
+      counts_[j] = counts[i];
+      size_++;
+    }
+  }
+
+  std::vector<uint64_t> keys_;
+  std::vector<uint64_t> counts_;
+  size_t mask_ = 0;
+  int shift_ = 64;
+  size_t size_ = 0;
+};
+
+// One baseline window: its baseline table/hot sets plus the open later bins.
+struct Series {
+  int64_t ref_end_ns = 0;
+  PageCounter baseline;
+  bool baseline_done = false;
+  std::vector<std::vector<uint64_t>> base_hot;  // per K, sorted by page
+  std::map<int64_t, PageCounter> open;          // bin index -> table
+  int64_t next_close = 0;                       // bins below this are final
+  std::map<int64_t, std::vector<double>> pct;   // bin index -> %still_hot per K
+  uint64_t late = 0;
+};
+
+static bool parse_flag(const char* arg, const char* name, const char** out_val) {
+  const size_t n = std::strlen(name);
+  if (std::strncmp(arg, name, n) != 0) return false;
+  if (arg[n] == '\0') {
+    *out_val = nullptr;
+    return true;
+  }
+  if (arg[n] != '=') return false;
+  *out_val = arg + n + 1;
+  return true;
+}
+
+template <typename T, typename Conv>
+static bool parse_list(const char* v, Conv conv, std::vector<T>* out) {
+  out->clear();
+  std::string s(v);
+  size_t pos = 0;
+  while (pos <= s.size()) {
+    const size_t comma = s.find(',', pos);
+    const std::string tok = s.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+    if (!tok.empty()) out->push_back(conv(tok));
+    if (comma == std::string::npos) break;
+    pos = comma + 1;
+  }
+  return !out->empty();
+}
+
+static void usage(const char* argv0) {
+  std::cerr
+      << "Usage: " << argv0 << " --input=<samples.bin|points.txt|-> [options]\n"
+      << "\n"
+      << "Options:\n"
+      << "  --output=<path.csv|->      Series CSV (default: stdout)\n"
+      << "  --event=<name>             Only keep this event (default: cpu/mem-loads/pp)\n"
+      << "  --addr-min=<hex>           Keep addresses >= this\n"
+      << "  --addr-max=<hex>           Keep addresses < this\n"
+      << "  --page-size=<bytes>        Page size for bucketing, power of two (default: 4096)\n"
+      << "  --ref-start=<sec>          Baseline window start (default: 0)\n"
+      << "  --ref-windows=<s,...>      Baseline window durations (default: 1)\n"
+      << "  --topk=<k,...>             Top-K sizes defining 'hot' (default: 1024)\n"
+      << "  --bin=<sec>                Bin size after the baseline (default: 5)\n"
+      << "  --max-time=<sec>           Ignore samples after this (relative) time\n"
+      << "  --reorder-slack-sec=<sec>  Keep bins open this long past their end for\n"
+      << "                             out-of-order samples (default: one bin)\n";
+}
+
+static bool parse_args(int argc, char** argv, Config* cfg) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = nullptr;
+
+    if (std::strcmp(a, "--help") == 0 || std::strcmp(a, "-h") == 0) {
+      usage(argv[0]);
+      return false;
+    }
+    if (parse_flag(a, "--input", &v) && v) {
+      cfg->input = v;
+      continue;
+    }
+    if (parse_flag(a, "--output", &v) && v) {
+      cfg->output = v;
+      continue;
+    }
+    if (parse_flag(a, "--event", &v) && v) {
+      cfg->event = v;
+      continue;
+    }
+    if (parse_flag(a, "--addr-min", &v) && v) {
+      cfg->addr_min = std::stoull(v, nullptr, 16);
+      cfg->have_addr_min = true;
+      continue;
+    }
+    if (parse_flag(a, "--addr-max", &v) && v) {
+      cfg->addr_max = std::stoull(v, nullptr, 16);
+      cfg->have_addr_max = true;
+      continue;
+    }
+    if (parse_flag(a, "--page-size", &v) && v) {
+      cfg->page_size = std::stoull(v);
+      if (cfg->page_size == 0 || (cfg->page_size & (cfg->page_size - 1)) != 0) {
+        std::cerr << "--page-size must be a power of two\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--ref-start", &v) && v) {
+      cfg->ref_start = std::stod(v);
+      continue;
+    }
+    if (parse_flag(a, "--ref-windows", &v) && v) {
+      if (!parse_list(v, [](const std::string& s) { return std::stod(s); }, &cfg->ref_windows)) {
+        std::cerr << "--ref-windows needs at least one value\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--topk", &v) && v) {
+      if (!parse_list(v, [](const std::string& s) { return static_cast<size_t>(std::stoull(s)); }, &cfg->topk)) {
+        std::cerr << "--topk needs at least one value\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--bin", &v) && v) {
+      cfg->bin_sec = std::stod(v);
+      continue;
+    }
+    if (parse_flag(a, "--max-time", &v) && v) {
+      cfg->max_time = std::stod(v);
+      cfg->have_max_time = true;
+      continue;
+    }
+    if (parse_flag(a, "--reorder-slack-sec", &v) && v) {
+      cfg->reorder_slack_sec = std::stod(v);
+      continue;
+    }
+
+    std::cerr << "Unknown arg: " << a << "\n";
+    usage(argv[0]);
+    return false;
+  }
+  if (cfg->input.empty()) {
+    std::cerr << "--input is required\n";
+    usage(argv[0]);
+    return false;
+  }
+  for (double w : cfg->ref_windows) {
+    if (!(w > 0.0)) {
+      std::cerr << "--ref-windows values must be > 0\n";
+      return false;
+    }
+  }
+  for (size_t k : cfg->topk) {
+    if (k == 0) {
+      std::cerr << "--topk values must be > 0\n";
+      return false;
+    }
+  }
+  if (!(cfg->bin_sec > 0.0)) {
+    std::cerr << "--bin must be > 0\n";
+    return false;
+  }
+  return true;
+}
+
+static int64_t to_ns(double sec) { return static_cast<int64_t>(std::llround(sec * 1e9)); }
+
+static size_t count_common(const std::vector<uint64_t>& sorted_a, std::vector<uint64_t> b) {
+  std::sort(b.begin(), b.end());
+  size_t n = 0;
+  for (uint64_t p : b) n += std::binary_search(sorted_a.begin(), sorted_a.end(), p) ? 1 : 0;
+  return n;
+}
+
+static uint64_t now_ms() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config cfg;
+  if (!parse_args(argc, argv, &cfg)) {
+    return 1;
+  }
+  const uint64_t t_begin = now_ms();
+
+  sample_format::Source src;
+  if (!src.open(cfg.input)) {
+    std::cerr << src.error() << "\n";
+    return 1;
+  }
+  const int ev = src.intern_event(cfg.event);
+  const bool phys = src.has_phys();
+  const size_t max_k = *std::max_element(cfg.topk.begin(), cfg.topk.end());
+  const int page_shift = __builtin_ctzll(cfg.page_size);
+  const int64_t ref_start_ns = to_ns(cfg.ref_start);
+  const int64_t bin_ns = std::max<int64_t>(1, to_ns(cfg.bin_sec));
+  const int64_t slack_ns = cfg.reorder_slack_sec < 0.0 ? bin_ns : to_ns(cfg.reorder_slack_sec);
+  const int64_t max_time_ns = to_ns(cfg.max_time);
+
+  std::vector<Series> series(cfg.ref_windows.size());
+  for (size_t j = 0; j < series.size(); j++) series[j].ref_end_ns = ref_start_ns + to_ns(cfg.ref_windows[j]);
+
+  auto finish_baseline = [&](Series& s) {
+    const std::vector<uint64_t> hot = s.baseline.top(max_k);
+    for (size_t k : cfg.topk) {
+      std::vector<uint64_t> h(hot.begin(), hot.begin() + static_cast<long>(std::min(k, hot.size())));
+      std::sort(h.begin(), h.end());
+      s.base_hot.push_back(std::move(h));
+    }
+    s.baseline = PageCounter();
+    s.baseline_done = true;
+  };
+  auto close_bin = [&](Series& s, int64_t idx, const PageCounter& pc) {
+    const std::vector<uint64_t> hot = pc.top(max_k);
+    std::vector<double>& out = s.pct[idx];
+    for (size_t ki = 0; ki < cfg.topk.size(); ki++) {
+      const std::vector<uint64_t>& base = s.base_hot[ki];
+      std::vector<uint64_t> h(hot.begin(), hot.begin() + static_cast<long>(std::min(cfg.topk[ki], hot.size())));
+      out.push_back(base.empty() || h.empty() ? 0.0 : 100.0 * count_common(base, std::move(h)) / base.size());
+    }
+  };
+  // Finalize everything that ends at or before `horizon_ns` (relative time).
+  auto advance = [&](Series& s, int64_t horizon_ns) {
+    if (!s.baseline_done) {
+      if (s.ref_end_ns > horizon_ns) return;
+      finish_baseline(s);
+    }
+    while (!s.open.empty()) {
+      auto it = s.open.begin();
+      if (s.ref_end_ns + (it->first + 1) * bin_ns > horizon_ns) break;
+      close_bin(s, it->first, it->second);
+      s.next_close = it->first + 1;
+      s.open.erase(it);
+    }
+  };
+
+  bool have_t0 = false;
+  uint64_t t0 = 0;
+  int64_t t_max_seen = 0;
+  uint64_t samples = 0;
+  sample_format::Block b;
+  while (src.next(&b)) {
+    const std::vector<uint64_t>& addr = phys ? b.phys_addr : b.addr;
+    for (size_t i = 0; i < b.size(); i++) {
+      if (b.event[i] != ev) continue;
+      const uint64_t a = addr[i];
+      if (a == 0) continue;
+      if (cfg.have_addr_min && a < cfg.addr_min) continue;
+      if (cfg.have_addr_max && a >= cfg.addr_max) continue;
+      if (!have_t0) {
+        t0 = b.time_ns[i];
+        have_t0 = true;
+      }
+      const int64_t t = static_cast<int64_t>(b.time_ns[i] - t0);
+      if (t < 0) continue;
+      if (cfg.have_max_time && t > max_time_ns) continue;
+      samples++;
+
+      const uint64_t page = a >> page_shift;
+      for (Series& s : series) {
+        if (t >= ref_start_ns && t < s.ref_end_ns) {
+          if (s.baseline_done) {
+            s.late++;
+          } else {
+            s.baseline.add(page);
+          }
+        } else if (t >= s.ref_end_ns) {
+          const int64_t idx = (t - s.ref_end_ns) / bin_ns;
+          if (idx < s.next_close) {
+            s.late++;
+          } else {
+            s.open[idx].add(page);
+          }
+        }
+      }
+      if (t > t_max_seen + bin_ns / 8) {
+        t_max_seen = t;
+        for (Series& s : series) advance(s, t_max_seen - slack_ns);
+      }
+    }
+  }
+  if (!src.error().empty()) {
+    std::cerr << cfg.input << ": " << src.error() << "\n";
+    return 1;
+  }
+  if (!have_t0) {
+    std::cerr << "No samples found for event '" << cfg.event << "' in " << cfg.input << "\n";
+    return 1;
+  }
+  for (Series& s : series) advance(s, std::numeric_limits<int64_t>::max());
+
+  FILE* out = (cfg.output == "-") ? stdout : std::fopen(cfg.output.c_str(), "w");
+  if (!out) {
+    std::cerr << "open " << cfg.output << " failed: " << std::strerror(errno) << "\n";
+    return 1;
+  }
+  std::fprintf(out, "ref_start_sec,ref_window_sec,topk,bin,start_sec,end_sec,pct_still_hot,baseline_hot\n");
+  for (size_t j = 0; j < series.size(); j++) {
+    const Series& s = series[j];
+    if (s.base_hot.empty() || s.base_hot[0].empty()) {
+      std::cerr << "[WARN] ref_window=" << cfg.ref_windows[j] << ": baseline window has no samples\n";
+      continue;
+    }
+    const int64_t max_idx = s.pct.empty() ? -1 : s.pct.rbegin()->first;
+    for (size_t ki = 0; ki < cfg.topk.size(); ki++) {
+      for (int64_t idx = 0; idx <= max_idx; idx++) {
+        auto it = s.pct.find(idx);
+        const double pct = (it == s.pct.end()) ? 0.0 : it->second[ki];
+        const double start = static_cast<double>(s.ref_end_ns + idx * bin_ns) / 1e9;
+        std::fprintf(out, "%g,%g,%zu,%lld,%.3f,%.3f,%.4f,%zu\n", cfg.ref_start, cfg.ref_windows[j], cfg.topk[ki],
+                     static_cast<long long>(idx), start, start + cfg.bin_sec, pct, s.base_hot[ki].size());
+      }
+    }
+    if (s.late > 0) {
+      std::cerr << "[WARN] ref_window=" << cfg.ref_windows[j] << ": dropped " << s.late
+                << " samples that arrived after their bin closed (raise --reorder-slack-sec)\n";
+    }
+  }
+  if (out != stdout && std::fclose(out) != 0) {
+    std::cerr << "write " << cfg.output << " failed\n";
+    return 1;
+  }
+
+  std::cerr << "Done. samples=" << samples << " series=" << series.size() << "x" << cfg.topk.size()
+            << " elapsed_ms=" << (now_ms() - t_begin) << "\n";
+  return 0;
+}
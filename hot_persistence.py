@@ -4,6 +4,9 @@ Hot-page persistence plot (like "still hot after Δt").
 
 Input: perf script output with fields time,event,addr, e.g.:
   50858.386645:   cpu/mem-loads/pp:     7a6c1a8214c0
+or a binary sample file (pebs_sampler / points_convert, see sample_format.py),
+or a series CSV from the C++ `hot_persistence` engine (plots the series that
+matches --ref-window/--topk without re-reading samples).
 
 Method:
   - Define a baseline window [ref_start, ref_start+ref_window)
@@ -17,6 +20,7 @@ Outputs a bar chart.
 from __future__ import annotations
 
 import argparse
+import csv
 import re
 from collections import Counter
 from pathlib import Path
@@ -24,6 +28,8 @@ import sys
 
 import matplotlib.pyplot as plt
 
+import sample_format
+
 
 LINE_RE = re.compile(
     r"^\s*(?P<time>[0-9]+(?:\.[0-9]+)?)\s*:?\s+(?P<event>\S+?)\s*:?\s+(?P<addr>[0-9a-fA-F]+)\s*$"
@@ -32,7 +38,7 @@ LINE_RE = re.compile(
 
 def parse_args() -> argparse.Namespace:
     p = argparse.ArgumentParser()
-    p.add_argument("--input", required=True, help="perf script txt (time,event,addr)")
+    p.add_argument("--input", required=True, help="perf script txt (time,event,addr), sample file, or hot_persistence CSV")
     p.add_argument("--output", required=True, help="Output PNG path")
     p.add_argument("--title", default="Hot-page persistence", help="Figure title")
     p.add_argument("--event-filter", default="cpu/mem-loads/pp", help="Keep only this perf event")
@@ -53,7 +59,12 @@ def parse_args() -> argparse.Namespace:
 
     p.add_argument("--page-size", type=int, default=4096, help="Page size for bucketing")
 
-    p.add_argument("--ref-start", type=float, default=0.0, help="Baseline window start (sec, relative)")
+    p.add_argument(
+        "--ref-start",
+        type=float,
+        default=None,
+        help="Baseline window start (sec, relative; default: 0, or the CSV's ref_start_sec)",
+    )
     p.add_argument("--ref-window", type=float, default=1.0, help="Baseline window duration (sec)")
     p.add_argument("--topk", type=int, default=1024, help="Define 'hot' as Top-K pages")
 
@@ -64,6 +75,55 @@ def parse_args() -> argparse.Namespace:
     return p.parse_args()
 
 
+def _iter_samples(in_path: Path | None):
+    """Yield (time_sec, event, addr) from points.txt text or a binary sample file."""
+    if in_path is not None and sample_format.is_sample_file(in_path):
+        yield from sample_format.iter_points(in_path)
+        return
+    f = sys.stdin if in_path is None else in_path.open("r", encoding="utf-8", errors="ignore")
+    with f:
+        for line in f:
+            m = LINE_RE.match(line)
+            if not m:
+                continue
+            yield float(m.group("time")), m.group("event").rstrip(":"), int(m.group("addr"), 16)
+
+
+def _load_series_csv(
+    in_path: Path, ref_start: float | None, ref_window: float, topk: int
+) -> tuple[list[float], list[tuple[float, float]], int, float]:
+    """Read one (ref_window, topk) series from a `hot_persistence` CSV.
+
+    Also returns the baseline start the series was computed with. A
+    `ref_start` that disagrees with the CSV is an error, since the series
+    cannot be recomputed here.
+    """
+    pct: list[float] = []
+    spans: list[tuple[float, float]] = []
+    base_hot = 0
+    csv_ref_start: float | None = None
+    with in_path.open("r", encoding="utf-8") as f:
+        for row in csv.DictReader(f):
+            if abs(float(row["ref_window_sec"]) - ref_window) > 1e-9 or int(row["topk"]) != topk:
+                continue
+            if row.get("ref_start_sec") is not None:
+                csv_ref_start = float(row["ref_start_sec"])
+            pct.append(float(row["pct_still_hot"]))
+            spans.append((float(row["start_sec"]), float(row["end_sec"])))
+            base_hot = int(row["baseline_hot"])
+    if not pct:
+        raise SystemExit(f"{in_path}: no series for ref_window={ref_window:g} topk={topk}")
+    if csv_ref_start is None:
+        # CSVs from before the ref_start_sec column carry no baseline start.
+        csv_ref_start = 0.0 if ref_start is None else ref_start
+    elif ref_start is not None and abs(ref_start - csv_ref_start) > 1e-9:
+        raise SystemExit(
+            f"{in_path}: computed with ref_start={csv_ref_start:g}, but --ref-start={ref_start:g}; "
+            "rerun hot_persistence with the new --ref-start"
+        )
+    return pct, spans, base_hot, csv_ref_start
+
+
 def topk_pages(counter: Counter[int], k: int) -> set[int]:
     if not counter:
         return set()
@@ -206,23 +266,70 @@ def _ensure_png_rgb(out_path: Path) -> None:
         return
 
 
-def main() -> int:
-    args = parse_args()
-    in_path = Path(args.input) if args.input != "-" else None
-    out_path = Path(args.output)
-
+def _add_counts(counter: Counter[int], pages) -> None:
+    """counter[p] += occurrences of p in `pages` (numpy), new pages added in
+    order of first appearance so most_common() ties match the per-sample loop."""
+    np = sample_format.np
+    keys, first, cnt = np.unique(pages, return_index=True, return_counts=True)
+    for i in np.argsort(first, kind="stable").tolist():
+        counter[int(keys[i])] += int(cnt[i])
+
+
+def _count_pages_columns(
+    args: argparse.Namespace,
+    in_path: Path,
+    addr_min: int | None,
+    addr_max: int | None,
+    ref_start: float,
+    ref_end: float,
+    bin_size: float,
+    baseline: Counter[int],
+    bins: dict[int, Counter[int]],
+) -> tuple[float | None, float | None]:
+    """The per-sample loop of _compute_series over numpy columns of a sample file.
+
+    Fills `baseline` and `bins`; returns (t0, t_last) like the loop does."""
+    np = sample_format.np
+    page_mask = np.uint64(~(args.page_size - 1) & 0xFFFF_FFFF_FFFF_FFFF)
+    t0: float | None = None
+    t_last: float | None = None
+    for t_abs, _ev, a in sample_format.iter_columns(in_path, events=[args.event_filter]):
+        keep = a != 0
+        if addr_min is not None:
+            keep &= a >= np.uint64(addr_min)
+        if addr_max is not None:
+            keep &= a < np.uint64(addr_max)
+        if not keep.any():
+            continue
+        t_abs, a = t_abs[keep], a[keep]
+        if t0 is None:
+            t0 = float(t_abs[0])
+        t_last = float(t_abs[-1])
+
+        t = t_abs - t0
+        keep = t >= 0
+        if args.max_time is not None:
+            keep &= t <= float(args.max_time)
+        t, pages = t[keep], a[keep] & page_mask
+
+        in_base = (t >= ref_start) & (t < ref_end)
+        if in_base.any():
+            _add_counts(baseline, pages[in_base])
+        after = t >= ref_end
+        if after.any():
+            idx = ((t[after] - ref_end) // bin_size).astype(np.int64)
+            p_after = pages[after]
+            for i in np.unique(idx).tolist():
+                _add_counts(bins.setdefault(i, Counter()), p_after[idx == i])
+    return t0, t_last
+
+
+def _compute_series(
+    args: argparse.Namespace, in_path: Path | None, ref_start: float, ref_end: float, bin_size: float
+) -> tuple[list[float], list[tuple[float, float]], int]:
     addr_min = int(args.addr_min, 16) if args.addr_min else None
     addr_max = int(args.addr_max, 16) if args.addr_max else None
 
-    ref_start = float(args.ref_start)
-    ref_end = ref_start + float(args.ref_window)
-    if ref_end <= ref_start:
-        raise SystemExit("--ref-window must be > 0")
-
-    bin_size = float(args.bin)
-    if bin_size <= 0:
-        raise SystemExit("--bin must be > 0")
-
     baseline = Counter[int]()
     bins: dict[int, Counter[int]] = {}
 
@@ -231,17 +338,14 @@ def main() -> int:
     t0: float | None = None
     t_last: float | None = None
 
-    f = sys.stdin if in_path is None else in_path.open("r", encoding="utf-8", errors="ignore")
-    with f:
-        for line in f:
-            m = LINE_RE.match(line)
-            if not m:
-                continue
-            ev = m.group("event").rstrip(":")
+    if in_path is not None and sample_format.HAVE_NUMPY and sample_format.is_sample_file(in_path):
+        t0, t_last = _count_pages_columns(
+            args, in_path, addr_min, addr_max, ref_start, ref_end, bin_size, baseline, bins
+        )
+    else:
+        for t_abs, ev, a in _iter_samples(in_path):
             if ev != args.event_filter:
                 continue
-            t_abs = float(m.group("time"))
-            a = int(m.group("addr"), 16)
             if a == 0:
                 continue
             if addr_min is not None and a < addr_min:
@@ -278,7 +382,7 @@ def main() -> int:
         raise SystemExit("No samples found after baseline window; increase --max-time/recording duration.")
 
     pct_still_hot: list[float] = []
-    bin_labels: list[str] = []
+    spans: list[tuple[float, float]] = []
     for i in range(max_idx + 1):
         hot_i = topk_pages(bins.get(i, Counter()), int(args.topk))
         if not hot_i:
@@ -286,11 +390,38 @@ def main() -> int:
         else:
             pct = 100.0 * (len(base_hot & hot_i) / len(base_hot))
         pct_still_hot.append(pct)
+        spans.append((ref_end + i * bin_size, ref_end + (i + 1) * bin_size))
 
+    return pct_still_hot, spans, len(base_hot)
+
+
+def main() -> int:
+    args = parse_args()
+    in_path = Path(args.input) if args.input != "-" else None
+    out_path = Path(args.output)
+
+    ref_start = 0.0 if args.ref_start is None else float(args.ref_start)
+    if float(args.ref_window) <= 0:
+        raise SystemExit("--ref-window must be > 0")
+
+    bin_size = float(args.bin)
+    if bin_size <= 0:
+        raise SystemExit("--bin must be > 0")
+
+    if in_path is not None and in_path.suffix == ".csv":
+        pct_still_hot, spans, n_base_hot, ref_start = _load_series_csv(
+            in_path, args.ref_start, float(args.ref_window), int(args.topk)
+        )
+        ref_end = ref_start + float(args.ref_window)
+        bin_size = spans[0][1] - spans[0][0]
+    else:
+        ref_end = ref_start + float(args.ref_window)
+        pct_still_hot, spans, n_base_hot = _compute_series(args, in_path, ref_start, ref_end, bin_size)
+
+    bin_labels: list[str] = []
+    total_s = spans[-1][1]
+    for start_s, end_s in spans:
         # Label bins (use seconds for short runs, otherwise minutes)
-        start_s = ref_end + i * bin_size
-        end_s = ref_end + (i + 1) * bin_size
-        total_s = ref_end + (max_idx + 1) * bin_size
         if total_s < 5 * 60:
             bin_labels.append(f"{start_s:.0f}-{end_s:.0f}s")
             xlabel = "Time elapsed (seconds)"
@@ -298,7 +429,7 @@ def main() -> int:
             bin_labels.append(f"{start_s/60.0:.2f}-{end_s/60.0:.2f}m")
             xlabel = "Time elapsed (minutes)"
 
-    annotation = f"baseline=[{ref_start:.2f},{ref_end:.2f})s  TopK={len(base_hot)}  bin={bin_size:.1f}s"
+    annotation = f"baseline=[{ref_start:.2f},{ref_end:.2f})s  TopK={n_base_hot}  bin={bin_size:.1f}s"
     ylabel = "% of pages still hot"
 
     use_hachimiku = False
@@ -331,7 +462,7 @@ def main() -> int:
         )
 
     _ensure_png_rgb(out_path)
-    print(f"Wrote {out_path} (baseline_hot={len(base_hot)} bins={max_idx + 1})")
+    print(f"Wrote {out_path} (baseline_hot={n_base_hot} bins={len(pct_still_hot)})")
     return 0
 
 
@@ -0,0 +1,429 @@
+// One-pass dominant address-range inference (C++ side of infer_addr_range.py).
+//
+// infer_addr_range.py stops after --max-lines samples because Python is slow,
+// so on large multi-region heaps the chosen bucket/window depends on whatever
+// the first 200k samples happened to touch. This tool scans the whole sample
+// stream (sample file or points.txt, "-" = stdin) on all CPUs and then applies
+// the same selection logic to the full histogram.
+//
+// Output matches the Python script: "<min_hex> <max_hex> <count>". Exit code 1
+// means no usable samples.
+//
+//   ./infer_addr_range --input=points.bin --mode=window --window-gb=12 --window-strategy=best
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sample_format.hpp"
+
+namespace {
+
+enum class Mode { kDominant, kWindow };
+enum class Strategy { kBest, kMin, kMax, kAround };
+
+struct Config {
+  std::string input = "-";
+  std::string event = "cpu/mem-loads/pp";
+  int bucket_bits = 30;
+  Mode mode = Mode::kDominant;
+  int window_gb = 12;
+  Strategy strategy = Strategy::kAround;
+  uint64_t min_bucket_samples = 1000;
+  bool window_full = false;
+  uint64_t max_lines = 0;  // 0 => all samples
+  bool keep_kernel = false;
+  int drop_top_buckets = 0;
+  int threads = 0;  // 0 => hardware_concurrency
+};
+
+struct BucketStat {
+  uint64_t count = 0;
+  uint64_t min = std::numeric_limits<uint64_t>::max();
+  uint64_t max = 0;
+};
+
+// Per-thread bucket histogram. Heaps touch few distinct buckets, so a small
+// open-addressing table with a last-bucket cache keeps the hot loop tight.
+class alignas(64) BucketTable {
+ public:
+  BucketTable() { reset(64); }
+
+  BucketStat& at(uint64_t bucket) {
+    if (bucket == last_key_ && last_ != nullptr) return *last_;
+    if ((size_ + 1) * 2 > keys_.size()) grow();
+    size_t i = slot(bucket);
+    while (used_[i] && keys_[i] != bucket) i = (i + 1) & mask_;
+    if (!used_[i]) {
+      used_[i] = 1;
+      keys_[i] = bucket;
+      size_++;
+    }
+    last_key_ = bucket;
+    last_ = &stats_[i];
+    return *last_;
+  }
+
+  template <typename F>
+  void for_each(F&& fn) const {
+    for (size_t i = 0; i < keys_.size(); i++) {
+      if (used_[i]) fn(keys_[i], stats_[i]);
+    }
+  }
+
+ private:
+  size_t slot(uint64_t k) const { return static_cast<size_t>((k * 0x9e3779b97f4a7c15ull) >> shift_); }
+
+  void reset(size_t cap) {
+    keys_.assign(cap, 0);
+    stats_.assign(cap, BucketStat());
+    used_.assign(cap, 0);
+    mask_ = cap - 1;
+    shift_ = 64 - __builtin_ctzll(cap);
+    size_ = 0;
+    last_ = nullptr;
+  }
+
+  void grow() {
+    std::vector<uint64_t> keys;
+    std::vector<BucketStat> stats;
+    std::vector<uint8_t> used;
+    keys.swap(keys_);
+    stats.swap(stats_);
+    used.swap(used_);
+    reset(keys.size() * 2);
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (!used[i]) continue;
+      size_t j = slot(keys[i]);
+      while (used_[j]) j = (j + 1) & mask_;
+      used_[j] = 1;
+      keys_[j] = keys[i];
+      stats_[j] = stats[i];
+      size_++;
+    }
+  }
+
+  std::vector<uint64_t> keys_;
+  std::vector<BucketStat> stats_;
+  std::vector<uint8_t> used_;
+  size_t mask_ = 0;
+  int shift_ = 64;
+  size_t size_ = 0;
+  uint64_t last_key_ = 0;
+  BucketStat* last_ = nullptr;
+};
+
+static bool parse_flag(const char* arg, const char* name, const char** out_val) {
+  const size_t n = std::strlen(name);
+  if (std::strncmp(arg, name, n) != 0) return false;
+  if (arg[n] == '\0') {
+    *out_val = nullptr;
+    return true;
+  }
+  if (arg[n] != '=') return false;
+  *out_val = arg + n + 1;
+  return true;
+}
+
+static void usage(const char* argv0) {
+  std::cerr
+      << "Usage: " << argv0 << " [--input=<samples.bin|points.txt|->] [options]\n"
+      << "\n"
+      << "Options (same meaning as infer_addr_range.py):\n"
+      << "  --event=<name>                 Only keep this event (default: cpu/mem-loads/pp)\n"
+      << "  --bucket-bits=<n>              Bucket size 2^n bytes (default: 30 = 1 GiB)\n"
+      << "  --mode=dominant|window         (default: dominant)\n"
+      << "  --window-gb=<n>                Window size in buckets (default: 12)\n"
+      << "  --window-strategy=best|min|max|around  (default: around)\n"
+      << "  --min-bucket-samples=<n>       Ignore smaller buckets in window mode (default: 1000)\n"
+      << "  --window-output=observed|full  (default: observed)\n"
+      << "  --max-lines=<n>                Stop after n matching samples (default: 0 = all)\n"
+      << "  --keep-kernel                  Keep addresses >= 0x8000000000000000\n"
+      << "  --drop-top-buckets=<n>         Drop the n highest-address buckets first\n"
+      << "  --threads=<n>                  Worker threads (default: all CPUs; 1 with --max-lines)\n";
+}
+
+static bool parse_args(int argc, char** argv, Config* cfg) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = nullptr;
+
+    if (std::strcmp(a, "--help") == 0 || std::strcmp(a, "-h") == 0) {
+      usage(argv[0]);
+      return false;
+    }
+    if (parse_flag(a, "--input", &v) && v) {
+      cfg->input = v;
+      continue;
+    }
+    if (parse_flag(a, "--event", &v) && v) {
+      cfg->event = v;
+      continue;
+    }
+    if (parse_flag(a, "--bucket-bits", &v) && v) {
+      cfg->bucket_bits = std::stoi(v);
+      if (cfg->bucket_bits < 0 || cfg->bucket_bits > 63) {
+        std::cerr << "--bucket-bits must be in [0, 63]\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--mode", &v) && v) {
+      if (std::strcmp(v, "dominant") == 0) {
+        cfg->mode = Mode::kDominant;
+      } else if (std::strcmp(v, "window") == 0) {
+        cfg->mode = Mode::kWindow;
+      } else {
+        std::cerr << "Invalid --mode: " << v << "\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--window-gb", &v) && v) {
+      cfg->window_gb = std::max(1, std::stoi(v));
+      continue;
+    }
+    if (parse_flag(a, "--window-strategy", &v) && v) {
+      if (std::strcmp(v, "best") == 0) {
+        cfg->strategy = Strategy::kBest;
+      } else if (std::strcmp(v, "min") == 0) {
+        cfg->strategy = Strategy::kMin;
+      } else if (std::strcmp(v, "max") == 0) {
+        cfg->strategy = Strategy::kMax;
+      } else if (std::strcmp(v, "around") == 0) {
+        cfg->strategy = Strategy::kAround;
+      } else {
+        std::cerr << "Invalid --window-strategy: " << v << "\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--min-bucket-samples", &v) && v) {
+      cfg->min_bucket_samples = std::stoull(v);
+      continue;
+    }
+    if (parse_flag(a, "--window-output", &v) && v) {
+      if (std::strcmp(v, "observed") == 0) {
+        cfg->window_full = false;
+      } else if (std::strcmp(v, "full") == 0) {
+        cfg->window_full = true;
+      } else {
+        std::cerr << "Invalid --window-output: " << v << "\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--max-lines", &v) && v) {
+      cfg->max_lines = std::stoull(v);
+      continue;
+    }
+    if (parse_flag(a, "--keep-kernel", &v)) {
+      cfg->keep_kernel = (v == nullptr) || (std::stoi(v) != 0);
+      continue;
+    }
+    if (parse_flag(a, "--drop-top-buckets", &v) && v) {
+      cfg->drop_top_buckets = std::max(0, std::stoi(v));
+      continue;
+    }
+    if (parse_flag(a, "--threads", &v) && v) {
+      cfg->threads = std::max(1, std::stoi(v));
+      continue;
+    }
+
+    std::cerr << "Unknown arg: " << a << "\n";
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+static uint64_t window_sum(const std::map<int64_t, BucketStat>& b, int64_t s, int64_t w) {
+  uint64_t sum = 0;
+  for (auto it = b.lower_bound(s); it != b.end() && it->first < s + w; ++it) sum += it->second.count;
+  return sum;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config cfg;
+  if (!parse_args(argc, argv, &cfg)) {
+    return 2;
+  }
+  // A sample prefix only means something in file order.
+  const int threads = cfg.max_lines > 0 ? 1
+                      : cfg.threads > 0 ? cfg.threads
+                                        : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+  sample_format::Source src;
+  if (!src.open(cfg.input)) {
+    std::cerr << src.error() << "\n";
+    return 2;
+  }
+  const int ev = src.intern_event(cfg.event);
+  const bool phys = src.has_phys();
+  const int shift = cfg.bucket_bits;
+  const uint64_t addr_limit = cfg.keep_kernel ? std::numeric_limits<uint64_t>::max() : 0x8000000000000000ull;
+
+  std::vector<BucketTable> tables(static_cast<size_t>(threads));
+  std::vector<std::vector<uint64_t>> scratch(static_cast<size_t>(threads));
+  std::vector<uint64_t> seen(static_cast<size_t>(threads) * 8, 0);  // one cache line per worker
+  const bool ok = sample_format::for_each_block(&src, threads, [&](int w, uint64_t, const sample_format::Block& b) {
+    BucketTable& tab = tables[static_cast<size_t>(w)];
+    uint64_t& n = seen[static_cast<size_t>(w) * 8];
+    if (cfg.max_lines > 0 && n >= cfg.max_lines) return;
+    // Branch-free compaction of matching addresses first, then a counting pass
+    // over the (mostly repeating) bucket ids.
+    const std::vector<uint64_t>& addr = phys ? b.phys_addr : b.addr;
+    const size_t cnt = b.size();
+    std::vector<uint64_t>& keep = scratch[static_cast<size_t>(w)];
+    keep.resize(cnt);
+    size_t m = 0;
+    for (size_t i = 0; i < cnt; i++) {
+      const uint64_t a = addr[i];
+      keep[m] = a;
+      m += static_cast<size_t>((b.event[i] == ev) & (a != 0) & (a < addr_limit));
+    }
+    size_t end = m;
+    if (cfg.max_lines > 0) end = std::min<uint64_t>(end, cfg.max_lines - n);
+    for (size_t i = 0; i < end; i++) {
+      const uint64_t a = keep[i];
+      BucketStat& st = tab.at(a >> shift);
+      st.count++;
+      st.min = std::min(st.min, a);
+      st.max = std::max(st.max, a);
+    }
+    n += end;
+  });
+  if (!ok) {
+    std::cerr << cfg.input << ": " << (src.error().empty() ? "corrupt input" : src.error()) << "\n";
+    return 2;
+  }
+
+  // Merge. Bucket ids fit in int64 for any shift >= 1; the Python script uses
+  // signed ints for the window arithmetic, so do the same.
+  std::map<int64_t, BucketStat> buckets;
+  for (const auto& t : tables) {
+    t.for_each([&](uint64_t k, const BucketStat& s) {
+      BucketStat& d = buckets[static_cast<int64_t>(k)];
+      d.count += s.count;
+      d.min = std::min(d.min, s.min);
+      d.max = std::max(d.max, s.max);
+    });
+  }
+  if (buckets.empty()) return 1;
+
+  // Optional: drop highest-address buckets (often stack/vdso/vvar buckets).
+  if (cfg.drop_top_buckets > 0 && buckets.size() > static_cast<size_t>(cfg.drop_top_buckets)) {
+    for (int i = 0; i < cfg.drop_top_buckets; i++) buckets.erase(std::prev(buckets.end()));
+    if (buckets.empty()) return 1;
+  }
+
+  // Filter out tiny outlier buckets (only affects window selection).
+  if (cfg.mode == Mode::kWindow && cfg.min_bucket_samples > 0) {
+    for (auto it = buckets.begin(); it != buckets.end();) {
+      it = (it->second.count < cfg.min_bucket_samples) ? buckets.erase(it) : std::next(it);
+    }
+    if (buckets.empty()) return 1;
+  }
+
+  // Counter.most_common(1): highest count, first inserted on ties. Insertion
+  // order is not meaningful after a parallel merge, so ties go to the lowest
+  // address bucket.
+  auto dominant = [&]() {
+    auto best = buckets.begin();
+    for (auto it = buckets.begin(); it != buckets.end(); ++it) {
+      if (it->second.count > best->second.count) best = it;
+    }
+    return best;
+  };
+
+  if (cfg.mode == Mode::kDominant) {
+    const BucketStat& s = dominant()->second;
+    std::printf("0x%" PRIx64 " 0x%" PRIx64 " %" PRIu64 "\n", s.min, s.max, s.count);
+    return 0;
+  }
+
+  const int64_t w = cfg.window_gb;
+  const int64_t b_min = buckets.begin()->first;
+  const int64_t b_max = std::prev(buckets.end())->first;
+  int64_t best_s = b_min;
+  uint64_t best_sum = 0;
+  switch (cfg.strategy) {
+    case Strategy::kMin:
+      best_s = b_min;
+      best_sum = window_sum(buckets, best_s, w);
+      break;
+    case Strategy::kMax:
+      best_s = std::max(b_min, b_max - w + 1);
+      best_sum = window_sum(buckets, best_s, w);
+      break;
+    case Strategy::kAround:
+      best_s = dominant()->first - (w / 2);
+      best_s = std::max(b_min, std::min(best_s, b_max - w + 1));
+      best_sum = window_sum(buckets, best_s, w);
+      break;
+    case Strategy::kBest: {
+      // The window sum only changes when a boundary crosses an occupied bucket,
+      // so candidate starts are b and b-w+1 for every occupied b. Slide over
+      // them in order with two pointers instead of re-summing each window.
+      int64_t lo = b_min;
+      int64_t hi = b_max - w + 1;
+      if (hi < lo) lo = hi = b_min;
+      std::vector<int64_t> cands;
+      cands.reserve(buckets.size() * 2);
+      for (const auto& kv : buckets) {
+        if (kv.first >= lo && kv.first <= hi) cands.push_back(kv.first);
+        if (kv.first - w + 1 >= lo && kv.first - w + 1 <= hi) cands.push_back(kv.first - w + 1);
+      }
+      std::sort(cands.begin(), cands.end());
+      cands.erase(std::unique(cands.begin(), cands.end()), cands.end());
+      if (cands.empty()) cands.push_back(std::max(lo, std::min(b_min, hi)));
+
+      std::vector<std::pair<int64_t, uint64_t>> occ;
+      occ.reserve(buckets.size());
+      for (const auto& kv : buckets) occ.emplace_back(kv.first, kv.second.count);
+      size_t head = 0, tail = 0;
+      uint64_t sum = 0;
+      bool first = true;
+      for (int64_t s : cands) {
+        while (tail < occ.size() && occ[tail].first < s + w) sum += occ[tail++].second;
+        while (head < tail && occ[head].first < s) sum -= occ[head++].second;
+        if (first || sum > best_sum) {
+          best_sum = sum;
+          best_s = s;
+          first = false;
+        }
+      }
+      break;
+    }
+  }
+
+  const uint64_t start_addr = static_cast<uint64_t>(best_s) << shift;
+  const uint64_t end_addr_excl = static_cast<uint64_t>(best_s + w) << shift;
+  if (cfg.window_full) {
+    // Exact window bounds so downstream plots have a consistent axis span.
+    std::printf("0x%" PRIx64 " 0x%" PRIx64 " %" PRIu64 "\n", start_addr, end_addr_excl, best_sum);
+    return 0;
+  }
+  uint64_t out_min = std::numeric_limits<uint64_t>::max();
+  uint64_t out_max = 0;
+  for (auto it = buckets.lower_bound(best_s); it != buckets.end() && it->first < best_s + w; ++it) {
+    out_min = std::min(out_min, it->second.min);
+    out_max = std::max(out_max, it->second.max);
+  }
+  if (out_min > out_max) {
+    out_min = start_addr;
+    out_max = end_addr_excl - 1;
+  }
+  std::printf("0x%" PRIx64 " 0x%" PRIx64 " %" PRIu64 "\n", out_min, out_max, best_sum);
+  return 0;
+}
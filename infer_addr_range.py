@@ -4,6 +4,7 @@ Infer a dominant virtual-address range from perf script text output.
 
 Reads lines like:
   59156.754553:   cpu/mem-loads/pp:     7f92c90f543c
+or a binary sample file on stdin (pebs_sampler / points_convert, see sample_format.py).
 
 Outputs:
   <min_hex> <max_hex> <count>
@@ -11,6 +12,9 @@ Outputs:
 By default:
   - Only uses event == cpu/mem-loads/pp
   - Buckets by 1GB (addr >> 30) and picks the bucket with the most samples
+
+The C++ `infer_addr_range` (make infer_addr_range) implements the same options
+over the full sample stream instead of a --max-lines prefix.
 """
 
 from __future__ import annotations
@@ -19,6 +23,8 @@ import argparse
 import sys
 from collections import Counter
 
+import sample_format
+
 
 def parse_args() -> argparse.Namespace:
     p = argparse.ArgumentParser()
@@ -60,28 +66,19 @@ def parse_args() -> argparse.Namespace:
     return p.parse_args()
 
 
-def main() -> int:
-    args = parse_args()
-    bucket_shift = int(args.bucket_bits)
-    max_lines = int(args.max_lines)
-    event_b = args.event.encode("ascii", "ignore")
-    drop_kernel = not bool(args.keep_kernel)
-
-    counts: Counter[int] = Counter()
-    mins: dict[int, int] = {}
-    maxs: dict[int, int] = {}
-
-    n = 0
+def _iter_event_addr(stdin):
+    """Yield (event_bytes, addr) from points.txt text or a binary sample stream."""
+    if stdin.peek(len(sample_format.MAGIC))[: len(sample_format.MAGIC)] == sample_format.MAGIC:
+        for _t, ev, a in sample_format.iter_points(stdin):
+            yield ev.encode("ascii", "ignore"), a
+        return
     # Fast parsing: perf script -F time,event,addr usually splits into:
     #   <time>: <event>: <addr>
     # We only care about event + addr, so avoid regex for speed.
-    for line in sys.stdin.buffer:
+    for line in stdin:
         parts = line.split()
         if len(parts) < 3:
             continue
-        ev = parts[-2].rstrip(b":")
-        if ev != event_b:
-            continue
         addr_tok = parts[-1]
         if addr_tok == b"0" or addr_tok == b"0x0":
             continue
@@ -89,6 +86,20 @@ def main() -> int:
             a = int(addr_tok, 16)
         except ValueError:
             continue
+        yield parts[-2].rstrip(b":"), a
+
+
+def _bucket_stats(stdin, event: str, bucket_shift: int, max_lines: int, drop_kernel: bool):
+    """Per-bucket sample count, min and max address over the first max_lines samples."""
+    event_b = event.encode("ascii", "ignore")
+    counts: Counter[int] = Counter()
+    mins: dict[int, int] = {}
+    maxs: dict[int, int] = {}
+
+    n = 0
+    for ev, a in _iter_event_addr(stdin):
+        if ev != event_b:
+            continue
         if a == 0:
             continue
         # Filter kernel virtual addresses by default (prevents massive bucket ranges
@@ -102,6 +113,54 @@ def main() -> int:
         n += 1
         if n >= max_lines:
             break
+    return counts, mins, maxs
+
+
+def _bucket_stats_columns(stdin, event: str, bucket_shift: int, max_lines: int, drop_kernel: bool):
+    """_bucket_stats for a binary sample stream, one numpy pass per block.
+
+    Buckets enter `counts` in order of first appearance, as in _bucket_stats,
+    so most_common() breaks ties the same way."""
+    np = sample_format.np
+    counts: Counter[int] = Counter()
+    mins: dict[int, int] = {}
+    maxs: dict[int, int] = {}
+
+    limit = max(max_lines, 1)  # _bucket_stats keeps at least one sample
+    n = 0
+    for _t, _ev, a in sample_format.iter_columns(stdin, events=[event]):
+        a = a[a != 0]
+        if drop_kernel:
+            a = a[a < np.uint64(0x8000_0000_0000_0000)]
+        a = a[: limit - n]
+        n += a.size
+        if a.size:
+            b = a >> np.uint64(bucket_shift)
+            order = np.argsort(b, kind="stable")
+            b_sorted, a_sorted = b[order], a[order]
+            keys, starts, cnt = np.unique(b_sorted, return_index=True, return_counts=True)
+            lo = np.minimum.reduceat(a_sorted, starts)
+            hi = np.maximum.reduceat(a_sorted, starts)
+            for i in np.argsort(order[starts], kind="stable").tolist():
+                k = int(keys[i])
+                counts[k] += int(cnt[i])
+                mins[k] = min(mins.get(k, int(lo[i])), int(lo[i]))
+                maxs[k] = max(maxs.get(k, int(hi[i])), int(hi[i]))
+        if n >= limit:
+            break
+    return counts, mins, maxs
+
+
+def main() -> int:
+    args = parse_args()
+    bucket_shift = int(args.bucket_bits)
+    max_lines = int(args.max_lines)
+    drop_kernel = not bool(args.keep_kernel)
+
+    stdin = sys.stdin.buffer
+    is_samples = stdin.peek(len(sample_format.MAGIC))[: len(sample_format.MAGIC)] == sample_format.MAGIC
+    stats = _bucket_stats_columns if is_samples and sample_format.HAVE_NUMPY else _bucket_stats
+    counts, mins, maxs = stats(stdin, args.event, bucket_shift, max_lines, drop_kernel)
 
     if not counts:
         return 1
@@ -0,0 +1,133 @@
+// Group-quantized llama2.c checkpoints, shared by quantize_llama (writer) and
+// example.cpp (reader). Header-only, no dependencies beyond libc.
+//
+// Every weight matrix is cut into groups of kGroup consecutive weights along
+// a row; each group becomes one block holding an fp32 scale and the
+// quantized values:
+//   BlockQ8 : int8 q[32],              w = q * d          (36 B / 32 weights)
+//   BlockQ4 : uint8 q[16] (two nibbles), w = (nib - 8) * d (20 B / 32 weights)
+// In a BlockQ4, byte j holds weight j in its low nibble and weight j + 16 in
+// its high nibble, so a kernel can unpack the two halves with one mask and
+// one shift. Blocks never straddle rows, so dim and hidden_dim must be
+// multiples of kGroup.
+//
+// File layout (little endian):
+//   FileHeader (256 bytes)
+//   fp32:   rms_att_weight (layer, dim), rms_ffn_weight (layer, dim),
+//           rms_final_weight (dim)
+//   blocks: token_embedding_table (vocab_size, dim), wq, wk, wv, wo,
+//           w1, w2, w3, then wcls (vocab_size, dim) unless shared_classifier
+// Matrices keep the row-major order of the fp32 checkpoint, so weight i of a
+// tensor lives in block i / kGroup.
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace llama_quant {
+
+constexpr uint32_t kMagic = 0x30514c46;  // "FLQ0"
+constexpr uint32_t kVersion = 1;
+constexpr size_t kGroup = 32;
+
+enum class WeightType : uint32_t { kF32 = 0, kQ8 = 1, kQ4 = 2 };
+
+struct BlockQ8 {
+  float d;
+  int8_t q[kGroup];
+};
+
+struct BlockQ4 {
+  float d;
+  uint8_t q[kGroup / 2];
+};
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  int32_t config[7];  // llama2.c Config; vocab_size is always positive here
+  uint32_t type;      // WeightType
+  uint32_t group;     // kGroup
+  uint32_t shared_classifier;
+  uint8_t pad[208];
+};
+
+static_assert(sizeof(BlockQ8) == 36, "BlockQ8 layout must stay stable");
+static_assert(sizeof(BlockQ4) == 20, "BlockQ4 layout must stay stable");
+static_assert(sizeof(FileHeader) == 256, "FileHeader layout must stay stable");
+
+inline const char* weight_type_name(WeightType t) {
+  switch (t) {
+    case WeightType::kF32: return "f32";
+    case WeightType::kQ8: return "q8";
+    case WeightType::kQ4: return "q4";
+  }
+  return "?";
+}
+
+// Bytes taken by n weights (n a multiple of kGroup for the block types).
+inline size_t weight_bytes(WeightType t, size_t n) {
+  switch (t) {
+    case WeightType::kF32: return n * sizeof(float);
+    case WeightType::kQ8: return n / kGroup * sizeof(BlockQ8);
+    case WeightType::kQ4: return n / kGroup * sizeof(BlockQ4);
+  }
+  return 0;
+}
+
+// Symmetric int8: the largest magnitude in the group maps to +-127.
+inline void quantize_q8(const float* x, BlockQ8* b, size_t nb) {
+  for (size_t i = 0; i < nb; i++, x += kGroup) {
+    float amax = 0.0f;
+    for (size_t j = 0; j < kGroup; j++) amax = std::fmax(amax, std::fabs(x[j]));
+    const float d = amax / 127.0f;
+    const float id = d != 0.0f ? 1.0f / d : 0.0f;
+    b[i].d = d;
+    for (size_t j = 0; j < kGroup; j++) b[i].q[j] = static_cast<int8_t>(std::lrintf(x[j] * id));
+  }
+}
+
+// 4-bit with offset 8: the largest-magnitude weight maps to nibble 0 (-8 * d),
+// so the sign of d spends the extra negative level on the side that needs it.
+inline void quantize_q4(const float* x, BlockQ4* b, size_t nb) {
+  constexpr size_t kHalf = kGroup / 2;
+  for (size_t i = 0; i < nb; i++, x += kGroup) {
+    float amax = 0.0f;
+    float max = 0.0f;
+    for (size_t j = 0; j < kGroup; j++) {
+      if (std::fabs(x[j]) > amax) {
+        amax = std::fabs(x[j]);
+        max = x[j];
+      }
+    }
+    const float d = max / -8.0f;
+    const float id = d != 0.0f ? 1.0f / d : 0.0f;
+    b[i].d = d;
+    for (size_t j = 0; j < kHalf; j++) {
+      const int lo = static_cast<int>(std::fmin(15.0f, x[j] * id + 8.5f));
+      const int hi = static_cast<int>(std::fmin(15.0f, x[j + kHalf] * id + 8.5f));
+      b[i].q[j] = static_cast<uint8_t>(lo | (hi << 4));
+    }
+  }
+}
+
+inline void dequantize(const BlockQ8* b, float* y, size_t nb) {
+  for (size_t i = 0; i < nb; i++, y += kGroup) {
+    for (size_t j = 0; j < kGroup; j++) y[j] = b[i].q[j] * b[i].d;
+  }
+}
+
+inline void dequantize(const BlockQ4* b, float* y, size_t nb) {
+  constexpr size_t kHalf = kGroup / 2;
+  for (size_t i = 0; i < nb; i++, y += kGroup) {
+    for (size_t j = 0; j < kHalf; j++) {
+      y[j] = ((b[i].q[j] & 0x0f) - 8) * b[i].d;
+      y[j + kHalf] = ((b[i].q[j] >> 4) - 8) * b[i].d;
+    }
+  }
+}
+
+}  // namespace llama_quant
@@ -0,0 +1,742 @@
+// Native PEBS data-address sampler.
+//
+// Opens cpu/mem-loads/pp (and optionally cpu/mem-stores/pp) on every CPU with
+// perf_event_open(2), drains the mmap ring buffers directly and writes a
+// compact binary sample stream (sample_format.hpp) of
+// (time, event, addr, phys_addr, pid, tid). This replaces the `perf record -d`
+// + `perf script -F time,event,addr` round trip used by the runners, which on
+// large runs spends more time decoding text than sampling.
+//
+// With --pid, every thread of the target gets its own events, like
+// `perf record -p`: /proc/<pid>/task is listed at start and rescanned while
+// sampling, so threads that existed before the attach and threads spawned
+// later are both covered.
+//
+// `--dump=<file>` prints an existing sample file as points.txt-compatible
+// text ("<time>: <event>: <addr>") so the Python plotting tools keep working.
+// `--count=<file>` decodes one and prints its sample count, for scripts that
+// need to know whether a run captured anything.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sample_format.hpp"
+
+namespace {
+
+using sample_format::Sample;
+
+struct Config {
+  std::string output = "samples.bin";
+  std::string dump;         // non-empty => dump mode
+  std::string count;        // non-empty => count mode
+  std::string pmu = "cpu";
+  std::string cpus;         // empty => all online CPUs
+  pid_t pid = -1;           // -1 => all processes on each CPU
+  uint64_t period = 20000;
+  int duration_sec = 0;     // 0 => until SIGINT/SIGTERM (or --pid exits)
+  int mmap_pages = 512;     // data pages per ring (power of two)
+  bool loads = true;
+  bool stores = false;
+  bool phys = false;
+  bool user_only = true;
+  bool monotonic = false;   // --clock=monotonic: sample time from CLOCK_MONOTONIC
+  int loads_aux = -1;       // -1 => auto (use mem-loads-aux leader if the PMU exports it)
+};
+
+// One opened sampling event on one CPU (cpu == -1: any CPU) for one thread
+// (tid == -1: every process).
+struct Ring {
+  int fd = -1;
+  int leader_fd = -1;       // mem-loads-aux group leader (if any)
+  void* base = nullptr;
+  size_t map_bytes = 0;
+  uint32_t event = 0;
+  int cpu = 0;
+  pid_t tid = -1;
+};
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int) { g_stop = 1; }
+
+static long perf_event_open(perf_event_attr* attr, pid_t pid, int cpu, int group_fd,
+                            unsigned long flags) {
+  return syscall(__NR_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+static bool parse_flag(const char* arg, const char* name, const char** out_val) {
+  const size_t n = std::strlen(name);
+  if (std::strncmp(arg, name, n) != 0) return false;
+  if (arg[n] == '\0') {
+    *out_val = nullptr;
+    return true;
+  }
+  if (arg[n] != '=') return false;
+  *out_val = arg + n + 1;
+  return true;
+}
+
+static void usage(const char* argv0) {
+  std::cerr
+      << "Usage: " << argv0 << " [options]\n"
+      << "       " << argv0 << " --dump=<samples.bin>   (print points.txt-style text)\n"
+      << "       " << argv0 << " --count=<samples.bin>  (print the number of samples)\n"
+      << "\n"
+      << "Options:\n"
+      << "  --output=<path>          Binary sample file (default: samples.bin)\n"
+      << "  --events=loads|stores|loads,stores   Sampled events (default: loads)\n"
+      << "  --period=<N>             Sample period, like perf -c (default: 20000)\n"
+      << "  --pid=<pid>              Only sample this process, all of its threads (default: all, per CPU)\n"
+      << "  --cpus=<list>            CPU list, e.g. 0-31,64 (default: all online)\n"
+      << "  --duration=<sec>         Stop after N seconds (default: 0 = until SIGINT/SIGTERM)\n"
+      << "  --phys=0|1               Also record phys_addr (default: 0, needs privileges)\n"
+      << "  --user-only=0|1          Exclude kernel samples, like :u (default: 1)\n"
+      << "  --mmap-pages=<N>         Ring data pages per event, power of two (default: 512)\n"
+      << "  --pmu=<name>             Core PMU in /sys/bus/event_source/devices (default: cpu)\n"
+      << "  --loads-aux=auto|0|1     Use mem-loads-aux as group leader (default: auto)\n"
+      << "  --clock=perf|monotonic   Sample timestamp clock (default: perf). monotonic matches\n"
+      << "                           `perf record -k CLOCK_MONOTONIC` and zipf_bench --stats-csv\n"
+      << "\n"
+      << "Notes:\n"
+      << "  - Timestamps use the perf clock (or --clock), matching `perf script` time.\n"
+      << "  - Prints: READY: sampling started   once all events are enabled.\n";
+}
+
+static bool parse_args(int argc, char** argv, Config* cfg) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = nullptr;
+
+    if (std::strcmp(a, "--help") == 0 || std::strcmp(a, "-h") == 0) {
+      usage(argv[0]);
+      return false;
+    }
+    if (parse_flag(a, "--output", &v) && v) {
+      cfg->output = v;
+      continue;
+    }
+    if (parse_flag(a, "--dump", &v) && v) {
+      cfg->dump = v;
+      continue;
+    }
+    if (parse_flag(a, "--count", &v) && v) {
+      cfg->count = v;
+      continue;
+    }
+    if (parse_flag(a, "--pmu", &v) && v) {
+      cfg->pmu = v;
+      continue;
+    }
+    if (parse_flag(a, "--cpus", &v) && v) {
+      cfg->cpus = v;
+      continue;
+    }
+    if (parse_flag(a, "--pid", &v) && v) {
+      cfg->pid = static_cast<pid_t>(std::stol(v));
+      continue;
+    }
+    if (parse_flag(a, "--period", &v) && v) {
+      cfg->period = std::max<uint64_t>(1, std::stoull(v));
+      continue;
+    }
+    if (parse_flag(a, "--duration", &v) && v) {
+      cfg->duration_sec = std::max(0, std::stoi(v));
+      continue;
+    }
+    if (parse_flag(a, "--mmap-pages", &v) && v) {
+      cfg->mmap_pages = std::stoi(v);
+      if (cfg->mmap_pages <= 0 || (cfg->mmap_pages & (cfg->mmap_pages - 1)) != 0) {
+        std::cerr << "--mmap-pages must be a power of two\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--phys", &v) && v) {
+      cfg->phys = (std::stoi(v) != 0);
+      continue;
+    }
+    if (parse_flag(a, "--user-only", &v) && v) {
+      cfg->user_only = (std::stoi(v) != 0);
+      continue;
+    }
+    if (parse_flag(a, "--clock", &v) && v) {
+      if (std::strcmp(v, "perf") == 0) cfg->monotonic = false;
+      else if (std::strcmp(v, "monotonic") == 0) cfg->monotonic = true;
+      else {
+        std::cerr << "Unknown --clock: " << v << "\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--loads-aux", &v) && v) {
+      if (std::strcmp(v, "auto") == 0) cfg->loads_aux = -1;
+      else cfg->loads_aux = (std::stoi(v) != 0) ? 1 : 0;
+      continue;
+    }
+    if (parse_flag(a, "--events", &v) && v) {
+      cfg->loads = cfg->stores = false;
+      std::string s(v);
+      size_t pos = 0;
+      while (pos <= s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == std::string::npos) comma = s.size();
+        const std::string tok = s.substr(pos, comma - pos);
+        if (tok == "loads") cfg->loads = true;
+        else if (tok == "stores") cfg->stores = true;
+        else {
+          std::cerr << "Unknown event in --events: " << tok << "\n";
+          return false;
+        }
+        pos = comma + 1;
+      }
+      continue;
+    }
+
+    std::cerr << "Unknown arg: " << a << "\n";
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+static bool read_file(const std::string& path, std::string* out) {
+  std::ifstream f(path);
+  if (!f) return false;
+  std::getline(f, *out);
+  return true;
+}
+
+// Parse a CPU list like "0-3,8,10-11" (the /sys/devices/system/cpu/online format).
+static std::vector<int> parse_cpu_list(const std::string& s) {
+  std::vector<int> cpus;
+  size_t pos = 0;
+  while (pos < s.size()) {
+    size_t comma = s.find(',', pos);
+    if (comma == std::string::npos) comma = s.size();
+    const std::string tok = s.substr(pos, comma - pos);
+    if (!tok.empty()) {
+      const size_t dash = tok.find('-');
+      const int lo = std::stoi(tok.substr(0, dash));
+      const int hi = (dash == std::string::npos) ? lo : std::stoi(tok.substr(dash + 1));
+      for (int c = lo; c <= hi; c++) cpus.push_back(c);
+    }
+    pos = comma + 1;
+  }
+  return cpus;
+}
+
+// Resolve a sysfs PMU event alias (e.g. cpu/mem-loads/) into type + config words,
+// the same way `perf` does: events/<name> holds "term=value,..." and format/<term>
+// holds "configN:lo-hi" telling which attr field and bit range the value goes to.
+static bool resolve_pmu_event(const std::string& pmu, const std::string& name,
+                              perf_event_attr* attr) {
+  const std::string dir = "/sys/bus/event_source/devices/" + pmu;
+  std::string type_s;
+  std::string terms;
+  if (!read_file(dir + "/type", &type_s)) return false;
+  if (!read_file(dir + "/events/" + name, &terms)) return false;
+  attr->type = static_cast<uint32_t>(std::stoul(type_s));
+
+  size_t pos = 0;
+  while (pos < terms.size()) {
+    size_t comma = terms.find(',', pos);
+    if (comma == std::string::npos) comma = terms.size();
+    const std::string term = terms.substr(pos, comma - pos);
+    pos = comma + 1;
+    if (term.empty()) continue;
+
+    const size_t eq = term.find('=');
+    const std::string key = term.substr(0, eq);
+    const uint64_t val = (eq == std::string::npos) ? 1 : std::stoull(term.substr(eq + 1), nullptr, 0);
+
+    std::string fmt;
+    if (!read_file(dir + "/format/" + key, &fmt)) {
+      std::cerr << "Unknown format term '" << key << "' for " << pmu << "/" << name << "\n";
+      return false;
+    }
+    const size_t colon = fmt.find(':');
+    const std::string field = fmt.substr(0, colon);
+    const std::string bits = fmt.substr(colon + 1);
+    const size_t dash = bits.find('-');
+    const int lo = std::stoi(bits.substr(0, dash));
+    const int hi = (dash == std::string::npos) ? lo : std::stoi(bits.substr(dash + 1));
+    const uint64_t mask = (hi - lo + 1 >= 64) ? ~0ULL : ((1ULL << (hi - lo + 1)) - 1);
+
+    __u64* dst = nullptr;
+    if (field == "config") dst = &attr->config;
+    else if (field == "config1") dst = &attr->config1;
+    else if (field == "config2") dst = &attr->config2;
+    else {
+      std::cerr << "Unsupported format field '" << field << "'\n";
+      return false;
+    }
+    *dst |= (val & mask) << lo;
+  }
+  return true;
+}
+
+static bool pmu_has_event(const std::string& pmu, const std::string& name) {
+  return access(("/sys/bus/event_source/devices/" + pmu + "/events/" + name).c_str(), R_OK) == 0;
+}
+
+static uint64_t sample_type(const Config& cfg) {
+  uint64_t t = PERF_SAMPLE_IDENTIFIER | PERF_SAMPLE_TID | PERF_SAMPLE_TIME | PERF_SAMPLE_ADDR;
+  if (cfg.phys) t |= PERF_SAMPLE_PHYS_ADDR;
+  return t;
+}
+
+// Returns false with errno == ESRCH, and without an error message, if `tid`
+// exited before the event could be opened.
+static bool open_ring(const Config& cfg, const std::string& ev_name, uint32_t ev_idx, pid_t tid, int cpu,
+                      bool with_aux, Ring* out) {
+  const long page = sysconf(_SC_PAGESIZE);
+  int group_fd = -1;
+
+  if (with_aux) {
+    perf_event_attr aux{};
+    aux.size = sizeof(aux);
+    if (!resolve_pmu_event(cfg.pmu, "mem-loads-aux", &aux)) return false;
+    aux.disabled = 1;
+    aux.exclude_kernel = cfg.user_only ? 1 : 0;
+    aux.exclude_hv = 1;
+    aux.precise_ip = 2;
+    aux.use_clockid = cfg.monotonic ? 1 : 0;  // group members must share the clock
+    aux.clockid = CLOCK_MONOTONIC;
+    group_fd = static_cast<int>(perf_event_open(&aux, tid, cpu, -1, PERF_FLAG_FD_CLOEXEC));
+    if (group_fd < 0) {
+      if (errno != ESRCH) {
+        std::cerr << "perf_event_open(" << cfg.pmu << "/mem-loads-aux/, cpu=" << cpu << ", tid=" << tid
+                  << ") failed: " << std::strerror(errno) << "\n";
+      }
+      return false;
+    }
+  }
+
+  perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  if (!resolve_pmu_event(cfg.pmu, ev_name, &attr)) {
+    std::cerr << "Event " << cfg.pmu << "/" << ev_name << "/ not exported by this PMU\n";
+    if (group_fd >= 0) close(group_fd);
+    return false;
+  }
+  attr.sample_period = cfg.period;
+  attr.sample_type = sample_type(cfg);
+  attr.disabled = with_aux ? 0 : 1;
+  attr.exclude_kernel = cfg.user_only ? 1 : 0;
+  attr.exclude_hv = 1;
+  attr.precise_ip = 2;  // ":pp"
+  attr.use_clockid = cfg.monotonic ? 1 : 0;
+  attr.clockid = CLOCK_MONOTONIC;
+  attr.inherit = 0;  // --pid opens every thread itself; inheriting would sample new threads twice
+  attr.watermark = 1;
+  attr.wakeup_watermark = static_cast<uint32_t>(cfg.mmap_pages * page / 4);
+
+  const int fd = static_cast<int>(perf_event_open(&attr, tid, cpu, group_fd, PERF_FLAG_FD_CLOEXEC));
+  if (fd < 0) {
+    const int err = errno;
+    if (err != ESRCH) {
+      std::cerr << "perf_event_open(" << cfg.pmu << "/" << ev_name << "/pp, cpu=" << cpu << ", tid=" << tid
+                << ") failed: " << std::strerror(err) << "\n";
+    }
+    if (group_fd >= 0) close(group_fd);
+    errno = err;
+    return false;
+  }
+
+  const size_t map_bytes = static_cast<size_t>(cfg.mmap_pages + 1) * static_cast<size_t>(page);
+  void* base = mmap(nullptr, map_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    std::cerr << "mmap ring (cpu=" << cpu << ") failed: " << std::strerror(errno) << "\n";
+    close(fd);
+    if (group_fd >= 0) close(group_fd);
+    return false;
+  }
+
+  out->fd = fd;
+  out->leader_fd = group_fd;
+  out->base = base;
+  out->map_bytes = map_bytes;
+  out->event = ev_idx;
+  out->cpu = cpu;
+  out->tid = tid;
+  return true;
+}
+
+static void close_ring(Ring* r) {
+  if (r->base) munmap(r->base, r->map_bytes);
+  if (r->fd >= 0) close(r->fd);
+  if (r->leader_fd >= 0) close(r->leader_fd);
+  *r = Ring{};
+}
+
+struct DrainStats {
+  uint64_t samples = 0;
+  uint64_t lost = 0;
+  uint64_t throttled = 0;
+};
+
+// Consume everything between data_tail and data_head. Records that wrap around the
+// end of the ring are reassembled into a small bounce buffer.
+static void drain_ring(const Config& cfg, Ring* r, std::vector<Sample>* out, DrainStats* st) {
+  auto* meta = static_cast<perf_event_mmap_page*>(r->base);
+  const uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+  uint64_t tail = meta->data_tail;
+  if (head == tail) return;
+
+  const uint64_t size = meta->data_size;
+  const char* data = static_cast<const char*>(r->base) + meta->data_offset;
+  char bounce[512];
+
+  while (tail < head) {
+    const uint64_t off = tail % size;
+    perf_event_header hdr;
+    if (off + sizeof(hdr) <= size) {
+      std::memcpy(&hdr, data + off, sizeof(hdr));
+    } else {
+      const size_t first = static_cast<size_t>(size - off);
+      std::memcpy(&hdr, data + off, first);
+      std::memcpy(reinterpret_cast<char*>(&hdr) + first, data, sizeof(hdr) - first);
+    }
+    if (hdr.size == 0) break;
+
+    const char* rec = data + off;
+    if (off + hdr.size > size) {
+      const size_t first = static_cast<size_t>(size - off);
+      const size_t n = std::min<size_t>(hdr.size, sizeof(bounce));
+      std::memcpy(bounce, data + off, std::min(first, n));
+      if (n > first) std::memcpy(bounce + first, data, n - first);
+      rec = bounce;
+    }
+
+    if (hdr.type == PERF_RECORD_SAMPLE) {
+      // Field order follows enum perf_event_sample_format bit order.
+      const uint64_t* p = reinterpret_cast<const uint64_t*>(rec + sizeof(hdr));
+      Sample s;
+      p++;  // PERF_SAMPLE_IDENTIFIER
+      s.pid = static_cast<uint32_t>(*p & 0xffffffffu);
+      s.tid = static_cast<uint32_t>(*p >> 32);
+      p++;
+      s.time_ns = *p++;
+      s.addr = *p++;
+      if (cfg.phys) s.phys_addr = *p++;
+      s.event = static_cast<uint8_t>(r->event);
+      out->push_back(s);
+      st->samples++;
+    } else if (hdr.type == PERF_RECORD_LOST) {
+      const uint64_t* p = reinterpret_cast<const uint64_t*>(rec + sizeof(hdr));
+      st->lost += p[1];
+    } else if (hdr.type == PERF_RECORD_THROTTLE) {
+      st->throttled++;
+    }
+    tail += hdr.size;
+  }
+
+  __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+// Thread ids of a running process, from /proc/<pid>/task. Empty once the
+// process is gone.
+static std::vector<pid_t> list_tids(pid_t pid) {
+  std::vector<pid_t> tids;
+  const std::string dir = "/proc/" + std::to_string(pid) + "/task";
+  DIR* d = opendir(dir.c_str());
+  if (!d) return tids;
+  while (dirent* e = readdir(d)) {
+    if (e->d_name[0] < '0' || e->d_name[0] > '9') continue;
+    tids.push_back(static_cast<pid_t>(std::strtol(e->d_name, nullptr, 10)));
+  }
+  closedir(d);
+  return tids;
+}
+
+struct EventSet {
+  std::vector<std::string> sysfs_names;
+  bool use_aux = false;
+};
+
+// Open and enable every event for `tid` on each of `cpus`. A thread that
+// exits meanwhile is skipped (returns true, opens nothing); any other
+// failure returns false.
+static bool open_target(const Config& cfg, const EventSet& ev, pid_t tid, const std::vector<int>& cpus,
+                        std::vector<Ring>* rings) {
+  const size_t first = rings->size();
+  for (int cpu : cpus) {
+    for (uint32_t e = 0; e < ev.sysfs_names.size(); e++) {
+      Ring r;
+      const bool aux = ev.use_aux && ev.sysfs_names[e] == "mem-loads";
+      if (!open_ring(cfg, ev.sysfs_names[e], e, tid, cpu, aux, &r)) {
+        const bool gone = errno == ESRCH;
+        while (rings->size() > first) {
+          close_ring(&rings->back());
+          rings->pop_back();
+        }
+        return gone;
+      }
+      rings->push_back(r);
+    }
+  }
+  for (size_t i = first; i < rings->size(); i++) {
+    const Ring& r = (*rings)[i];
+    (void)ioctl(r.leader_fd >= 0 ? r.leader_fd : r.fd, PERF_EVENT_IOC_ENABLE,
+                r.leader_fd >= 0 ? PERF_IOC_FLAG_GROUP : 0);
+  }
+  return true;
+}
+
+static int dump_samples(const std::string& path) {
+  sample_format::Reader r;
+  if (!r.open(path)) {
+    std::cerr << r.error() << "\n";
+    return 1;
+  }
+  const bool use_phys = (r.header().flags & sample_format::kHasPhys) != 0;
+  sample_format::Block b;
+  char line[256];
+  while (r.next(&b)) {
+    for (size_t i = 0; i < b.size(); i++) {
+      const char* ev = (b.event[i] < r.events().size()) ? r.events()[b.event[i]].c_str() : "unknown";
+      const int n = sample_format::format_points_line(line, sizeof(line), b.time_ns[i], ev,
+                                                      use_phys ? b.phys_addr[i] : b.addr[i]);
+      std::fwrite(line, 1, static_cast<size_t>(n), stdout);
+    }
+  }
+  if (!r.error().empty()) {
+    std::cerr << path << ": " << r.error() << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+static int count_samples(const std::string& path) {
+  sample_format::Reader r;
+  if (!r.open(path)) {
+    std::cerr << r.error() << "\n";
+    return 1;
+  }
+  uint64_t n = 0;
+  sample_format::Block b;
+  while (r.next(&b)) n += b.size();
+  if (!r.error().empty()) {
+    std::cerr << path << ": " << r.error() << "\n";
+    return 1;
+  }
+  std::cout << n << "\n";
+  return 0;
+}
+
+// Each poll drains the rings one after another, so a batch holds per-ring
+// runs. Consumers take t0 from the first sample and drop earlier ones, so
+// merge the runs by time before writing; the stable sort keeps equal
+// timestamps in drain order.
+static void sort_by_time(std::vector<Sample>* batch) {
+  std::stable_sort(batch->begin(), batch->end(),
+                   [](const Sample& a, const Sample& b) { return a.time_ns < b.time_ns; });
+}
+
+static uint64_t now_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config cfg;
+  if (!parse_args(argc, argv, &cfg)) {
+    return 1;
+  }
+  if (!cfg.dump.empty()) {
+    return dump_samples(cfg.dump);
+  }
+  if (!cfg.count.empty()) {
+    return count_samples(cfg.count);
+  }
+  if (!cfg.loads && !cfg.stores) {
+    std::cerr << "--events selected nothing\n";
+    return 1;
+  }
+
+  // --pid follows the target's threads wherever they run, so it only needs
+  // per-CPU events when --cpus narrows the set.
+  std::vector<int> cpus;
+  if (!cfg.cpus.empty()) {
+    cpus = parse_cpu_list(cfg.cpus);
+  } else if (cfg.pid > 0) {
+    cpus.push_back(-1);
+  } else {
+    std::string online;
+    if (!read_file("/sys/devices/system/cpu/online", &online)) {
+      std::cerr << "cannot read /sys/devices/system/cpu/online\n";
+      return 1;
+    }
+    cpus = parse_cpu_list(online);
+  }
+  if (cpus.empty()) {
+    std::cerr << "no CPUs selected\n";
+    return 1;
+  }
+
+  // Event table: names match what `perf script` prints so downstream filters still apply.
+  EventSet ev;
+  std::vector<std::string> event_names;
+  if (cfg.loads) {
+    ev.sysfs_names.push_back("mem-loads");
+    event_names.push_back(cfg.pmu + "/mem-loads/pp");
+  }
+  if (cfg.stores) {
+    ev.sysfs_names.push_back("mem-stores");
+    event_names.push_back(cfg.pmu + "/mem-stores/pp");
+  }
+
+  const bool have_aux = pmu_has_event(cfg.pmu, "mem-loads-aux");
+  ev.use_aux = (cfg.loads_aux < 0) ? have_aux : (cfg.loads_aux == 1);
+
+  sample_format::Writer out;
+  const uint32_t flags = sample_format::kHasPidTid | (cfg.phys ? sample_format::kHasPhys : 0u);
+  if (!out.open(cfg.output, event_names, flags, cfg.period)) {
+    std::cerr << out.error() << "\n";
+    return 1;
+  }
+
+  std::signal(SIGINT, on_signal);
+  std::signal(SIGTERM, on_signal);
+
+  // Threads already opened, or seen exiting before they could be. Exited
+  // tids stay in the set, so a tid recycled within one run (pid wraparound)
+  // would not be reopened.
+  std::set<pid_t> seen_tids;
+  std::vector<Ring> rings;
+  auto open_new_threads = [&]() -> bool {
+    for (pid_t tid : list_tids(cfg.pid)) {
+      if (!seen_tids.insert(tid).second) continue;
+      if (!open_target(cfg, ev, tid, cpus, &rings)) return false;
+    }
+    return true;
+  };
+  if (cfg.pid > 0) {
+    const bool opened = open_new_threads();
+    if (!opened || rings.empty()) {
+      if (opened) std::cerr << "no threads to sample in pid " << cfg.pid << "\n";
+      for (auto& x : rings) close_ring(&x);
+      (void)out.close();
+      return 2;
+    }
+  } else if (!open_target(cfg, ev, -1, cpus, &rings)) {
+    for (auto& x : rings) close_ring(&x);
+    (void)out.close();
+    return 2;
+  }
+
+  std::cout << "pebs_sampler: " << rings.size() << " rings on ";
+  if (cfg.pid > 0) std::cout << seen_tids.size() << " threads of pid " << cfg.pid << ", ";
+  if (cpus.front() >= 0) std::cout << cpus.size() << " cpus, ";
+  std::cout << "period=" << cfg.period << (ev.use_aux ? " (mem-loads-aux leader)" : "") << "\n";
+  std::cout << "READY: sampling started\n" << std::flush;
+
+  std::vector<pollfd> pfds;
+  auto rebuild_pfds = [&]() {
+    pfds.assign(rings.size(), pollfd{});
+    for (size_t i = 0; i < rings.size(); i++) {
+      pfds[i].fd = rings[i].fd;
+      pfds[i].events = POLLIN;
+    }
+  };
+  rebuild_pfds();
+
+  const uint64_t t_start = now_ns();
+  const uint64_t t_end = (cfg.duration_sec > 0) ? t_start + static_cast<uint64_t>(cfg.duration_sec) * 1000000000ULL : 0;
+  DrainStats st;
+  std::vector<Sample> batch;
+  batch.reserve(1 << 16);
+
+  // With --pid the poll timeout doubles as the /proc/<pid>/task rescan
+  // interval: a new thread goes unsampled for at most that long.
+  const int poll_ms = (cfg.pid > 0) ? 10 : 100;
+  bool open_failed = false;
+  while (!g_stop) {
+    const int rc = poll(pfds.data(), pfds.size(), poll_ms);
+    if (rc < 0 && errno != EINTR) {
+      std::cerr << "poll failed: " << std::strerror(errno) << "\n";
+      break;
+    }
+    bool target_gone = false;
+    bool rings_changed = false;
+    for (size_t i = 0; i < rings.size();) {
+      drain_ring(cfg, &rings[i], &batch, &st);
+      if (!(pfds[i].revents & POLLHUP)) {
+        i++;
+        continue;
+      }
+      // The ring's thread exited. For the main thread that ends the target;
+      // other threads just drop out.
+      if (cfg.pid <= 0 || rings[i].tid == cfg.pid) {
+        target_gone = true;
+        i++;
+        continue;
+      }
+      close_ring(&rings[i]);
+      rings.erase(rings.begin() + static_cast<std::ptrdiff_t>(i));
+      pfds.erase(pfds.begin() + static_cast<std::ptrdiff_t>(i));
+      rings_changed = true;
+    }
+    if (cfg.pid > 0 && !target_gone) {
+      const size_t before = rings.size();
+      if (!open_new_threads()) {
+        open_failed = true;
+      }
+      rings_changed = rings_changed || rings.size() != before;
+    }
+    if (rings_changed) rebuild_pfds();
+    sort_by_time(&batch);
+    bool write_ok = true;
+    for (const Sample& s : batch) write_ok = write_ok && out.append(s);
+    batch.clear();
+    if (!write_ok) {
+      std::cerr << out.error() << "\n";
+      break;
+    }
+    if (open_failed) break;
+    if (target_gone && cfg.pid > 0) break;
+    if (t_end != 0 && now_ns() >= t_end) break;
+  }
+
+  for (auto& r : rings) {
+    (void)ioctl(r.leader_fd >= 0 ? r.leader_fd : r.fd, PERF_EVENT_IOC_DISABLE,
+                r.leader_fd >= 0 ? PERF_IOC_FLAG_GROUP : 0);
+  }
+  for (auto& r : rings) drain_ring(cfg, &r, &batch, &st);
+  sort_by_time(&batch);
+  for (const Sample& s : batch) (void)out.append(s);
+  if (!out.close()) std::cerr << out.error() << "\n";
+  for (auto& r : rings) close_ring(&r);
+
+  const double sec = static_cast<double>(now_ns() - t_start) / 1e9;
+  std::cout << "Done. elapsed_sec=" << sec << " samples=" << st.samples << " lost=" << st.lost
+            << " throttled=" << st.throttled;
+  if (cfg.pid > 0) std::cout << " threads=" << seen_tids.size();
+  std::cout << " output=" << cfg.output << "\n";
+  return 0;
+}
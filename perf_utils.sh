@@ -66,3 +66,54 @@ detect_perf_params() {
 
 
 
+
+# Ready signal from zipf_bench / stream_bench (--ready-file=<fifo>).
+#
+# open_ready_fifo <path>
+#   Create the FIFO and hold it open read-write on fd 9, so the benchmark's
+#   non-blocking open always finds a reader. Start the benchmark with `9<&-`.
+# wait_ready_fifo <pid> [timeout_sec]
+#   Block until the benchmark writes its ready line (sent right before the
+#   hot loop starts). Wakes as soon as the line arrives; the 1 s read timeout
+#   only checks that <pid> is still alive. Sets READY_TIME (CLOCK_MONOTONIC
+#   sec), READY_ADDR_LO and READY_ADDR_HI. Returns 1 if <pid> exits or the
+#   timeout (default 600 s) passes first.
+# close_ready_fifo <path>
+open_ready_fifo() {
+    local path=$1
+    rm -f "$path"
+    mkfifo "$path" || return 1
+    exec 9<>"$path"
+}
+
+wait_ready_fifo() {
+    local pid=$1
+    local timeout=${2:-600}
+    local line=""
+    local waited=0
+    local kv
+    READY_TIME=""
+    READY_ADDR_LO=""
+    READY_ADDR_HI=""
+    while [ "$waited" -lt "$timeout" ]; do
+        if read -r -t 1 line <&9; then
+            break
+        fi
+        line=""
+        kill -0 "$pid" 2>/dev/null || return 1
+        waited=$((waited + 1))
+    done
+    [ -n "$line" ] || return 1
+    for kv in $line; do
+        case "$kv" in
+            time_sec=*) READY_TIME=${kv#*=} ;;
+            addr_lo=*) READY_ADDR_LO=${kv#*=} ;;
+            addr_hi=*) READY_ADDR_HI=${kv#*=} ;;
+        esac
+    done
+}
+
+close_ready_fifo() {
+    exec 9<&-
+    rm -f "$1"
+}
@@ -8,12 +8,18 @@ Input: a text file where each line contains:
 Example line (from perf script -F time,event,phys_addr):
   1302.847157 cpu/mem-loads/pp 7eb6c026ef00
 
+Binary sample files (pebs_sampler / points_convert, see sample_format.py) are
+accepted too and detected by their magic. A pre-binned matrix from `heatmap`
+(<name>.npy with its <name>.json sidecar) is drawn directly with imshow, which
+keeps large captures out of Python entirely.
+
 Output: a PNG similar to a "GUPS" physical address heatmap.
 """
 
 from __future__ import annotations
 
 import argparse
+import json
 import re
 from pathlib import Path
 import random
@@ -24,6 +30,8 @@ import numpy as np
 from matplotlib.colors import LogNorm
 from matplotlib.ticker import FuncFormatter
 
+import sample_format
+
 
 # perf script -F time,event,addr (or phys_addr) often formats like:
 #   50858.386645:   cpu/mem-loads/pp:     7fff0cba3bb0
@@ -169,6 +177,35 @@ def _parse_int_auto(s: str) -> int:
     return int(s, 10)
 
 
+def _iter_samples(in_path: Path | None):
+    """Yield (time_sec, event, addr) from points.txt text or a binary sample file."""
+    if in_path is not None and sample_format.is_sample_file(in_path):
+        yield from sample_format.iter_points(in_path)
+        return
+    f = sys.stdin if in_path is None else in_path.open("r", encoding="utf-8", errors="ignore")
+    with f:
+        for line in f:
+            m = LINE_RE.match(line)
+            if not m:
+                continue
+            yield float(m.group("time")), m.group("event").rstrip(":"), int(m.group("addr"), 16)
+
+
+def _load_binned(in_path: Path):
+    """Load a `heatmap` matrix and its JSON sidecar (extents in sec / bytes)."""
+    meta = json.loads(in_path.with_suffix(".json").read_text())
+    return np.load(in_path), meta
+
+
+def _binned_percentile(m, y0: float, y1: float, pct: float) -> float:
+    """Approximate np.percentile of sample addresses from per-row totals."""
+    rows = m.sum(axis=1).astype(np.float64)
+    cdf = np.cumsum(rows)
+    r = int(np.searchsorted(cdf, pct / 100.0 * cdf[-1]))
+    r = min(r, rows.size - 1)
+    return y0 + (r + 0.5) * (y1 - y0) / rows.size
+
+
 def _clamp(v: float, lo: float, hi: float) -> float:
     if v < lo:
         return lo
@@ -190,47 +227,56 @@ def main() -> int:
     n_seen = 0
     t0: float | None = None
 
-    f = sys.stdin if in_path is None else in_path.open("r", encoding="utf-8", errors="ignore")
-    with f:
-        for line in f:
-            m = LINE_RE.match(line)
-            if not m:
-                continue
-            ev = m.group("event").rstrip(":")
-            # perf script sometimes aligns with spaces and keeps suffixes.
-            if ev != args.event_filter:
-                continue
-            t = float(m.group("time"))
-            if args.time_zero is None:
-                if t0 is None:
-                    t0 = t
-                t_rel = t - t0
-            else:
-                t_rel = t - float(args.time_zero)
-            pa = int(m.group("addr"), 16)
-            if pa == 0:
-                continue
-            if addr_min is not None and pa < addr_min:
-                continue
-            if addr_max is not None and pa >= addr_max:
-                continue
-            n_seen += 1
-
-            # Stream downsample with reservoir sampling capped at max_points
-            if len(times) < args.max_points:
-                times.append(t_rel)
-                phys.append(pa)
-            else:
-                j = random.randrange(n_seen)
-                if j < args.max_points:
-                    times[j] = t_rel
-                    phys[j] = pa
+    binned = None
+    if in_path is not None and in_path.suffix == ".npy":
+        binned, meta = _load_binned(in_path)
+        if meta.get("event", args.event_filter) != args.event_filter:
+            print(f"[WARN] {in_path} was binned for event '{meta['event']}'", file=sys.stderr)
+        if addr_min is None:
+            addr_min = int(meta["addr_min"], 16)
+        if addr_max is None:
+            addr_max = int(meta["addr_max"], 16)
+        y0, y1 = float(meta["y0"]), float(meta["y1"])
+        if args.y_offset and not meta.get("y_offset", False):
+            y0, y1 = y0 - addr_min, y1 - addr_min
+        x0, x1 = float(meta["x0"]), float(meta["x1"])
+        # Stand-ins for the x-limit defaults below.
+        times = [x0, x1]
+        n_seen = int(meta["samples"])
+
+    for t, ev, pa in (() if binned is not None else _iter_samples(in_path)):
+        # perf script sometimes aligns with spaces and keeps suffixes.
+        if ev != args.event_filter:
+            continue
+        if args.time_zero is None:
+            if t0 is None:
+                t0 = t
+            t_rel = t - t0
+        else:
+            t_rel = t - float(args.time_zero)
+        if pa == 0:
+            continue
+        if addr_min is not None and pa < addr_min:
+            continue
+        if addr_max is not None and pa >= addr_max:
+            continue
+        n_seen += 1
+
+        # Stream downsample with reservoir sampling capped at max_points
+        if len(times) < args.max_points:
+            times.append(t_rel)
+            phys.append(pa)
+        else:
+            j = random.randrange(n_seen)
+            if j < args.max_points:
+                times[j] = t_rel
+                phys[j] = pa
 
     if not times:
         raise SystemExit(f"No samples found for event '{args.event_filter}' in {args.input}")
 
     # Optionally plot offset addresses for readability
-    if args.y_offset and addr_min is not None:
+    if args.y_offset and addr_min is not None and binned is None:
         phys = [p - addr_min for p in phys]
 
     try:
@@ -243,7 +289,18 @@ def main() -> int:
     ax = fig.add_subplot(1, 1, 1)
 
     hb = None
-    if args.plot == "hexbin":
+    if binned is not None:
+        # Zero bins stay white like hexbin's mincnt=1.
+        hb = ax.imshow(
+            np.ma.masked_equal(binned, 0),
+            origin="lower",
+            aspect="auto",
+            extent=(x0, x1, y0, y1),
+            interpolation="nearest",
+            cmap="Blues",
+            alpha=float(args.alpha),
+        )
+    elif args.plot == "hexbin":
         hb = ax.hexbin(
             times,
             phys,
@@ -302,18 +359,22 @@ def main() -> int:
     # large empty space when the window is intentionally padded.
     if args.auto_ylim:
         y = np.asarray(phys, dtype=np.float64)
-        if y.size:
+        if y.size or binned is not None:
             lo_pct = float(args.auto_ylim_lo_pct)
             hi_pct = float(args.auto_ylim_hi_pct)
             if not (0.0 <= lo_pct < hi_pct <= 100.0):
                 raise SystemExit("--auto-ylim requires 0 <= lo_pct < hi_pct <= 100")
-            y_lo = float(np.percentile(y, lo_pct))
-            y_hi = float(np.percentile(y, hi_pct))
+            if binned is not None:
+                y_lo = _binned_percentile(binned, y0, y1, lo_pct)
+                y_hi = _binned_percentile(binned, y0, y1, hi_pct)
+            else:
+                y_lo = float(np.percentile(y, lo_pct))
+                y_hi = float(np.percentile(y, hi_pct))
             pad = float(args.auto_ylim_pad_gb) * (1024.0**3)
             # Ensure a sane span even if percentiles collapse.
             if y_hi <= y_lo:
-                y_lo = float(np.min(y))
-                y_hi = float(np.max(y))
+                y_lo = float(np.min(y)) if binned is None else y0
+                y_hi = float(np.max(y)) if binned is None else y1
             y_lo -= pad
             y_hi += pad
             # Clamp within provided window if any; otherwise keep non-negative
@@ -349,6 +410,8 @@ def main() -> int:
 
     if hb is not None:
         counts = hb.get_array()
+        if np.ma.isMaskedArray(counts):
+            counts = counts.compressed()
         if counts.size:
             if args.vmax is not None:
                 vmax = float(args.vmax)
@@ -377,7 +440,7 @@ def main() -> int:
     out_path.parent.mkdir(parents=True, exist_ok=True)
     # Save with a solid background for maximum viewer compatibility
     fig.savefig(out_path, bbox_inches="tight", facecolor="white", transparent=False)
-    print(f"Wrote {out_path} (points={len(times)})")
+    print(f"Wrote {out_path} (points={n_seen if binned is not None else len(times)})")
     return 0
 
 
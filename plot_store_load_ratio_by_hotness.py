@@ -12,6 +12,7 @@ Definition used in this script:
 Input supports:
 - perf.data (default): decode by running `perf script -F event,addr -i <perf.data>`
 - points text file: lines like "<time>: <event>: <addr>" or "<time> <event> <addr>"
+- binary sample file (pebs_sampler / points_convert, see sample_format.py)
 
 Time filtering (--after-seconds / --before-seconds):
   Only supported for points files that carry a timestamp per line.
@@ -37,6 +38,8 @@ from pathlib import Path
 import matplotlib.pyplot as plt
 import numpy as np
 
+import sample_format
+
 
 LINE_RE = re.compile(
     r"^\s*(?:(?P<time>[0-9]+(?:\.[0-9]+)?)\s*:?\s+)?(?P<event>\S+?)\s*:?\s+(?P<addr>[0-9a-fA-F]+)\s*$"
@@ -62,7 +65,7 @@ def parse_args() -> argparse.Namespace:
     )
     p.add_argument(
         "--input-type",
-        choices=["auto", "perf-data", "points"],
+        choices=["auto", "perf-data", "points", "samples"],
         default="auto",
         help="Input type detection mode (default: auto)",
     )
@@ -151,6 +154,8 @@ def parse_args() -> argparse.Namespace:
 def detect_input_type(path: Path, mode: str) -> str:
     if mode != "auto":
         return mode
+    if sample_format.is_sample_file(path):
+        return "samples"
     return "perf-data" if path.suffix == ".data" else "points"
 
 
@@ -194,20 +199,23 @@ def _resolve_time_bounds(
     if after is None and before is None:
         return None, None
 
-    if input_type != "points":
-        raise SystemExit("--after-seconds / --before-seconds are only supported with --input-type points")
+    if input_type not in ("points", "samples"):
+        raise SystemExit("--after-seconds / --before-seconds are only supported with --input-type points|samples")
 
     # Find the first timestamp in the file.
     first_t: float | None = None
-    with in_path.open("r", encoding="utf-8", errors="ignore") as fh:
-        for line in fh:
-            m = LINE_RE.match(line)
-            if m and m.group("time") is not None:
-                try:
-                    first_t = float(m.group("time"))
-                    break
-                except ValueError:
-                    pass
+    if input_type == "samples":
+        first_t = next((float(t[0]) for t, _ev, _a in sample_format.iter_columns(in_path)), None)
+    else:
+        with in_path.open("r", encoding="utf-8", errors="ignore") as fh:
+            for line in fh:
+                m = LINE_RE.match(line)
+                if m and m.group("time") is not None:
+                    try:
+                        first_t = float(m.group("time"))
+                        break
+                    except ValueError:
+                        pass
     if first_t is None:
         raise SystemExit("Could not read first timestamp from input; is --input-type correct?")
 
@@ -295,6 +303,83 @@ def iter_event_addr_from_points(
             yield ev, addr
 
 
+def iter_columns_from_samples(
+    path: Path,
+    load_event: str,
+    store_event: str,
+    min_time: float | None = None,
+    max_time: float | None = None,
+):
+    """Yield (is_store, addr) numpy arrays, one pair per block of a sample file.
+
+    Filters like the text readers (time window, addr == 0, other events), but
+    a block at a time instead of one Python tuple per sample."""
+    n = 0
+    for t, ev, addr in sample_format.iter_columns(path, events=[load_event, store_event]):
+        keep = addr != 0
+        if min_time is not None:
+            keep &= t >= min_time
+        if max_time is not None:
+            keep &= t < max_time
+        prev = n
+        n += int(np.count_nonzero(keep))
+        if n // _PROGRESS_INTERVAL != prev // _PROGRESS_INTERVAL:
+            print(f"  ... {n // 1_000_000}M samples kept", flush=True)
+        yield ev[keep] == 1, addr[keep]
+
+
+def _window_mask(addr, lo: int | None, hi: int | None):
+    keep = np.ones(addr.size, dtype=bool)
+    if lo is not None:
+        keep &= addr >= np.uint64(lo)
+    if hi is not None:
+        keep &= addr < np.uint64(hi)
+    return keep
+
+
+def range_from_columns(cols, lo: int | None, hi: int | None) -> tuple[int | None, int | None, int, int]:
+    """Range-detection pass over sample columns: (addr_min, addr_max, loads, stores)."""
+    addr_min = addr_max = None
+    load_samples = store_samples = 0
+    for is_store, addr in cols:
+        keep = _window_mask(addr, lo, hi)
+        if not keep.any():
+            continue
+        is_store, addr = is_store[keep], addr[keep]
+        n_store = int(np.count_nonzero(is_store))
+        store_samples += n_store
+        load_samples += addr.size - n_store
+        a_min, a_max = int(addr.min()), int(addr.max())
+        addr_min = a_min if addr_min is None else min(addr_min, a_min)
+        addr_max = a_max if addr_max is None else max(addr_max, a_max)
+    return addr_min, addr_max, load_samples, store_samples
+
+
+def bin_columns(
+    cols,
+    lo: int | None,
+    hi: int | None,
+    addr_min: int,
+    width: int,
+    load_bins: np.ndarray,
+    store_bins: np.ndarray,
+) -> tuple[int, int]:
+    """Binning pass over sample columns; adds into the bins, returns (loads, stores)."""
+    regions = load_bins.size
+    load_samples = store_samples = 0
+    for is_store, addr in cols:
+        keep = _window_mask(addr, lo, hi)
+        is_store, addr = is_store[keep], addr[keep]
+        idx = ((addr - np.uint64(addr_min)) // np.uint64(width)).astype(np.int64)
+        np.minimum(idx, regions - 1, out=idx)
+        store_bins += np.bincount(idx[is_store], minlength=regions)
+        load_bins += np.bincount(idx[~is_store], minlength=regions)
+        n_store = int(np.count_nonzero(is_store))
+        store_samples += n_store
+        load_samples += addr.size - n_store
+    return load_samples, store_samples
+
+
 def _auto_output_path(args: argparse.Namespace, in_path: Path) -> Path:
     stem = in_path.stem
     if args.window_file:
@@ -341,13 +426,18 @@ def main() -> int:
     user_lo, user_hi = _resolve_addr_bounds(args)
     min_time, max_time = _resolve_time_bounds(args, input_type, in_path)
 
+    load_event = args.load_event
+    store_event = args.store_event
+
+    # Sample files are read as numpy columns (make_cols); the text inputs
+    # yield one (event, addr) pair per sample (make_iter).
     def make_iter():
         if input_type == "perf-data":
             return iter_event_addr_from_perf_data(args.perf_bin, in_path)
         return iter_event_addr_from_points(in_path, min_time=min_time, max_time=max_time)
 
-    load_event = args.load_event
-    store_event = args.store_event
+    def make_cols():
+        return iter_columns_from_samples(in_path, load_event, store_event, min_time=min_time, max_time=max_time)
 
     # When the address window is fully specified we can skip the range-detection
     # pass and go directly to binning, saving one full read of the (large) file.
@@ -365,18 +455,23 @@ def main() -> int:
 
         t0 = time.monotonic()
         print("Pass 1/1: binning samples ...", flush=True)
-        for ev, addr in make_iter():
-            if ev != load_event and ev != store_event:
-                continue
-            if addr < user_lo or addr >= user_hi:
-                continue
-            idx = min((addr - addr_min) // width, regions - 1)
-            if ev == load_event:
-                load_bins[int(idx)] += 1
-                load_samples += 1
-            else:
-                store_bins[int(idx)] += 1
-                store_samples += 1
+        if input_type == "samples":
+            load_samples, store_samples = bin_columns(
+                make_cols(), user_lo, user_hi, addr_min, width, load_bins, store_bins
+            )
+        else:
+            for ev, addr in make_iter():
+                if ev != load_event and ev != store_event:
+                    continue
+                if addr < user_lo or addr >= user_hi:
+                    continue
+                idx = min((addr - addr_min) // width, regions - 1)
+                if ev == load_event:
+                    load_bins[int(idx)] += 1
+                    load_samples += 1
+                else:
+                    store_bins[int(idx)] += 1
+                    store_samples += 1
         print(f"  done in {time.monotonic() - t0:.1f}s", flush=True)
     else:
         # Pass 1: detect effective address range.
@@ -387,21 +482,24 @@ def main() -> int:
 
         t0 = time.monotonic()
         print("Pass 1/2: detecting address range ...", flush=True)
-        for ev, addr in make_iter():
-            if ev != load_event and ev != store_event:
-                continue
-            if user_lo is not None and addr < user_lo:
-                continue
-            if user_hi is not None and addr >= user_hi:
-                continue
-            if ev == load_event:
-                load_samples += 1
-            else:
-                store_samples += 1
-            if addr_min_v is None or addr < addr_min_v:
-                addr_min_v = addr
-            if addr_max_v is None or addr > addr_max_v:
-                addr_max_v = addr
+        if input_type == "samples":
+            addr_min_v, addr_max_v, load_samples, store_samples = range_from_columns(make_cols(), user_lo, user_hi)
+        else:
+            for ev, addr in make_iter():
+                if ev != load_event and ev != store_event:
+                    continue
+                if user_lo is not None and addr < user_lo:
+                    continue
+                if user_hi is not None and addr >= user_hi:
+                    continue
+                if ev == load_event:
+                    load_samples += 1
+                else:
+                    store_samples += 1
+                if addr_min_v is None or addr < addr_min_v:
+                    addr_min_v = addr
+                if addr_max_v is None or addr > addr_max_v:
+                    addr_max_v = addr
         print(f"  done in {time.monotonic() - t0:.1f}s", flush=True)
 
         if addr_min_v is None or addr_max_v is None:
@@ -425,18 +523,21 @@ def main() -> int:
 
         t0 = time.monotonic()
         print("Pass 2/2: binning samples ...", flush=True)
-        for ev, addr in make_iter():
-            if ev != load_event and ev != store_event:
-                continue
-            if user_lo is not None and addr < user_lo:
-                continue
-            if user_hi is not None and addr >= user_hi:
-                continue
-            idx = min((addr - addr_min) // width, regions - 1)
-            if ev == load_event:
-                load_bins[int(idx)] += 1
-            else:
-                store_bins[int(idx)] += 1
+        if input_type == "samples":
+            bin_columns(make_cols(), user_lo, user_hi, addr_min, width, load_bins, store_bins)
+        else:
+            for ev, addr in make_iter():
+                if ev != load_event and ev != store_event:
+                    continue
+                if user_lo is not None and addr < user_lo:
+                    continue
+                if user_hi is not None and addr >= user_hi:
+                    continue
+                idx = min((addr - addr_min) // width, regions - 1)
+                if ev == load_event:
+                    load_bins[int(idx)] += 1
+                else:
+                    store_bins[int(idx)] += 1
         print(f"  done in {time.monotonic() - t0:.1f}s", flush=True)
 
     total_bins = load_bins + store_bins
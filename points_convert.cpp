@@ -0,0 +1,209 @@
+// Convert between points.txt (`perf script -F time,event,addr` text) and the
+// compact columnar sample format in sample_format.hpp.
+//
+// Direction is picked from the input: a sample file is expanded back to text,
+// anything else is parsed as points.txt and packed.
+//
+//   ./points_convert --input=points.txt --output=points.bin
+//   ./points_convert --input=points.bin --output=- > points.txt
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "sample_format.hpp"
+
+namespace {
+
+struct Config {
+  std::string input = "-";
+  std::string output;
+  std::string event_filter;   // empty => keep all events
+  bool keep_zero = false;
+};
+
+static bool parse_flag(const char* arg, const char* name, const char** out_val) {
+  const size_t n = std::strlen(name);
+  if (std::strncmp(arg, name, n) != 0) return false;
+  if (arg[n] == '\0') {
+    *out_val = nullptr;
+    return true;
+  }
+  if (arg[n] != '=') return false;
+  *out_val = arg + n + 1;
+  return true;
+}
+
+static void usage(const char* argv0) {
+  std::cerr
+      << "Usage: " << argv0 << " --input=<file|-> --output=<file|->\n"
+      << "\n"
+      << "Options:\n"
+      << "  --input=<path>           points.txt or sample file (default: - = stdin text)\n"
+      << "  --output=<path>          Sample file (text input) or text (sample input, - = stdout).\n"
+      << "                           A sample file cannot go to stdout: its event table is\n"
+      << "                           rewritten in place on close\n"
+      << "  --event=<name>           Only keep this event (default: all)\n"
+      << "  --keep-zero=0|1          Keep samples with addr == 0 (default: 0)\n";
+}
+
+static bool parse_args(int argc, char** argv, Config* cfg) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = nullptr;
+
+    if (std::strcmp(a, "--help") == 0 || std::strcmp(a, "-h") == 0) {
+      usage(argv[0]);
+      return false;
+    }
+    if (parse_flag(a, "--input", &v) && v) {
+      cfg->input = v;
+      continue;
+    }
+    if (parse_flag(a, "--output", &v) && v) {
+      cfg->output = v;
+      continue;
+    }
+    if (parse_flag(a, "--event", &v) && v) {
+      cfg->event_filter = v;
+      continue;
+    }
+    if (parse_flag(a, "--keep-zero", &v) && v) {
+      cfg->keep_zero = (std::stoi(v) != 0);
+      continue;
+    }
+
+    std::cerr << "Unknown arg: " << a << "\n";
+    usage(argv[0]);
+    return false;
+  }
+  if (cfg->output.empty()) {
+    std::cerr << "--output is required\n";
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+static uint64_t file_bytes(const std::string& path) {
+  struct stat st;
+  if (path == "-" || stat(path.c_str(), &st) != 0) return 0;
+  return static_cast<uint64_t>(st.st_size);
+}
+
+static int to_text(const Config& cfg) {
+  sample_format::Reader r;
+  if (!r.open(cfg.input)) {
+    std::cerr << r.error() << "\n";
+    return 1;
+  }
+  FILE* out = (cfg.output == "-") ? stdout : std::fopen(cfg.output.c_str(), "w");
+  if (!out) {
+    std::cerr << "open " << cfg.output << " failed: " << std::strerror(errno) << "\n";
+    return 1;
+  }
+  const int want = cfg.event_filter.empty() ? -1 : r.event_index(cfg.event_filter);
+  const bool use_phys = (r.header().flags & sample_format::kHasPhys) != 0;
+
+  sample_format::Block b;
+  char line[256];
+  while (r.next(&b)) {
+    for (size_t i = 0; i < b.size(); i++) {
+      if (!cfg.event_filter.empty() && b.event[i] != want) continue;
+      const uint64_t a = use_phys ? b.phys_addr[i] : b.addr[i];
+      const std::string& ev = (b.event[i] < r.events().size()) ? r.events()[b.event[i]] : cfg.event_filter;
+      const int n = sample_format::format_points_line(line, sizeof(line), b.time_ns[i], ev, a);
+      std::fwrite(line, 1, static_cast<size_t>(n), out);
+    }
+  }
+  if (!r.error().empty()) {
+    std::cerr << cfg.input << ": " << r.error() << "\n";
+    if (out != stdout) std::fclose(out);
+    return 1;
+  }
+  if (out != stdout) std::fclose(out);
+  return 0;
+}
+
+static int to_binary(const Config& cfg) {
+  if (cfg.output == "-") {
+    std::cerr << "--output=- is only for text output; sample files need a seekable path\n";
+    return 1;
+  }
+  sample_format::Source src;
+  if (!src.open(cfg.input)) {
+    std::cerr << src.error() << "\n";
+    return 1;
+  }
+  sample_format::Writer w;
+  if (!w.open(cfg.output, {}, 0)) {
+    std::cerr << w.error() << "\n";
+    return 1;
+  }
+
+  const auto t0 = std::chrono::steady_clock::now();
+  sample_format::Block b;
+  std::vector<int> remap;   // source event index -> writer event index (-1 => dropped)
+  while (src.next(&b)) {
+    while (remap.size() < src.events().size()) {
+      const std::string& name = src.events()[remap.size()];
+      if (!cfg.event_filter.empty() && name != cfg.event_filter) {
+        remap.push_back(-1);
+        continue;
+      }
+      const int idx = w.add_event(name);
+      if (idx < 0) {
+        std::cerr << w.error() << "\n";
+        return 1;
+      }
+      remap.push_back(idx);
+    }
+    for (size_t i = 0; i < b.size(); i++) {
+      const int ev = remap[b.event[i]];
+      if (ev < 0) continue;
+      if (b.addr[i] == 0 && !cfg.keep_zero) continue;
+      sample_format::Sample s;
+      s.time_ns = b.time_ns[i];
+      s.addr = b.addr[i];
+      s.event = static_cast<uint8_t>(ev);
+      if (!w.append(s)) {
+        std::cerr << w.error() << "\n";
+        return 1;
+      }
+    }
+  }
+  const uint64_t n = w.samples();
+  if (!w.close()) {
+    std::cerr << w.error() << "\n";
+    return 1;
+  }
+
+  const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  const uint64_t in_bytes = file_bytes(cfg.input);
+  const uint64_t out_bytes = file_bytes(cfg.output);
+  std::cerr << "Converted " << n << " samples in " << sec << " s";
+  if (in_bytes && out_bytes) {
+    std::cerr << " (" << in_bytes << " -> " << out_bytes << " bytes, "
+              << static_cast<double>(in_bytes) / static_cast<double>(out_bytes) << "x)";
+  }
+  std::cerr << "\n";
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config cfg;
+  if (!parse_args(argc, argv, &cfg)) {
+    return 1;
+  }
+  if (cfg.input != "-" && sample_format::Reader::is_sample_file(cfg.input)) {
+    return to_text(cfg);
+  }
+  return to_binary(cfg);
+}
@@ -0,0 +1,320 @@
+// Offline group quantization of a llama2.c fp32 checkpoint for example.cpp.
+//
+// The far-memory transformer moves every weight once per token, so the
+// checkpoint size is the per-token far-memory traffic. This tool rewrites the
+// weight matrices as blocks of kGroup weights with one fp32 scale each (layout
+// in llama_quant.hpp); rmsnorm weights stay fp32. example.cpp recognizes the
+// file by its magic and dequantizes inside the matmul kernels.
+//
+//   ./quantize_llama --input=llama2_7b.bin --output=llama2_7b.q8.bin --type=q8
+//   ./quantize_llama --input=llama2_7b.bin --output=llama2_7b.q4.bin --type=q4
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "llama_quant.hpp"
+
+namespace {
+
+using llama_quant::BlockQ4;
+using llama_quant::BlockQ8;
+using llama_quant::kGroup;
+using llama_quant::WeightType;
+
+struct Config {
+  std::string input;
+  std::string output;
+  WeightType type = WeightType::kQ8;
+  int threads = 0;  // 0 => hardware_concurrency
+};
+
+// llama2.c checkpoint header.
+struct ModelConfig {
+  int32_t dim;
+  int32_t hidden_dim;
+  int32_t n_layers;
+  int32_t n_heads;
+  int32_t n_kv_heads;
+  int32_t vocab_size;  // negative => unshared classifier follows the weights
+  int32_t seq_len;
+};
+
+static bool parse_flag(const char* arg, const char* name, const char** out_val) {
+  const size_t n = std::strlen(name);
+  if (std::strncmp(arg, name, n) != 0) return false;
+  if (arg[n] == '\0') {
+    *out_val = nullptr;
+    return true;
+  }
+  if (arg[n] != '=') return false;
+  *out_val = arg + n + 1;
+  return true;
+}
+
+static void usage(const char* argv0) {
+  std::cerr
+      << "Usage: " << argv0 << " --input=<model.bin> --output=<model.qN.bin> [options]\n"
+      << "\n"
+      << "Options:\n"
+      << "  --input=<path>           llama2.c fp32 checkpoint\n"
+      << "  --output=<path>          Quantized checkpoint to write\n"
+      << "  --type=q8|q4             int8 or 4-bit weights, " << kGroup << " per fp32 scale (default: q8)\n"
+      << "  --threads=<n>            Quantization threads (default: all CPUs)\n";
+}
+
+static bool parse_args(int argc, char** argv, Config* cfg) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = nullptr;
+
+    if (std::strcmp(a, "--help") == 0 || std::strcmp(a, "-h") == 0) {
+      usage(argv[0]);
+      return false;
+    }
+    if (parse_flag(a, "--input", &v) && v) {
+      cfg->input = v;
+      continue;
+    }
+    if (parse_flag(a, "--output", &v) && v) {
+      cfg->output = v;
+      continue;
+    }
+    if (parse_flag(a, "--type", &v) && v) {
+      if (std::strcmp(v, "q8") == 0) cfg->type = WeightType::kQ8;
+      else if (std::strcmp(v, "q4") == 0) cfg->type = WeightType::kQ4;
+      else {
+        std::cerr << "Unknown --type: " << v << "\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--threads", &v) && v) {
+      cfg->threads = std::stoi(v);
+      continue;
+    }
+
+    std::cerr << "Unknown arg: " << a << "\n";
+    usage(argv[0]);
+    return false;
+  }
+  if (cfg->input.empty() || cfg->output.empty()) {
+    std::cerr << "--input and --output are required\n";
+    usage(argv[0]);
+    return false;
+  }
+  return true;
+}
+
+struct Tensor {
+  const char* name;
+  const float* data;
+  size_t n;
+};
+
+// Quantizes tensors on `threads` threads and appends them to `out`, reporting
+// the relative RMS error of each one.
+class Writer {
+ public:
+  Writer(FILE* out, WeightType type, int threads) : out_(out), type_(type), threads_(threads) {}
+
+  bool write_f32(const Tensor& t) {
+    if (std::fwrite(t.data, sizeof(float), t.n, out_) != t.n) return false;
+    bytes_in_ += t.n * sizeof(float);
+    bytes_out_ += t.n * sizeof(float);
+    return true;
+  }
+
+  bool write_blocks(const Tensor& t) {
+    constexpr size_t kSliceBlocks = size_t{1} << 20;
+    const size_t nb = t.n / kGroup;
+    const size_t block_bytes = llama_quant::weight_bytes(type_, kGroup);
+    std::vector<uint8_t> buf(std::min(nb, kSliceBlocks) * block_bytes);
+    std::vector<double> err(threads_), ref(threads_);
+    for (size_t b0 = 0; b0 < nb; b0 += kSliceBlocks) {
+      const size_t cnt = std::min(kSliceBlocks, nb - b0);
+      const size_t per = (cnt + threads_ - 1) / threads_;
+      std::vector<std::thread> pool;
+      for (int ti = 0; ti < threads_; ti++) {
+        pool.emplace_back([&, ti] {
+          const size_t lo = std::min(cnt, ti * per);
+          const size_t hi = std::min(cnt, lo + per);
+          quantize_range(t.data + (b0 + lo) * kGroup, buf.data() + lo * block_bytes, hi - lo, &err[ti], &ref[ti]);
+        });
+      }
+      for (auto& th : pool) th.join();
+      if (std::fwrite(buf.data(), block_bytes, cnt, out_) != cnt) return false;
+    }
+    double e = 0.0, r = 0.0;
+    for (int ti = 0; ti < threads_; ti++) {
+      e += err[ti];
+      r += ref[ti];
+    }
+    bytes_in_ += t.n * sizeof(float);
+    bytes_out_ += nb * block_bytes;
+    std::fprintf(stderr, "  %-22s %12zu weights  rel rms err %.4g\n", t.name, t.n, r > 0.0 ? std::sqrt(e / r) : 0.0);
+    return true;
+  }
+
+  uint64_t bytes_in() const { return bytes_in_; }
+  uint64_t bytes_out() const { return bytes_out_; }
+
+ private:
+  void quantize_range(const float* x, uint8_t* dst, size_t nb, double* err, double* ref) const {
+    float y[kGroup];
+    double e = 0.0, r = 0.0;
+    for (size_t i = 0; i < nb; i++, x += kGroup) {
+      if (type_ == WeightType::kQ8) {
+        auto* b = reinterpret_cast<BlockQ8*>(dst) + i;
+        llama_quant::quantize_q8(x, b, 1);
+        llama_quant::dequantize(b, y, 1);
+      } else {
+        auto* b = reinterpret_cast<BlockQ4*>(dst) + i;
+        llama_quant::quantize_q4(x, b, 1);
+        llama_quant::dequantize(b, y, 1);
+      }
+      for (size_t j = 0; j < kGroup; j++) {
+        e += static_cast<double>(x[j] - y[j]) * (x[j] - y[j]);
+        r += static_cast<double>(x[j]) * x[j];
+      }
+    }
+    *err += e;
+    *ref += r;
+  }
+
+  FILE* out_;
+  WeightType type_;
+  int threads_;
+  uint64_t bytes_in_ = 0;
+  uint64_t bytes_out_ = 0;
+};
+
+static int run(const Config& cfg) {
+  const int fd = open(cfg.input.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "cannot open " << cfg.input << ": " << std::strerror(errno) << "\n";
+    return 1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ModelConfig)) {
+    std::cerr << cfg.input << ": not a llama2.c checkpoint\n";
+    close(fd);
+    return 1;
+  }
+  const size_t file_size = static_cast<size_t>(st.st_size);
+  void* map = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    std::cerr << "mmap " << cfg.input << ": " << std::strerror(errno) << "\n";
+    return 1;
+  }
+  madvise(map, file_size, MADV_SEQUENTIAL);
+
+  ModelConfig c;
+  std::memcpy(&c, map, sizeof(c));
+  const bool shared = c.vocab_size > 0;
+  c.vocab_size = std::abs(c.vocab_size);
+  if (c.dim <= 0 || c.hidden_dim <= 0 || c.n_layers <= 0 || c.n_heads <= 0 || c.n_kv_heads <= 0 ||
+      c.seq_len <= 0 || c.dim % c.n_heads != 0) {
+    std::cerr << cfg.input << ": not a llama2.c checkpoint\n";
+    munmap(map, file_size);
+    return 1;
+  }
+  if (c.dim % kGroup != 0 || c.hidden_dim % kGroup != 0) {
+    std::cerr << "dim (" << c.dim << ") and hidden_dim (" << c.hidden_dim << ") must be multiples of " << kGroup
+              << "\n";
+    munmap(map, file_size);
+    return 1;
+  }
+
+  // Same walk as memory_map_weights() in example.cpp.
+  const size_t L = c.n_layers;
+  const size_t dim = c.dim;
+  const size_t hidden = c.hidden_dim;
+  const size_t head_size = dim / c.n_heads;
+  const size_t kv_dim = head_size * c.n_kv_heads;
+  const float* p = reinterpret_cast<const float*>(static_cast<const char*>(map) + sizeof(ModelConfig));
+  auto take = [&p](const char* name, size_t n) {
+    Tensor t{name, p, n};
+    p += n;
+    return t;
+  };
+  const Tensor emb = take("token_embedding_table", c.vocab_size * dim);
+  const Tensor rms_att = take("rms_att_weight", L * dim);
+  const Tensor wq = take("wq", L * dim * dim);
+  const Tensor wk = take("wk", L * dim * kv_dim);
+  const Tensor wv = take("wv", L * dim * kv_dim);
+  const Tensor wo = take("wo", L * dim * dim);
+  const Tensor rms_ffn = take("rms_ffn_weight", L * dim);
+  const Tensor w1 = take("w1", L * dim * hidden);
+  const Tensor w2 = take("w2", L * hidden * dim);
+  const Tensor w3 = take("w3", L * dim * hidden);
+  const Tensor rms_final = take("rms_final_weight", dim);
+  p += c.seq_len * head_size;  // legacy freq_cis_real / freq_cis_imag
+  const Tensor wcls = shared ? Tensor{"wcls", emb.data, emb.n} : take("wcls", c.vocab_size * dim);
+  const size_t need = reinterpret_cast<const char*>(p) - static_cast<const char*>(map);
+  if (need > file_size) {
+    std::cerr << cfg.input << ": truncated (" << file_size << " bytes, config needs " << need << ")\n";
+    munmap(map, file_size);
+    return 1;
+  }
+
+  const std::string tmp = cfg.output + ".tmp." + std::to_string(getpid());
+  FILE* out = std::fopen(tmp.c_str(), "wb");
+  if (!out) {
+    std::cerr << "cannot open " << tmp << ": " << std::strerror(errno) << "\n";
+    munmap(map, file_size);
+    return 1;
+  }
+  llama_quant::FileHeader h;
+  std::memset(&h, 0, sizeof(h));
+  h.magic = llama_quant::kMagic;
+  h.version = llama_quant::kVersion;
+  std::memcpy(h.config, &c, sizeof(h.config));
+  h.type = static_cast<uint32_t>(cfg.type);
+  h.group = kGroup;
+  h.shared_classifier = shared ? 1 : 0;
+
+  const int threads = cfg.threads > 0 ? cfg.threads : std::max(1u, std::thread::hardware_concurrency());
+  std::fprintf(stderr, "%s: dim=%d hidden_dim=%d layers=%d heads=%d kv_heads=%d vocab=%d -> %s, %d threads\n",
+               cfg.input.c_str(), c.dim, c.hidden_dim, c.n_layers, c.n_heads, c.n_kv_heads, c.vocab_size,
+               llama_quant::weight_type_name(cfg.type), threads);
+  Writer w(out, cfg.type, threads);
+  bool ok = std::fwrite(&h, sizeof(h), 1, out) == 1;
+  for (const Tensor* t : {&rms_att, &rms_ffn, &rms_final}) ok = ok && w.write_f32(*t);
+  for (const Tensor* t : {&emb, &wq, &wk, &wv, &wo, &w1, &w2, &w3}) ok = ok && w.write_blocks(*t);
+  if (!shared) ok = ok && w.write_blocks(wcls);
+  ok = (std::fclose(out) == 0) && ok;
+  munmap(map, file_size);
+  if (!ok || std::rename(tmp.c_str(), cfg.output.c_str()) != 0) {
+    std::cerr << "cannot write " << cfg.output << ": " << std::strerror(errno) << "\n";
+    std::remove(tmp.c_str());
+    return 1;
+  }
+  std::fprintf(stderr, "wrote %s: %.1f MiB of weights -> %.1f MiB (%.2fx less far-memory traffic per token)\n",
+               cfg.output.c_str(), w.bytes_in() / 1048576.0, w.bytes_out() / 1048576.0,
+               static_cast<double>(w.bytes_in()) / static_cast<double>(w.bytes_out()));
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Config cfg;
+  if (!parse_args(argc, argv, &cfg)) {
+    return 1;
+  }
+  return run(cfg);
+}
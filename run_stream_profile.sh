@@ -60,12 +60,20 @@ THREADS=${THREADS:-$AUTO_NPROC}
 CPU_START=${CPU_START:--1}
 PATTERN=${PATTERN:-chunk}       # chunk|interleave
 OP=${OP:-triad}                 # read|write|copy|triad
+SIMD=${SIMD:-auto}              # auto|scalar|avx2|avx512 (kernel instruction set)
+STORE=${STORE:-regular}         # regular|nt (streaming stores for write/copy/triad)
+PREFETCH_DISTANCE=${PREFETCH_DISTANCE:-0} # software prefetch distance in cache lines (0 = off)
+PASSES_PER_CHECK=${PASSES_PER_CHECK:-1}   # poll the stop flag / read the clock every N passes
+STREAM_TIMELINE=${STREAM_TIMELINE:-1}     # 1 => per-thread GB/s CSV (bandwidth_timeline.csv) in OUT_DIR
 PHASE_PAGES=${PHASE_PAGES:-0}   # 0 disables (optional diagonal structure)
 # Visualization knobs (optional; default disabled)
 WINDOW_PAGES=${WINDOW_PAGES:-0}
 STEP_PAGES=${STEP_PAGES:-0}
 PHASE_SLEEP_US=${PHASE_SLEEP_US:-0}
 SYNC_PHASES=${SYNC_PHASES:-0}
+POPULATE=${POPULATE:-serial}    # serial|parallel|madv_populate|map_populate
+PAGE_BACKING=${PAGE_BACKING:-4k} # 4k|thp|huge2m|huge1g (*_PAGES knobs count pages of this size)
+NUMA=${NUMA:-local}             # local|interleave[:N]|bind:N|split:R[:F,S] (mbind placement)
 
 BENCH_DURATION=${BENCH_DURATION:-60}
 WARMUP_SEC=${WARMUP_SEC:-1}
@@ -171,6 +179,13 @@ else
 fi
 
 echo "=== Start stream_bench ==="
+# result.json: machine-readable summary; ready.fifo: wakes us when the streaming loop starts.
+READY_FIFO="$OUT_DIR/ready.fifo"
+READY_ARGS=()
+if [ "$START_AFTER_READY" = "1" ]; then
+  open_ready_fifo "$READY_FIFO"
+  READY_ARGS=(--ready-file="$READY_FIFO")
+fi
 set +e
 ./stream_bench \
   --mem-mb="$MEM_SIZE_MB" \
@@ -180,13 +195,23 @@ set +e
   --cpu-start="$CPU_START" \
   --pattern="$PATTERN" \
   --op="$OP" \
+  --simd="$SIMD" \
+  --store="$STORE" \
+  --prefetch-distance="$PREFETCH_DISTANCE" \
+  --timeline="$([ "$STREAM_TIMELINE" = "1" ] && echo "$OUT_DIR/bandwidth_timeline.csv")" \
   --touch=1 \
+  --populate="$POPULATE" \
+  --page-backing="$PAGE_BACKING" \
+  --numa="$NUMA" \
   --phase-pages="$PHASE_PAGES" \
   --window-pages="$WINDOW_PAGES" \
   --step-pages="$STEP_PAGES" \
   --phase-sleep-us="$PHASE_SLEEP_US" \
   --sync-phases="$SYNC_PHASES" \
-  >"$OUT_DIR/bench.log" 2>&1 &
+  --passes-per-check="$PASSES_PER_CHECK" \
+  --json="$OUT_DIR/result.json" \
+  "${READY_ARGS[@]}" \
+  >"$OUT_DIR/bench.log" 2>&1 9<&- &
 BENCH_PID=$!
 export BENCH_PID
 set -e
@@ -204,20 +229,18 @@ if ! kill -0 "$BENCH_PID" 2>/dev/null; then
   exit 1
 fi
 
+READY_ADDR_LO=""
+READY_ADDR_HI=""
 if [ "$START_AFTER_READY" = "1" ]; then
   echo "=== Wait for streaming loop to begin (START_AFTER_READY=1) ==="
-  # Wait until stream_bench prints READY after mmap+touch complete.
-  for _ in $(seq 1 6000); do # ~600s max (0.1s * 6000)
-    if ! kill -0 "$BENCH_PID" 2>/dev/null; then
-      echo "ERROR: stream_bench exited before profiling started; see log: $OUT_DIR/bench.log" >&2
-      tail -n 160 "$OUT_DIR/bench.log" >&2 || true
-      exit 1
-    fi
-    if grep -q "READY: begin streaming loop" "$OUT_DIR/bench.log" 2>/dev/null; then
-      break
-    fi
-    sleep 0.1
-  done
+  # stream_bench writes to the FIFO after mmap+touch, right before the workers start.
+  if ! wait_ready_fifo "$BENCH_PID" 600; then
+    echo "ERROR: stream_bench exited before profiling started; see log: $OUT_DIR/bench.log" >&2
+    tail -n 160 "$OUT_DIR/bench.log" >&2 || true
+    exit 1
+  fi
+  echo "Streaming loop started at $READY_TIME (CLOCK_MONOTONIC)"
+  close_ready_fifo "$READY_FIFO"
 fi
 
 echo "=== Snapshot /proc maps ==="
@@ -228,10 +251,14 @@ if [ -r "/proc/$BENCH_PID/smaps_rollup" ]; then
   cp "/proc/$BENCH_PID/smaps_rollup" "$OUT_DIR/smaps_rollup.txt" 2>/dev/null || true
 fi
 
-echo "=== Determine address filter range (from bench log) ==="
-ADDR_MIN=""
-ADDR_MAX=""
+echo "=== Determine address filter range ==="
+ADDR_MIN="$READY_ADDR_LO"
+ADDR_MAX="$READY_ADDR_HI"
+# Without START_AFTER_READY the FIFO was not read; fall back to the log.
 for _ in $(seq 1 50); do
+  if [ -n "$ADDR_MIN" ] && [ -n "$ADDR_MAX" ]; then
+    break
+  fi
   ADDR_MIN=$(perl -ne 'if (/Populating memory \((0x[0-9a-fA-F]+) - (0x[0-9a-fA-F]+)\)/) { print $1; exit }' "$OUT_DIR/bench.log" || true)
   ADDR_MAX=$(perl -ne 'if (/Populating memory \((0x[0-9a-fA-F]+) - (0x[0-9a-fA-F]+)\)/) { print $2; exit }' "$OUT_DIR/bench.log" || true)
   if [ -n "$ADDR_MIN" ] && [ -n "$ADDR_MAX" ]; then
@@ -261,6 +288,7 @@ if [ "$PERF_UNTIL_EXIT" = "1" ]; then
   echo "Sampling mode: until benchmark exits (PERF_UNTIL_EXIT=1)"
   "$PERF_BIN" record \
     -e "$PERF_EVENT_STR" \
+    -k CLOCK_MONOTONIC \
     -c "$SAMPLE_PERIOD" \
     $PERF_TARGET_FLAGS \
     -d \
@@ -275,6 +303,7 @@ else
   echo "Sampling mode: fixed duration ${PERF_DURATION}s"
   "$PERF_BIN" record \
     -e "$PERF_EVENT_STR" \
+    -k CLOCK_MONOTONIC \
     -c "$SAMPLE_PERIOD" \
     $PERF_TARGET_FLAGS \
     -d \
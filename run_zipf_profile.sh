@@ -36,12 +36,26 @@ SKEW=${SKEW:-0.99}                   # 0.99 Zipfian, 0.0 uniform
 BENCH_DURATION=${BENCH_DURATION:-120}
 THREADS=${THREADS:-1}                # zipf_bench threads
 CPU_START=${CPU_START:-0}
+ZIPF_GEN=${ZIPF_GEN:-legacy}         # legacy | fast (alias table + xoshiro, same distribution)
+POPULATE=${POPULATE:-serial}         # serial | parallel | madv_populate | map_populate
+PAGE_BACKING=${PAGE_BACKING:-4k}     # 4k | thp | huge2m | huge1g (Zipf ranks index pages of this size)
+NUMA=${NUMA:-local}                  # local | interleave[:N] | bind:N | split:R[:F,S] (e.g. split:0.2)
+OBJECT_SIZE=${OBJECT_SIZE:-0}        # bytes per Zipf object (0 => one page)
+LINES_PER_ACCESS=${LINES_PER_ACCESS:-0} # cache lines per access (0 => min(64, object lines))
+WRITE_RATIO=${WRITE_RATIO:-0}        # fraction of accesses that store; >0 also samples mem-stores
+FALSE_SHARING=${FALSE_SHARING:-off}  # off | shared | padded (per-thread counters packed in shared lines or one per line)
+MLP=${MLP:-0}                        # keys prefetched ahead per thread, or "chase" (one miss at a time)
+SHIFT_EVERY=${SHIFT_EVERY:-0}        # >0 => move the hot set every SHIFT_EVERY sec (zipf_shifts.csv in OUT_DIR)
+SHIFT_FRACTION=${SHIFT_FRACTION:-1}  # fraction of pages remapped per shift
+ZIPF_STATS=${ZIPF_STATS:-1}          # 1 => per-thread ops/s and latency CSVs in OUT_DIR
+STATS_INTERVAL_MS=${STATS_INTERVAL_MS:-1000}
 WARMUP_SEC=${WARMUP_SEC:-1}
 
 PERF_DURATION=${PERF_DURATION:-30}
 SAMPLE_PERIOD=${SAMPLE_PERIOD:-50}
 PERF_UNTIL_EXIT=${PERF_UNTIL_EXIT:-0}
 PERF_EVENT_MOD=${PERF_EVENT_MOD:-Su} # PEBS + user-only
+SAMPLER=${SAMPLER:-perf}             # perf | native (pebs_sampler, skips perf script decode)
 
 DO_VIRT=${DO_VIRT:-1}
 DO_PHYS=${DO_PHYS:-0}
@@ -90,6 +104,10 @@ echo "do:   DO_VIRT=$DO_VIRT DO_PHYS=$DO_PHYS DO_PERSIST=$DO_PERSIST"
 
 echo "=== Build benchmark ==="
 make zipf_bench >/dev/null
+if [ "$SAMPLER" = "native" ]; then
+  # The native path keeps samples.bin binary end to end: the C++ tools read it directly.
+  make pebs_sampler heatmap infer_addr_range hot_persistence >/dev/null
+fi
 
 if [ -n "${SUDO_PASS:-}" ]; then
   echo "=== Set perf sysctls (no throttling) ==="
@@ -104,13 +122,39 @@ fi
 
 echo "=== Start zipf_bench ==="
 BENCH_LOG="$OUT_DIR/bench.log"
-ZIPF_CMD=(./zipf_bench "$MEM_SIZE_MB" "$SKEW" "$BENCH_DURATION" "$THREADS" "$CPU_START")
+ZIPF_CMD=(./zipf_bench "$MEM_SIZE_MB" "$SKEW" "$BENCH_DURATION" "$THREADS" "$CPU_START" "--gen=$ZIPF_GEN" "--populate=$POPULATE" "--page-backing=$PAGE_BACKING" "--numa=$NUMA")
+if [ "$OBJECT_SIZE" != "0" ]; then
+  ZIPF_CMD+=("--object-size=$OBJECT_SIZE")
+fi
+if [ "$LINES_PER_ACCESS" != "0" ]; then
+  ZIPF_CMD+=("--lines-per-access=$LINES_PER_ACCESS")
+fi
+if [ "$WRITE_RATIO" != "0" ]; then
+  ZIPF_CMD+=("--write-ratio=$WRITE_RATIO")
+fi
+if [ "$FALSE_SHARING" != "off" ]; then
+  ZIPF_CMD+=("--false-sharing=$FALSE_SHARING")
+fi
+if [ "$MLP" != "0" ]; then
+  ZIPF_CMD+=("--mlp=$MLP")
+fi
+if [ "$SHIFT_EVERY" != "0" ]; then
+  ZIPF_CMD+=("--shift-every=$SHIFT_EVERY" "--shift-fraction=$SHIFT_FRACTION" "--shift-log=$OUT_DIR/zipf_shifts.csv")
+fi
+if [ "$ZIPF_STATS" = "1" ]; then
+  # Timestamps are CLOCK_MONOTONIC; perf/pebs_sampler below record with the same clock.
+  ZIPF_CMD+=("--stats-csv=$OUT_DIR/zipf_stats.csv" "--lat-csv=$OUT_DIR/zipf_latency.csv" "--stats-interval-ms=$STATS_INTERVAL_MS")
+fi
+# result.json: machine-readable summary; ready.fifo: wakes us when the workers start.
+READY_FIFO="$OUT_DIR/ready.fifo"
+open_ready_fifo "$READY_FIFO"
+ZIPF_CMD+=("--json=$OUT_DIR/result.json" "--ready-file=$READY_FIFO")
 if command -v stdbuf >/dev/null 2>&1; then
   ZIPF_CMD=(stdbuf -oL -eL "${ZIPF_CMD[@]}")
 fi
 
 set +e
-"${ZIPF_CMD[@]}" >"$BENCH_LOG" 2>&1 &
+"${ZIPF_CMD[@]}" >"$BENCH_LOG" 2>&1 9<&- &
 BENCH_PID=$!
 export BENCH_PID
 set -e
@@ -130,96 +174,125 @@ if ! kill -0 "$BENCH_PID" 2>/dev/null; then
 fi
 
 echo "=== Wait for benchmark to start (avoid fault-in noise) ==="
-for _ in $(seq 1 6000); do # ~600s max
-  if ! kill -0 "$BENCH_PID" 2>/dev/null; then
-    echo "ERROR: zipf_bench exited before profiling started; see log: $BENCH_LOG" >&2
-    tail -n 160 "$BENCH_LOG" >&2 || true
-    exit 1
-  fi
-  if grep -q "Starting benchmark" "$BENCH_LOG" 2>/dev/null; then
-    break
-  fi
-  sleep 0.1
-done
-
-echo "=== Detect heap mapping range (from benchmark log) ==="
-HEAP_START=""
-HEAP_END=""
-for _ in $(seq 1 50); do
-  HEAP_START=$(perl -ne 'if (/Populating memory \\((0x[0-9a-fA-F]+) - (0x[0-9a-fA-F]+)\\)/) { print $1; exit }' "$BENCH_LOG" || true)
-  HEAP_END=$(perl -ne 'if (/Populating memory \\((0x[0-9a-fA-F]+) - (0x[0-9a-fA-F]+)\\)/) { print $2; exit }' "$BENCH_LOG" || true)
-  if [ -n "$HEAP_START" ] && [ -n "$HEAP_END" ]; then
-    break
-  fi
-  sleep 0.05
-done
+if ! wait_ready_fifo "$BENCH_PID" 600; then
+  echo "ERROR: zipf_bench exited before profiling started; see log: $BENCH_LOG" >&2
+  tail -n 160 "$BENCH_LOG" >&2 || true
+  exit 1
+fi
+close_ready_fifo "$READY_FIFO"
+echo "Workers started at $READY_TIME (CLOCK_MONOTONIC)"
+
+# Heap mapping range, from the ready line.
+HEAP_START="$READY_ADDR_LO"
+HEAP_END="$READY_ADDR_HI"
 if [ -n "$HEAP_START" ] && [ -n "$HEAP_END" ]; then
   echo "Heap range: $HEAP_START - $HEAP_END"
 else
   echo "Warning: could not parse heap range; will infer from samples when needed."
 fi
 
-echo "=== perf record (PEBS data addr) ==="
-PERF_DATA="$OUT_DIR/perf.data"
-rm -f "$PERF_DATA" 2>/dev/null || true
+POINTS_TXT="$OUT_DIR/points.txt"
+rm -f "$POINTS_TXT" 2>/dev/null || true
 
-# Auto-detect best perf parameters for the current environment
-if command -v detect_perf_params >/dev/null 2>&1; then
-  detect_perf_params "$BENCH_PID"
-else
-  PERF_EVENT_STR="cpu/mem-loads/pp"
-  PERF_TARGET_FLAGS="-a"
-fi
+if [ "$SAMPLER" = "native" ]; then
+  echo "=== pebs_sampler (PEBS data addr, native ring-buffer drain) ==="
+  PERF_DATA="$OUT_DIR/samples.bin"
+  rm -f "$PERF_DATA" 2>/dev/null || true
+  SAMPLER_ARGS=(--output="$PERF_DATA" --period="$SAMPLE_PERIOD" --pid="$BENCH_PID" --clock=monotonic)
+  if [ "$WRITE_RATIO" != "0" ]; then
+    SAMPLER_ARGS+=(--events=loads,stores)
+  fi
+  if [ "$PERF_UNTIL_EXIT" != "1" ]; then
+    SAMPLER_ARGS+=(--duration="$PERF_DURATION")
+  fi
+  ./pebs_sampler "${SAMPLER_ARGS[@]}" 2>&1 | tail -n 5
 
-if [ "$PERF_UNTIL_EXIT" = "1" ]; then
-  "$PERF_BIN" record \
-    -e "$PERF_EVENT_STR" \
-    -c "$SAMPLE_PERIOD" \
-    $PERF_TARGET_FLAGS \
-    -d \
-    --no-buildid --no-buildid-cache \
-    -o "$PERF_DATA" \
-    -- sleep 9999999 >/dev/null 2>&1 &
-  PERF_REC_PID=$!
-  wait "$BENCH_PID" 2>/dev/null || true
-  kill -INT "$PERF_REC_PID" 2>/dev/null || true
-  wait "$PERF_REC_PID" 2>/dev/null || true
+  # The file header is written even when nothing was sampled, so count decoded samples.
+  SAMPLE_COUNT="$(./pebs_sampler --count="$PERF_DATA" 2>/dev/null || echo 0)"
+  if [ "$SAMPLE_COUNT" = "0" ]; then
+    echo "ERROR: pebs_sampler did not produce samples (or it is unreadable): $PERF_DATA" >&2
+    exit 1
+  fi
+  echo "Decoded $SAMPLE_COUNT samples from $PERF_DATA"
 else
-  "$PERF_BIN" record \
-    -e "$PERF_EVENT_STR" \
-    -c "$SAMPLE_PERIOD" \
-    $PERF_TARGET_FLAGS \
-    -d \
-    --no-buildid --no-buildid-cache \
-    -o "$PERF_DATA" \
-    -- sleep "$PERF_DURATION" 2>&1 | tail -n 5
-fi
+  echo "=== perf record (PEBS data addr) ==="
+  PERF_DATA="$OUT_DIR/perf.data"
+  rm -f "$PERF_DATA" 2>/dev/null || true
 
-if [ ! -s "$PERF_DATA" ]; then
-  echo "ERROR: perf did not produce perf.data (or it is empty): $PERF_DATA" >&2
-  exit 1
-fi
+  # Auto-detect best perf parameters for the current environment
+  if command -v detect_perf_params >/dev/null 2>&1; then
+    detect_perf_params "$BENCH_PID"
+  else
+    PERF_EVENT_STR="cpu/mem-loads/pp"
+    PERF_TARGET_FLAGS="-a"
+  fi
+  if [ "$WRITE_RATIO" != "0" ]; then
+    PERF_EVENT_STR="$PERF_EVENT_STR,cpu/mem-stores/pp"
+  fi
 
-echo "=== Extract points (time,event,addr) ==="
-POINTS_TXT="$OUT_DIR/points.txt"
-rm -f "$POINTS_TXT" 2>/dev/null || true
-"$PERF_BIN" script -i "$PERF_DATA" -F time,event,addr 2>/dev/null > "$POINTS_TXT"
+  if [ "$PERF_UNTIL_EXIT" = "1" ]; then
+    "$PERF_BIN" record \
+      -e "$PERF_EVENT_STR" \
+      -k CLOCK_MONOTONIC \
+      -c "$SAMPLE_PERIOD" \
+      $PERF_TARGET_FLAGS \
+      -d \
+      --no-buildid --no-buildid-cache \
+      -o "$PERF_DATA" \
+      -- sleep 9999999 >/dev/null 2>&1 &
+    PERF_REC_PID=$!
+    wait "$BENCH_PID" 2>/dev/null || true
+    kill -INT "$PERF_REC_PID" 2>/dev/null || true
+    wait "$PERF_REC_PID" 2>/dev/null || true
+  else
+    "$PERF_BIN" record \
+      -e "$PERF_EVENT_STR" \
+      -k CLOCK_MONOTONIC \
+      -c "$SAMPLE_PERIOD" \
+      $PERF_TARGET_FLAGS \
+      -d \
+      --no-buildid --no-buildid-cache \
+      -o "$PERF_DATA" \
+      -- sleep "$PERF_DURATION" 2>&1 | tail -n 5
+  fi
 
-if [ ! -s "$POINTS_TXT" ]; then
-  echo "ERROR: no samples decoded into points file: $POINTS_TXT" >&2
-  exit 1
+  if [ ! -s "$PERF_DATA" ]; then
+    echo "ERROR: perf did not produce perf.data (or it is empty): $PERF_DATA" >&2
+    exit 1
+  fi
+
+  echo "=== Extract points (time,event,addr) ==="
+  "$PERF_BIN" script -i "$PERF_DATA" -F time,event,addr 2>/dev/null > "$POINTS_TXT"
+
+  if [ ! -s "$POINTS_TXT" ]; then
+    echo "ERROR: no samples decoded into points file: $POINTS_TXT" >&2
+    exit 1
+  fi
 fi
 
+# Prints "<min_hex> <max_hex> <count>" for the densest 1 GiB-bucket window.
+infer_heap_range() {
+  if [ "$SAMPLER" = "native" ]; then
+    ./infer_addr_range --input="$PERF_DATA" --mode=window --window-gb=1 --window-strategy=best --window-output=full
+  else
+    python3 ./infer_addr_range.py --mode window --window-gb 1 --window-strategy best --window-output full --max-lines 200000 < "$POINTS_TXT"
+  fi
+}
+
 if [ "$DO_VIRT" = "1" ]; then
   echo "=== Plot virt heatmap ==="
   ADDR_MIN="$HEAP_START"
   ADDR_MAX="$HEAP_END"
   if [ -z "$ADDR_MIN" ] || [ -z "$ADDR_MAX" ]; then
-    read -r ADDR_MIN ADDR_MAX _CNT < <(
-      python3 ./infer_addr_range.py --mode window --window-gb 1 --window-strategy best --window-output full --max-lines 200000 < "$POINTS_TXT"
-    )
+    read -r ADDR_MIN ADDR_MAX _CNT < <(infer_heap_range)
   fi
-  PLOT_ARGS=(--input "$POINTS_TXT" --output "$OUT_DIR/virt_heatmap.png" --title "$TITLE" --addr-min "$ADDR_MIN" --addr-max "$ADDR_MAX" --max-points "$MAX_POINTS" --dpi "$HEATMAP_DPI" --gridsize "$HEATMAP_GRIDSIZE" --figsize "$HEATMAP_FIGSIZE" --color-scale "$HEATMAP_COLOR_SCALE")
+  PLOT_INPUT="$POINTS_TXT"
+  if [ "$SAMPLER" = "native" ]; then
+    PLOT_INPUT="$OUT_DIR/virt_heatmap.npy"
+    ./heatmap --input="$PERF_DATA" --output="$PLOT_INPUT" --addr-min="$ADDR_MIN" --addr-max="$ADDR_MAX" \
+      --ybins="$HEATMAP_GRIDSIZE" --y-offset=1
+  fi
+  PLOT_ARGS=(--input "$PLOT_INPUT" --output "$OUT_DIR/virt_heatmap.png" --title "$TITLE" --addr-min "$ADDR_MIN" --addr-max "$ADDR_MAX" --max-points "$MAX_POINTS" --dpi "$HEATMAP_DPI" --gridsize "$HEATMAP_GRIDSIZE" --figsize "$HEATMAP_FIGSIZE" --color-scale "$HEATMAP_COLOR_SCALE")
   if [ -n "$HEATMAP_VMAX_PCT" ]; then
     PLOT_ARGS+=(--vmax-percentile "$HEATMAP_VMAX_PCT")
   fi
@@ -240,6 +313,7 @@ if [ "$DO_PHYS" = "1" ]; then
   fi
   "${PERF_RUN[@]}" record \
     -e "{cpu/mem-loads-aux/,cpu/mem-loads/pp}:${PERF_EVENT_MOD}" \
+    -k CLOCK_MONOTONIC \
     -c "$SAMPLE_PERIOD" \
     -p "$BENCH_PID" \
     -d --phys-data \
@@ -261,12 +335,18 @@ if [ "$DO_PERSIST" = "1" ]; then
   ADDR_MIN="$HEAP_START"
   ADDR_MAX="$HEAP_END"
   if [ -z "$ADDR_MIN" ] || [ -z "$ADDR_MAX" ]; then
-    read -r ADDR_MIN ADDR_MAX _CNT < <(
-      python3 ./infer_addr_range.py --mode window --window-gb 1 --window-strategy best --window-output full --max-lines 200000 < "$POINTS_TXT"
-    )
+    read -r ADDR_MIN ADDR_MAX _CNT < <(infer_heap_range)
+  fi
+  PERSIST_INPUT="$POINTS_TXT"
+  if [ "$SAMPLER" = "native" ]; then
+    PERSIST_INPUT="$OUT_DIR/hot_persistence.csv"
+    ./hot_persistence --input="$PERF_DATA" --output="$PERSIST_INPUT" \
+      --addr-min="$ADDR_MIN" --addr-max="$ADDR_MAX" \
+      --ref-start="$PERSIST_REF_START" --ref-windows="$PERSIST_REF_WINDOW" \
+      --topk="$PERSIST_TOPK" --bin="$PERSIST_BIN_SEC"
   fi
   python3 ./hot_persistence.py \
-    --input "$POINTS_TXT" \
+    --input "$PERSIST_INPUT" \
     --output "$OUT_DIR/hot_persistence.png" \
     --title "${TITLE} hot persistence" \
     --addr-min "$ADDR_MIN" --addr-max "$ADDR_MAX" \
@@ -279,7 +359,9 @@ echo ""
 echo "Done:"
 echo "  log:      $BENCH_LOG"
 echo "  perf.data: $PERF_DATA"
-echo "  points:   $POINTS_TXT"
+if [ "$SAMPLER" != "native" ]; then
+  echo "  points:   $POINTS_TXT"
+fi
 echo "  out:      $OUT_DIR"
 
 
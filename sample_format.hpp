@@ -0,0 +1,660 @@
+// Compact columnar sample format shared by the C++ tools (header-only).
+//
+// Replaces the ASCII points.txt ("<time>: <event>: <addr>") that every script
+// re-parses with a regex. Samples are stored in blocks of up to kBlockSamples;
+// inside a block each field is its own column so readers that only need
+// (time, addr) never touch the rest.
+//
+// File layout (all integers little endian):
+//   FileHeader
+//   event table, FileHeader::table_bytes long (zero padded):
+//     n_events x { uint16_t len; char name[len]; }   (perf-script style names)
+//   Block*
+//
+// The event table is padded so writers can register new event names while
+// streaming (e.g. stores first showing up late in a points.txt) and rewrite
+// the table in place on close.
+//
+// Block layout:
+//   BlockHeader { magic "SBLK", count, time_unit_ns, col_bytes[kNumColumns] }
+//   column payloads, in Column order, each col_bytes[c] bytes long:
+//     kTime, kAddr, kPhys, kPid, kTid : zigzag(LEB128) of delta vs previous
+//                                      sample in the block (first vs 0);
+//                                      kTime is in units of time_unit_ns
+//     kEvent                           : one uint8_t per sample
+//   Columns disabled by FileHeader::flags have col_bytes == 0.
+//
+// Time is stored in nanoseconds. Text converted from `perf script` keeps its
+// microsecond resolution, so a round trip back to text is lossless.
+//
+// sample_format.py reads the same layout from Python.
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace sample_format {
+
+constexpr char kFileMagic[8] = {'W', 'P', 'S', 'A', 'M', 'P', 'L', '1'};
+constexpr uint32_t kBlockMagic = 0x4b4c4253;  // "SBLK"
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kBlockSamples = 1 << 16;
+constexpr uint32_t kMaxEvents = 256;
+constexpr uint32_t kMinTableBytes = 4096;
+
+enum Flags : uint32_t {
+  kHasPhys = 1u << 0,
+  kHasPidTid = 1u << 1,
+};
+
+enum Column : int { kTime = 0, kEvent, kAddr, kPhys, kPid, kTid, kNumColumns };
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t n_events;
+  uint32_t table_bytes;
+  uint64_t sample_period;   // 0 if unknown (e.g. converted from text)
+};
+
+struct BlockHeader {
+  uint32_t magic;
+  uint32_t count;
+  uint32_t time_unit_ns;    // 1000 when every time in the block is whole microseconds
+  uint32_t col_bytes[kNumColumns];
+};
+
+static_assert(sizeof(FileHeader) == 32, "FileHeader layout must stay stable");
+static_assert(sizeof(BlockHeader) == 36, "BlockHeader layout must stay stable");
+
+struct Sample {
+  uint64_t time_ns = 0;
+  uint64_t addr = 0;
+  uint64_t phys_addr = 0;
+  uint32_t pid = 0;
+  uint32_t tid = 0;
+  uint8_t event = 0;
+};
+
+// One decoded block, column by column. Disabled columns stay empty.
+struct Block {
+  std::vector<uint64_t> time_ns;
+  std::vector<uint8_t> event;
+  std::vector<uint64_t> addr;
+  std::vector<uint64_t> phys_addr;
+  std::vector<uint32_t> pid;
+  std::vector<uint32_t> tid;
+
+  size_t size() const { return time_ns.size(); }
+};
+
+// One undecoded block as read from disk.
+struct RawBlock {
+  BlockHeader hdr{};
+  std::vector<uint8_t> payload;
+};
+
+// ---- varint helpers -------------------------------------------------------
+
+inline uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1); }
+
+inline void put_varint(std::vector<uint8_t>* out, uint64_t v) {
+  while (v >= 0x80) {
+    out->push_back(static_cast<uint8_t>(v) | 0x80);
+    v >>= 7;
+  }
+  out->push_back(static_cast<uint8_t>(v));
+}
+
+// Returns nullptr on truncated input.
+inline const uint8_t* get_varint(const uint8_t* p, const uint8_t* end, uint64_t* v) {
+  uint64_t r = 0;
+  int shift = 0;
+  while (p < end && shift < 64) {
+    const uint8_t b = *p++;
+    r |= static_cast<uint64_t>(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      *v = r;
+      return p;
+    }
+    shift += 7;
+  }
+  return nullptr;
+}
+
+template <typename T>
+inline bool decode_delta_column(const uint8_t* p, const uint8_t* end, uint32_t count, std::vector<T>* out) {
+  out->resize(count);
+  uint64_t prev = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t z;
+    p = get_varint(p, end, &z);
+    if (!p) return false;
+    prev += static_cast<uint64_t>(unzigzag(z));
+    (*out)[i] = static_cast<T>(prev);
+  }
+  return p == end;
+}
+
+// ---- points.txt compatibility ---------------------------------------------
+
+// Parse one `perf script -F time,event,addr` line, e.g.
+//   "50858.386645:   cpu/mem-loads/pp:     7a6c1a8214c0"
+// Separators (':' and whitespace) are optional, matching the Python LINE_RE.
+// Returns false for lines that do not look like a sample.
+inline bool parse_points_line(const char* s, uint64_t* time_ns, std::string* event, uint64_t* addr) {
+  while (*s == ' ' || *s == '\t') s++;
+  if (*s < '0' || *s > '9') return false;
+
+  uint64_t sec = 0;
+  while (*s >= '0' && *s <= '9') sec = sec * 10 + static_cast<uint64_t>(*s++ - '0');
+  uint64_t frac = 0;
+  int digits = 0;
+  if (*s == '.') {
+    s++;
+    while (*s >= '0' && *s <= '9') {
+      if (digits < 9) {
+        frac = frac * 10 + static_cast<uint64_t>(*s - '0');
+        digits++;
+      }
+      s++;
+    }
+  }
+  for (int d = digits; d < 9; d++) frac *= 10;
+  *time_ns = sec * 1000000000ULL + frac;
+
+  while (*s == ':') s++;
+  if (*s != ' ' && *s != '\t') return false;
+  while (*s == ' ' || *s == '\t') s++;
+
+  const char* ev = s;
+  while (*s && *s != ' ' && *s != '\t' && *s != '\n' && *s != '\r') s++;
+  const char* ev_end = s;
+  while (ev_end > ev && ev_end[-1] == ':') ev_end--;
+  if (ev_end == ev) return false;
+  event->assign(ev, ev_end);
+
+  while (*s == ' ' || *s == '\t') s++;
+  char* hex_end = nullptr;
+  errno = 0;
+  const unsigned long long a = std::strtoull(s, &hex_end, 16);
+  if (hex_end == s || errno != 0) return false;
+  while (*hex_end == ' ' || *hex_end == '\t' || *hex_end == '\n' || *hex_end == '\r') hex_end++;
+  if (*hex_end != '\0') return false;
+  *addr = static_cast<uint64_t>(a);
+  return true;
+}
+
+// Format a sample as a points.txt line (microsecond time, like perf script).
+inline int format_points_line(char* buf, size_t n, uint64_t time_ns, const std::string& event, uint64_t addr) {
+  const uint64_t sec = time_ns / 1000000000u;
+  const uint64_t usec = (time_ns % 1000000000u) / 1000u;
+  return std::snprintf(buf, n, "%" PRIu64 ".%06" PRIu64 ": %s: %" PRIx64 "\n", sec, usec, event.c_str(), addr);
+}
+
+// ---- Writer ---------------------------------------------------------------
+
+class Writer {
+ public:
+  Writer() = default;
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+  ~Writer() { close(); }
+
+  bool open(const std::string& path, const std::vector<std::string>& events, uint32_t flags,
+            uint64_t sample_period = 0) {
+    f_ = std::fopen(path.c_str(), "wb");
+    if (!f_) {
+      error_ = "open " + path + ": " + std::strerror(errno);
+      return false;
+    }
+    flags_ = flags;
+    sample_period_ = sample_period;
+    size_t need = 0;
+    for (const auto& e : events) need += sizeof(uint16_t) + e.size();
+    table_bytes_ = static_cast<uint32_t>(std::max<size_t>(kMinTableBytes, need * 2));
+    for (const auto& e : events) {
+      if (add_event(e) < 0) return false;
+    }
+    if (!write_header()) return false;
+    pending_.reserve(kBlockSamples);
+    return true;
+  }
+
+  // Register an event name (or look it up). Returns its index, or -1 if the
+  // table is full. Safe to call while streaming; the table is rewritten on close.
+  int add_event(const std::string& name) {
+    for (size_t i = 0; i < events_.size(); i++) {
+      if (events_[i] == name) return static_cast<int>(i);
+    }
+    size_t used = 0;
+    for (const auto& e : events_) used += sizeof(uint16_t) + e.size();
+    if (events_.size() >= kMaxEvents || name.size() > 0xffff ||
+        used + sizeof(uint16_t) + name.size() > table_bytes_) {
+      error_ = "event table full";
+      return -1;
+    }
+    events_.push_back(name);
+    table_dirty_ = true;
+    return static_cast<int>(events_.size() - 1);
+  }
+
+  bool append(const Sample& s) {
+    pending_.push_back(s);
+    if (pending_.size() >= kBlockSamples) return flush();
+    return true;
+  }
+
+  // Encode and write the pending samples as one block.
+  bool flush() {
+    if (!f_ || pending_.empty()) return f_ != nullptr;
+    for (auto& c : cols_) c.clear();
+
+    // perf script text only has microsecond resolution; store those blocks in
+    // microsecond units so the time column stays at 1-2 bytes per sample.
+    uint32_t unit = 1000;
+    for (const Sample& s : pending_) {
+      if (s.time_ns % 1000 != 0) {
+        unit = 1;
+        break;
+      }
+    }
+
+    Sample prev;
+    for (const Sample& s : pending_) {
+      put_varint(&cols_[kTime], zigzag(static_cast<int64_t>(s.time_ns / unit - prev.time_ns / unit)));
+      cols_[kEvent].push_back(s.event);
+      put_varint(&cols_[kAddr], zigzag(static_cast<int64_t>(s.addr - prev.addr)));
+      if (flags_ & kHasPhys) {
+        put_varint(&cols_[kPhys], zigzag(static_cast<int64_t>(s.phys_addr - prev.phys_addr)));
+      }
+      if (flags_ & kHasPidTid) {
+        put_varint(&cols_[kPid], zigzag(static_cast<int64_t>(s.pid) - static_cast<int64_t>(prev.pid)));
+        put_varint(&cols_[kTid], zigzag(static_cast<int64_t>(s.tid) - static_cast<int64_t>(prev.tid)));
+      }
+      prev = s;
+    }
+
+    BlockHeader bh{};
+    bh.magic = kBlockMagic;
+    bh.count = static_cast<uint32_t>(pending_.size());
+    bh.time_unit_ns = unit;
+    for (int c = 0; c < kNumColumns; c++) bh.col_bytes[c] = static_cast<uint32_t>(cols_[c].size());
+    bool ok = write(&bh, sizeof(bh));
+    for (int c = 0; c < kNumColumns && ok; c++) ok = write(cols_[c].data(), cols_[c].size());
+    samples_ += pending_.size();
+    pending_.clear();
+    return ok;
+  }
+
+  bool close() {
+    if (!f_) return true;
+    bool ok = flush();
+    if (ok && table_dirty_) {
+      ok = std::fseek(f_, 0, SEEK_SET) == 0 && write_header();
+    }
+    const bool closed = (std::fclose(f_) == 0);
+    f_ = nullptr;
+    return ok && closed;
+  }
+
+  uint64_t samples() const { return samples_ + pending_.size(); }
+  const std::vector<std::string>& events() const { return events_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  bool write_header() {
+    FileHeader hdr{};
+    std::memcpy(hdr.magic, kFileMagic, sizeof(kFileMagic));
+    hdr.version = kVersion;
+    hdr.flags = flags_;
+    hdr.n_events = static_cast<uint32_t>(events_.size());
+    hdr.table_bytes = table_bytes_;
+    hdr.sample_period = sample_period_;
+    std::vector<uint8_t> table;
+    table.reserve(table_bytes_);
+    for (const auto& e : events_) {
+      const uint16_t len = static_cast<uint16_t>(e.size());
+      table.push_back(static_cast<uint8_t>(len & 0xff));
+      table.push_back(static_cast<uint8_t>(len >> 8));
+      table.insert(table.end(), e.begin(), e.end());
+    }
+    table.resize(table_bytes_, 0);
+    table_dirty_ = false;
+    return write(&hdr, sizeof(hdr)) && write(table.data(), table.size());
+  }
+
+  bool write(const void* p, size_t n) {
+    if (n == 0) return true;
+    if (std::fwrite(p, 1, n, f_) != n) {
+      error_ = std::string("write failed: ") + std::strerror(errno);
+      return false;
+    }
+    return true;
+  }
+
+  FILE* f_ = nullptr;
+  uint32_t flags_ = 0;
+  uint32_t table_bytes_ = 0;
+  uint64_t sample_period_ = 0;
+  bool table_dirty_ = false;
+  std::vector<std::string> events_;
+  uint64_t samples_ = 0;
+  std::vector<Sample> pending_;
+  std::vector<uint8_t> cols_[kNumColumns];
+  std::string error_;
+};
+
+// ---- Reader ---------------------------------------------------------------
+
+class Reader {
+ public:
+  Reader() = default;
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+  ~Reader() { close(); }
+
+  // True if `path` starts with the sample-file magic.
+  static bool is_sample_file(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    char m[sizeof(kFileMagic)];
+    const bool ok = std::fread(m, sizeof(m), 1, f) == 1 && std::memcmp(m, kFileMagic, sizeof(m)) == 0;
+    std::fclose(f);
+    return ok;
+  }
+
+  bool open(const std::string& path) {
+    f_ = std::fopen(path.c_str(), "rb");
+    if (!f_) {
+      error_ = "open " + path + ": " + std::strerror(errno);
+      return false;
+    }
+    if (std::fread(&hdr_, sizeof(hdr_), 1, f_) != 1 ||
+        std::memcmp(hdr_.magic, kFileMagic, sizeof(kFileMagic)) != 0) {
+      error_ = path + ": not a sample file";
+      return false;
+    }
+    if (hdr_.version != kVersion) {
+      error_ = path + ": unsupported sample file version " + std::to_string(hdr_.version);
+      return false;
+    }
+    std::vector<uint8_t> table(hdr_.table_bytes);
+    if (!table.empty() && std::fread(table.data(), table.size(), 1, f_) != 1) {
+      error_ = path + ": truncated event table";
+      return false;
+    }
+    size_t off = 0;
+    events_.clear();
+    for (uint32_t i = 0; i < hdr_.n_events; i++) {
+      if (off + sizeof(uint16_t) > table.size()) {
+        error_ = path + ": corrupt event table";
+        return false;
+      }
+      const size_t len = table[off] | (static_cast<size_t>(table[off + 1]) << 8);
+      off += sizeof(uint16_t);
+      if (off + len > table.size()) {
+        error_ = path + ": corrupt event table";
+        return false;
+      }
+      events_.emplace_back(reinterpret_cast<const char*>(&table[off]), len);
+      off += len;
+    }
+    return true;
+  }
+
+  // Decode the next block. Returns false at EOF or on error (check error()).
+  bool next(Block* b) {
+    if (!next_raw(&raw_)) return false;
+    if (decode(raw_, b)) return true;
+    error_ = "corrupt column data";
+    return false;
+  }
+
+  // Read the next block without decoding it. Lets callers do the file I/O under
+  // a lock and decode on worker threads (see for_each_block).
+  bool next_raw(RawBlock* rb) {
+    if (!f_ || std::fread(&rb->hdr, sizeof(rb->hdr), 1, f_) != 1) return false;
+    if (rb->hdr.magic != kBlockMagic) {
+      error_ = "corrupt block header";
+      return false;
+    }
+    size_t total = 0;
+    for (int c = 0; c < kNumColumns; c++) total += rb->hdr.col_bytes[c];
+    rb->payload.resize(total);
+    if (total && std::fread(rb->payload.data(), total, 1, f_) != 1) {
+      error_ = "truncated block";
+      return false;
+    }
+    return true;
+  }
+
+  // Thread-safe as long as each thread passes its own RawBlock/Block.
+  bool decode(const RawBlock& rb, Block* b) const {
+    const BlockHeader& bh = rb.hdr;
+    const uint8_t* p = rb.payload.data();
+    const uint8_t* col[kNumColumns + 1];
+    for (int c = 0; c < kNumColumns; c++) {
+      col[c] = p;
+      p += bh.col_bytes[c];
+    }
+    col[kNumColumns] = p;
+
+    bool ok = decode_delta_column(col[kTime], col[kTime + 1], bh.count, &b->time_ns);
+    if (ok && bh.time_unit_ns > 1) {
+      for (auto& t : b->time_ns) t *= bh.time_unit_ns;
+    }
+    b->event.assign(col[kEvent], col[kEvent + 1]);
+    ok = ok && b->event.size() == bh.count;
+    ok = ok && decode_delta_column(col[kAddr], col[kAddr + 1], bh.count, &b->addr);
+    if (hdr_.flags & kHasPhys) {
+      ok = ok && decode_delta_column(col[kPhys], col[kPhys + 1], bh.count, &b->phys_addr);
+    } else {
+      b->phys_addr.clear();
+    }
+    if (hdr_.flags & kHasPidTid) {
+      ok = ok && decode_delta_column(col[kPid], col[kPid + 1], bh.count, &b->pid);
+      ok = ok && decode_delta_column(col[kTid], col[kTid + 1], bh.count, &b->tid);
+    } else {
+      b->pid.clear();
+      b->tid.clear();
+    }
+    return ok;
+  }
+
+  void close() {
+    if (f_) std::fclose(f_);
+    f_ = nullptr;
+  }
+
+  // Index of `name` in the event table, or -1.
+  int event_index(const std::string& name) const {
+    for (size_t i = 0; i < events_.size(); i++) {
+      if (events_[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+  }
+
+  const FileHeader& header() const { return hdr_; }
+  const std::vector<std::string>& events() const { return events_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  FILE* f_ = nullptr;
+  FileHeader hdr_{};
+  std::vector<std::string> events_;
+  RawBlock raw_;
+  std::string error_;
+};
+
+// ---- Source: binary sample file or points.txt ----------------------------
+
+// Uniform block reader for tools that accept either format. Text input ("-" is
+// stdin) is parsed into the same Block layout; event names are assigned indices
+// in first-seen order.
+class Source {
+ public:
+  bool open(const std::string& path) {
+    if (path != "-" && Reader::is_sample_file(path)) {
+      binary_ = true;
+      if (!reader_.open(path)) {
+        error_ = reader_.error();
+        return false;
+      }
+      events_ = reader_.events();
+      return true;
+    }
+    binary_ = false;
+    text_ = (path == "-") ? stdin : std::fopen(path.c_str(), "r");
+    if (!text_) {
+      error_ = "open " + path + ": " + std::strerror(errno);
+      return false;
+    }
+    owns_text_ = (text_ != stdin);
+    return true;
+  }
+
+  ~Source() {
+    if (owns_text_ && text_) std::fclose(text_);
+    std::free(line_);
+  }
+
+  bool next(Block* b) {
+    if (binary_) {
+      if (!reader_.next_raw(&raw_)) {
+        error_ = reader_.error();
+        return false;
+      }
+      if (decode(raw_, b)) return true;
+      error_ = "corrupt column data";
+      return false;
+    }
+    b->time_ns.clear();
+    b->event.clear();
+    b->addr.clear();
+    b->phys_addr.clear();
+    b->pid.clear();
+    b->tid.clear();
+    if (!text_) return false;
+
+    uint64_t t = 0;
+    uint64_t a = 0;
+    std::string ev;
+    ssize_t n;
+    while (b->size() < kBlockSamples && (n = getline(&line_, &line_cap_, text_)) >= 0) {
+      if (!parse_points_line(line_, &t, &ev, &a)) continue;
+      int idx = event_index(ev);
+      if (idx < 0) {
+        if (events_.size() >= kMaxEvents) continue;
+        events_.push_back(ev);
+        idx = static_cast<int>(events_.size() - 1);
+      }
+      b->time_ns.push_back(t);
+      b->event.push_back(static_cast<uint8_t>(idx));
+      b->addr.push_back(a);
+    }
+    return b->size() > 0;
+  }
+
+  // Binary input only: split read and decode (see for_each_block).
+  bool next_raw(RawBlock* rb) {
+    if (reader_.next_raw(rb)) return true;
+    error_ = reader_.error();
+    return false;
+  }
+  bool decode(const RawBlock& rb, Block* b) const { return reader_.decode(rb, b); }
+
+  int event_index(const std::string& name) const {
+    for (size_t i = 0; i < events_.size(); i++) {
+      if (events_[i] == name) return static_cast<int>(i);
+    }
+    return -1;
+  }
+
+  // Pin an event index before reading. Text input assigns indices as names
+  // appear, so workers must not call event_index() while blocks are flowing;
+  // resolve the events you filter on up front instead. Returns -1 for a binary
+  // file without that event (or a full text table).
+  int intern_event(const std::string& name) {
+    int idx = event_index(name);
+    if (idx >= 0 || binary_ || events_.size() >= kMaxEvents) return idx;
+    events_.push_back(name);
+    return static_cast<int>(events_.size() - 1);
+  }
+
+  bool binary() const { return binary_; }
+  // Mirrors `perf script -F phys_addr`: files that carry phys_addr plot it.
+  bool has_phys() const { return binary_ && (reader_.header().flags & kHasPhys) != 0; }
+  const std::vector<std::string>& events() const { return events_; }
+  const std::string& error() const { return error_; }
+
+ private:
+  bool binary_ = false;
+  Reader reader_;
+  RawBlock raw_;
+  FILE* text_ = nullptr;
+  bool owns_text_ = false;
+  char* line_ = nullptr;
+  size_t line_cap_ = 0;
+  std::vector<std::string> events_;
+  std::string error_;
+};
+
+// ---- parallel block pump --------------------------------------------------
+
+// Feed every block of `src` to fn(worker, seq, block) from `threads` workers.
+// `seq` is the block's position in the file, so callers can recover file order
+// (e.g. "first sample seen"). Binary input is read under a lock and decoded on
+// the workers; text input is parsed under the lock. Returns false if a block
+// failed to decode or the source reported an error.
+template <typename F>
+bool for_each_block(Source* src, int threads, F&& fn) {
+  std::mutex mu;
+  uint64_t next_seq = 0;
+  bool failed = false;
+
+  auto work = [&](int worker) {
+    RawBlock raw;
+    Block b;
+    while (true) {
+      uint64_t seq;
+      {
+        std::lock_guard<std::mutex> lk(mu);
+        if (failed) return;
+        const bool got = src->binary() ? src->next_raw(&raw) : src->next(&b);
+        if (!got) return;
+        seq = next_seq++;
+      }
+      if (src->binary() && !src->decode(raw, &b)) {
+        std::lock_guard<std::mutex> lk(mu);
+        failed = true;
+        return;
+      }
+      fn(worker, seq, static_cast<const Block&>(b));
+    }
+  };
+
+  threads = std::max(1, threads);
+  std::vector<std::thread> th;
+  th.reserve(static_cast<size_t>(threads - 1));
+  for (int t = 1; t < threads; t++) th.emplace_back(work, t);
+  work(0);
+  for (auto& x : th) x.join();
+  return !failed && src->error().empty();
+}
+
+}  // namespace sample_format
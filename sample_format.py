@@ -0,0 +1,257 @@
+#!/usr/bin/env python3
+"""
+Python reader for the compact columnar sample format (see sample_format.hpp).
+
+Files are written by pebs_sampler and points_convert. Layout (little endian):
+
+  FileHeader (32 bytes):
+    char     magic[8]      = b"WPSAMPL1"
+    uint32   version       = 1
+    uint32   flags         bit0: phys_addr column, bit1: pid/tid columns
+    uint32   n_events
+    uint32   table_bytes   size of the (zero padded) event table that follows
+    uint64   sample_period 0 if unknown
+  event table: n_events x { uint16 len; char name[len] }, padded to table_bytes
+  blocks until EOF:
+    BlockHeader (36 bytes): uint32 magic ("SBLK"), count, time_unit_ns,
+                            col_bytes[6] for columns time, event, addr, phys, pid, tid
+    column payloads in that order. event is one uint8 per sample; every other
+    column is zigzag LEB128 of the delta vs the previous sample in the block
+    (time in units of time_unit_ns).
+
+With numpy installed blocks decode vectorized; otherwise a pure-Python path is
+used (correct, just slower).
+
+Usage from the plotting scripts:
+
+  import sample_format
+  if sample_format.is_sample_file(path):
+      for t_sec, event, addr in sample_format.iter_points(path):
+          ...
+
+iter_points yields one tuple per sample, which costs as much Python work as
+parsing the text. With numpy, iter_columns yields each block as arrays
+instead, so filters and histograms can run vectorized:
+
+  for t_sec, ev, addr in sample_format.iter_columns(path, events=["cpu/mem-loads/pp"]):
+      keep = addr != 0
+      ...
+"""
+
+from __future__ import annotations
+
+import struct
+import sys
+from pathlib import Path
+from typing import BinaryIO, Iterator, Sequence
+
+try:
+    import numpy as np
+except ImportError:  # pragma: no cover - numpy is optional
+    np = None
+
+HAVE_NUMPY = np is not None
+
+MAGIC = b"WPSAMPL1"
+BLOCK_MAGIC = 0x4B4C4253
+VERSION = 1
+
+FLAG_PHYS = 1 << 0
+FLAG_PID_TID = 1 << 1
+
+COLUMNS = ("time", "event", "addr", "phys", "pid", "tid")
+
+_FILE_HDR = struct.Struct("<8sIIIIQ")
+_BLOCK_HDR = struct.Struct("<III6I")
+
+
+def is_sample_file(path: str | Path) -> bool:
+    try:
+        with open(path, "rb") as f:
+            return f.read(len(MAGIC)) == MAGIC
+    except OSError:
+        return False
+
+
+def _decode_delta_py(buf: bytes, count: int) -> list[int]:
+    out: list[int] = []
+    prev = 0
+    v = 0
+    shift = 0
+    for b in buf:
+        v |= (b & 0x7F) << shift
+        if b & 0x80:
+            shift += 7
+            continue
+        prev = (prev + ((v >> 1) ^ -(v & 1))) & 0xFFFF_FFFF_FFFF_FFFF
+        out.append(prev)
+        v = 0
+        shift = 0
+    if len(out) != count:
+        raise ValueError("corrupt column data")
+    return out
+
+
+def _decode_delta_np(buf: bytes, count: int):
+    a = np.frombuffer(buf, dtype=np.uint8)
+    if count == 0:
+        return np.zeros(0, dtype=np.uint64)
+    ends = np.flatnonzero(a < 0x80)
+    if ends.size != count or ends[-1] != a.size - 1:
+        raise ValueError("corrupt column data")
+    starts = np.empty_like(ends)
+    starts[0] = 0
+    starts[1:] = ends[:-1] + 1
+    # Byte position inside its varint -> shift; groups never overlap bits, so sum == or.
+    pos = np.arange(a.size, dtype=np.int64) - np.repeat(starts, ends - starts + 1)
+    vals = (a & 0x7F).astype(np.uint64) << (7 * pos).astype(np.uint64)
+    z = np.add.reduceat(vals, starts)
+    delta = (z >> np.uint64(1)).view(np.int64) ^ -(z & np.uint64(1)).view(np.int64)
+    return np.cumsum(delta).view(np.uint64)
+
+
+class SampleFile:
+    """Sequential block reader. Columns come back as numpy arrays when numpy is
+    available, plain lists otherwise. Disabled columns are None."""
+
+    def __init__(self, path: str | Path | BinaryIO):
+        if hasattr(path, "read"):
+            self.path = Path(getattr(path, "name", "<stream>"))
+            self._f: BinaryIO = path  # type: ignore[assignment]
+        else:
+            self.path = Path(path)
+            self._f = open(self.path, "rb")
+        hdr = self._f.read(_FILE_HDR.size)
+        if len(hdr) != _FILE_HDR.size:
+            raise ValueError(f"{self.path}: truncated header")
+        magic, version, flags, n_events, table_bytes, period = _FILE_HDR.unpack(hdr)
+        if magic != MAGIC:
+            raise ValueError(f"{self.path}: not a sample file")
+        if version != VERSION:
+            raise ValueError(f"{self.path}: unsupported sample file version {version}")
+        self.flags = flags
+        self.sample_period = period
+        table = self._f.read(table_bytes)
+        self.events: list[str] = []
+        off = 0
+        for _ in range(n_events):
+            (ln,) = struct.unpack_from("<H", table, off)
+            off += 2
+            self.events.append(table[off : off + ln].decode("utf-8", "replace"))
+            off += ln
+
+    def close(self) -> None:
+        self._f.close()
+
+    def __enter__(self) -> "SampleFile":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def blocks(self, use_numpy: bool = True) -> Iterator[dict]:
+        vec = use_numpy and np is not None
+        decode = _decode_delta_np if vec else _decode_delta_py
+        while True:
+            hdr = self._f.read(_BLOCK_HDR.size)
+            if not hdr:
+                return
+            if len(hdr) != _BLOCK_HDR.size:
+                raise ValueError(f"{self.path}: truncated block header")
+            magic, count, unit, *col_bytes = _BLOCK_HDR.unpack(hdr)
+            if magic != BLOCK_MAGIC:
+                raise ValueError(f"{self.path}: corrupt block header")
+            payload = self._f.read(sum(col_bytes))
+            if len(payload) != sum(col_bytes):
+                raise ValueError(f"{self.path}: truncated block")
+            cols: dict = {}
+            off = 0
+            for name, nbytes in zip(COLUMNS, col_bytes):
+                raw = payload[off : off + nbytes]
+                off += nbytes
+                if nbytes == 0 and count > 0:
+                    cols[name] = None
+                elif name == "event":
+                    cols[name] = np.frombuffer(raw, dtype=np.uint8) if vec else list(raw)
+                else:
+                    cols[name] = decode(raw, count)
+            if unit > 1 and cols["time"] is not None:
+                if vec:
+                    cols["time"] = cols["time"] * np.uint64(unit)
+                else:
+                    cols["time"] = [t * unit for t in cols["time"]]
+            cols["count"] = count
+            yield cols
+
+
+def iter_points(path: str | Path | BinaryIO, use_phys: bool | None = None) -> Iterator[tuple[float, str, int]]:
+    """Yield (time_sec, event_name, addr) like a parsed points.txt line.
+
+    use_phys=None picks phys_addr when the file carries it (mirrors
+    `perf script -F time,event,phys_addr`)."""
+    with SampleFile(path) as sf:
+        phys = bool(sf.flags & FLAG_PHYS) if use_phys is None else use_phys
+        names = sf.events
+        for blk in sf.blocks():
+            addrs = blk["phys"] if phys else blk["addr"]
+            times, evs = blk["time"], blk["event"]
+            if np is not None:
+                times, evs, addrs = times.tolist(), evs.tolist(), addrs.tolist()
+            for t, e, a in zip(times, evs, addrs):
+                yield t / 1e9, names[e] if e < len(names) else "unknown", a
+
+
+def iter_columns(
+    path: str | Path | BinaryIO, events: Sequence[str] | None = None, use_phys: bool | None = None
+) -> Iterator[tuple]:
+    """Yield (time_sec, event, addr) numpy arrays, one tuple per block.
+
+    time_sec is float64 seconds (the same values iter_points yields) and addr
+    is uint64, phys_addr when picked as in iter_points. With `events`, only
+    samples of those events are kept and `event` holds each sample's index
+    into `events`; otherwise it is the index into SampleFile.events. Blocks
+    left empty by the filter are skipped. Needs numpy (see HAVE_NUMPY)."""
+    if np is None:
+        raise RuntimeError("sample_format.iter_columns needs numpy")
+    with SampleFile(path) as sf:
+        phys = bool(sf.flags & FLAG_PHYS) if use_phys is None else use_phys
+        remap = None
+        if events is not None:
+            # File event index -> position in `events`; 255 drops the sample.
+            remap = np.full(256, 255, dtype=np.uint8)
+            for i, name in enumerate(sf.events[:256]):
+                if name in events:
+                    remap[i] = list(events).index(name)
+        for blk in sf.blocks():
+            if blk["count"] == 0:
+                continue
+            times = blk["time"].astype(np.float64) / 1e9
+            evs = blk["event"]
+            addrs = blk["phys"] if phys else blk["addr"]
+            if remap is not None:
+                evs = remap[evs]
+                keep = evs != 255
+                if not keep.all():
+                    times, evs, addrs = times[keep], evs[keep], addrs[keep]
+                if evs.size == 0:
+                    continue
+            yield times, evs, addrs
+
+
+def main() -> int:
+    # Tiny CLI for quick inspection: print header info and the first samples.
+    if len(sys.argv) < 2:
+        print(f"usage: {sys.argv[0]} <samples.bin> [n]", file=sys.stderr)
+        return 2
+    n = int(sys.argv[2]) if len(sys.argv) > 2 else 10
+    with SampleFile(sys.argv[1]) as sf:
+        print(f"events={sf.events} flags={sf.flags:#x} sample_period={sf.sample_period}")
+    for i, (t, ev, a) in enumerate(iter_points(sys.argv[1])):
+        if i >= n:
+            break
+        print(f"{t:.6f}: {ev}: {a:x}")
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
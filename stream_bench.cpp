@@ -2,8 +2,11 @@
 #include <atomic>
 #include <chrono>
 #include <cinttypes>
+#include <cstdio>
 #include <cstring>
+#include <ctime>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <thread>
 #include <vector>
@@ -13,10 +16,14 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
-namespace {
+#include "bench_memory.hpp"
+#include "bench_report.hpp"
 
-constexpr size_t kPageSize = 4096;
+namespace {
 
 enum class Op {
   kRead,   // sum += a[i]
@@ -25,6 +32,18 @@ enum class Op {
   kTriad,  // a[i] = b[i] + scalar * c[i]
 };
 
+enum class Simd {
+  kAuto,    // best the CPU supports
+  kScalar,  // plain loops (still auto-vectorized by the compiler)
+  kAvx2,
+  kAvx512,
+};
+
+enum class Store {
+  kRegular,  // normal cached stores (write-allocate)
+  kNt,       // streaming stores + sfence
+};
+
 enum class Pattern {
   kChunk,      // each thread gets a contiguous chunk [lo, hi)
   kInterleave  // thread t touches i = t, t+T, t+2T, ...
@@ -36,7 +55,7 @@ struct Config {
   int cpu_start = 0;   // if <0 => don't pin
   int duration_sec = 60;
   int warmup_sec = 0;
-  int passes_per_check = 1;     // how often we check the stop flag (in passes)
+  int passes_per_check = 1;     // how often we poll the stop flag and time passes (in passes)
   size_t phase_pages = 0;       // shift start index by phase_pages each pass (0 => disabled)
   // Visualization knobs (optional):
   // If window_pages > 0: each phase scans only a window inside the per-thread region,
@@ -48,19 +67,21 @@ struct Config {
   bool sync_phases = false;     // barrier after each phase
   Op op = Op::kTriad;
   Pattern pattern = Pattern::kChunk;
+  Simd simd = Simd::kAuto;
+  Store store = Store::kRegular;
+  size_t prefetch_lines = 0;    // software prefetch distance (0 => off)
+  std::string timeline;         // per-thread GB/s CSV ("" => off)
+  int timeline_interval_ms = 1000;
+  std::string json;             // JSON run summary ("" => off)
+  std::string ready_file;       // hot-loop start signal ("" => off)
   bool touch = true;
+  bench_memory::Populate populate = bench_memory::Populate::kSerial;
+  bench_memory::Backing page_backing = bench_memory::Backing::k4k;
+  bench_memory::NumaPolicy numa;
 };
 
 static std::atomic<uint64_t> g_sink{0};
 
-static void pin_to_cpu_if_needed(int cpu) {
-  if (cpu < 0) return;
-  cpu_set_t set;
-  CPU_ZERO(&set);
-  CPU_SET(cpu, &set);
-  (void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
-}
-
 static bool parse_flag(const char* arg, const char* name, const char** out_val) {
   const size_t n = std::strlen(name);
   if (std::strncmp(arg, name, n) != 0) return false;
@@ -86,7 +107,34 @@ static void usage(const char* argv0) {
       << "                           Use --cpu-start=-1 to disable pinning\n"
       << "  --pattern=chunk|interleave   Access pattern (default: chunk)\n"
       << "  --op=read|write|copy|triad   Operation (default: triad)\n"
+      << "  --simd=auto|scalar|avx2|avx512  Kernel instruction set (default: auto)\n"
+      << "  --store=regular|nt       Store kind for write/copy/triad (default: regular)\n"
+      << "                           nt: non-temporal streaming stores + sfence\n"
+      << "  --prefetch-distance=<L>  Software-prefetch sources L cache lines ahead (default: 0 = off)\n"
+      << "  --passes-per-check=<N>   Poll the stop flag (and read the clock) every N passes\n"
+      << "                           (default: 1)\n"
+      << "  --timeline=<file>        Per-thread bandwidth CSV every interval\n"
+      << "                           (time_sec,thread,interval_sec,read_bytes,write_bytes,gbps)\n"
+      << "  --timeline-interval-ms=<ms>  Timeline interval (default: 1000)\n"
+      << "  --json=<file>            Write a JSON summary (config, mapping, timestamps, bandwidth,\n"
+      << "                           per-thread stats) on exit\n"
+      << "  --ready-file=<path>      When the streaming loop starts, write \"ready pid= time_sec=\n"
+      << "                           addr_lo= addr_hi=\" to <path> (a FIFO, or a file created by rename)\n"
       << "  --touch=0|1              Touch pages before run to fault-in (default: 1)\n"
+      << "  --populate=MODE          How --touch faults pages in (default: serial)\n"
+      << "                           serial:        main thread touches every page\n"
+      << "                           parallel:      each pinned worker first-touches its chunk\n"
+      << "                           madv_populate: like parallel, via MADV_POPULATE_WRITE\n"
+      << "                           map_populate:  MAP_POPULATE at mmap time\n"
+      << "  --page-backing=4k|thp|huge2m|huge1g\n"
+      << "                           Page size of the mapping (default: 4k); the *-pages\n"
+      << "                           options count pages of this size\n"
+      << "                           thp: MADV_HUGEPAGE, huge2m/huge1g: MAP_HUGETLB\n"
+      << "  --numa=local|interleave[:N]|bind:N|split:R[:F,S]\n"
+      << "                           NUMA placement via mbind (default: local = first touch).\n"
+      << "                           split:0.2 binds the first 20% of the mapping (i.e. the\n"
+      << "                           front of array a) to fast node F and the rest to slow\n"
+      << "                           node S. N is a node list like 0,2-3\n"
       << "  --phase-pages=<P>        Per-pass start offset in pages (default: 0)\n"
       << "                           (0 disables phase shifting)\n"
       << "  --window-pages=<P>       If >0: scan only this many pages per phase (visualize scan)\n"
@@ -132,6 +180,27 @@ static bool parse_args(int argc, char** argv, Config* cfg) {
       cfg->touch = (std::stoi(v) != 0);
       continue;
     }
+    if (parse_flag(a, "--page-backing", &v) && v) {
+      if (!bench_memory::parse_backing(v, &cfg->page_backing)) {
+        std::cerr << "Unknown --page-backing: " << v << "\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--numa", &v) && v) {
+      if (!bench_memory::parse_numa(v, &cfg->numa)) {
+        std::cerr << "Unknown --numa: " << v << "\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--populate", &v) && v) {
+      if (!bench_memory::parse_populate(v, &cfg->populate)) {
+        std::cerr << "Unknown --populate: " << v << "\n";
+        return false;
+      }
+      continue;
+    }
     if (parse_flag(a, "--phase-pages", &v) && v) {
       cfg->phase_pages = std::stoull(v);
       continue;
@@ -161,6 +230,58 @@ static bool parse_args(int argc, char** argv, Config* cfg) {
       }
       continue;
     }
+    if (parse_flag(a, "--simd", &v) && v) {
+      if (std::strcmp(v, "auto") == 0) cfg->simd = Simd::kAuto;
+      else if (std::strcmp(v, "scalar") == 0) cfg->simd = Simd::kScalar;
+      else if (std::strcmp(v, "avx2") == 0) cfg->simd = Simd::kAvx2;
+      else if (std::strcmp(v, "avx512") == 0) cfg->simd = Simd::kAvx512;
+      else {
+        std::cerr << "Unknown --simd: " << v << "\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--store", &v) && v) {
+      if (std::strcmp(v, "regular") == 0) cfg->store = Store::kRegular;
+      else if (std::strcmp(v, "nt") == 0) cfg->store = Store::kNt;
+      else {
+        std::cerr << "Unknown --store: " << v << "\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--prefetch-distance", &v) && v) {
+      cfg->prefetch_lines = std::stoull(v);
+      continue;
+    }
+    if (parse_flag(a, "--passes-per-check", &v) && v) {
+      cfg->passes_per_check = std::stoi(v);
+      if (cfg->passes_per_check < 1) {
+        std::cerr << "--passes-per-check must be >= 1\n";
+        return false;
+      }
+      continue;
+    }
+    if (parse_flag(a, "--json", &v) && v) {
+      cfg->json = v;
+      continue;
+    }
+    if (parse_flag(a, "--ready-file", &v) && v) {
+      cfg->ready_file = v;
+      continue;
+    }
+    if (parse_flag(a, "--timeline", &v) && v) {
+      cfg->timeline = v;
+      continue;
+    }
+    if (parse_flag(a, "--timeline-interval-ms", &v) && v) {
+      cfg->timeline_interval_ms = std::stoi(v);
+      if (cfg->timeline_interval_ms <= 0) {
+        std::cerr << "--timeline-interval-ms must be > 0\n";
+        return false;
+      }
+      continue;
+    }
     if (parse_flag(a, "--op", &v) && v) {
       if (std::strcmp(v, "read") == 0) cfg->op = Op::kRead;
       else if (std::strcmp(v, "write") == 0) cfg->op = Op::kWrite;
@@ -184,6 +305,519 @@ static inline void compiler_fence() {
   asm volatile("" ::: "memory");
 }
 
+// ---- Kernels ---------------------------------------------------------------
+//
+// Each Op is a separate template instantiation, so the inner loops carry no
+// per-element branch and the scalar versions vectorize. Store kernels do not
+// fold their values into the sink (stores are side effects already), which
+// keeps them free of loop-carried dependencies, as in STREAM.
+//
+// kNt selects streaming (non-temporal) stores, which bypass the cache and
+// skip the read-for-ownership of the destination line; each kernel call ends
+// with an sfence. `pf` > 0 prefetches the source arrays that many elements
+// ahead (--prefetch-distance is in cache lines).
+
+constexpr uint32_t kScalar = 3;  // triad multiplier (fits the 32x64 multiply below)
+constexpr size_t kLineElems = 64 / sizeof(uint64_t);
+
+// Bytes per element the kernel names: read sums a, write stores a, copy
+// reads a and stores b, triad reads b and c and stores a. This is STREAM's
+// counting; regular (non-nt) stores also read each destination line first
+// (write-allocate), which write_alloc_bytes() adds when asked.
+constexpr size_t read_bytes_per_elem(Op op) {
+  return sizeof(uint64_t) * ((op == Op::kTriad) ? 2 : (op == Op::kWrite) ? 0 : 1);
+}
+constexpr size_t write_bytes_per_elem(Op op) {
+  return sizeof(uint64_t) * ((op == Op::kRead) ? 0 : 1);
+}
+constexpr size_t stream_bytes_per_elem(Op op) { return read_bytes_per_elem(op) + write_bytes_per_elem(op); }
+
+struct Arrays {
+  uint64_t* a;
+  uint64_t* b;
+  uint64_t* c;
+  size_t n;  // elements per array
+};
+
+template <bool kNt>
+static inline void put64(uint64_t* p, uint64_t v) {
+#if defined(__x86_64__)
+  if (kNt) {
+    _mm_stream_si64(reinterpret_cast<long long*>(p), static_cast<long long>(v));
+    return;
+  }
+#endif
+  *p = v;
+}
+
+static inline void store_fence() {
+#if defined(__x86_64__)
+  _mm_sfence();
+#endif
+}
+
+// Prefetch the op's source arrays at element i.
+template <Op kOp>
+static inline void prefetch_sources(const Arrays& x, size_t i) {
+#if defined(__x86_64__)
+  if (kOp == Op::kRead || kOp == Op::kCopy) _mm_prefetch(reinterpret_cast<const char*>(x.a + i), _MM_HINT_T0);
+  if (kOp == Op::kTriad) {
+    _mm_prefetch(reinterpret_cast<const char*>(x.b + i), _MM_HINT_T0);
+    _mm_prefetch(reinterpret_cast<const char*>(x.c + i), _MM_HINT_T0);
+  }
+#else
+  (void)x;
+  (void)i;
+#endif
+}
+
+// One element of the op; returns the value to add to the sink (reads only).
+template <Op kOp, bool kNt>
+static inline uint64_t elem(uint64_t* __restrict a, uint64_t* __restrict b, const uint64_t* __restrict c, size_t i) {
+  if (kOp == Op::kRead) return a[i];
+  if (kOp == Op::kWrite) put64<kNt>(a + i, static_cast<uint64_t>(i));
+  if (kOp == Op::kCopy) put64<kNt>(b + i, a[i]);
+  if (kOp == Op::kTriad) put64<kNt>(a + i, b[i] + kScalar * c[i]);
+  return 0;
+}
+
+template <Op kOp, bool kNt>
+static uint64_t kernel_scalar(const Arrays& x, size_t lo, size_t hi, size_t pf) {
+  uint64_t* __restrict a = x.a;
+  uint64_t* __restrict b = x.b;
+  const uint64_t* __restrict c = x.c;
+  uint64_t sum = 0;
+  if (pf == 0) {
+    for (size_t i = lo; i < hi; i++) sum += elem<kOp, kNt>(a, b, c, i);
+  } else {
+    // One prefetch per cache line of each source.
+    for (size_t i0 = lo; i0 < hi; i0 += kLineElems) {
+      prefetch_sources<kOp>(x, i0 + pf);
+      const size_t e = std::min(hi, i0 + kLineElems);
+      for (size_t i = i0; i < e; i++) sum += elem<kOp, kNt>(a, b, c, i);
+    }
+  }
+  if (kNt) store_fence();
+  return sum;
+}
+
+static const char* op_name(Op op) {
+  switch (op) {
+    case Op::kRead: return "read";
+    case Op::kWrite: return "write";
+    case Op::kCopy: return "copy";
+    case Op::kTriad: return "triad";
+  }
+  return "?";
+}
+
+static const char* simd_name(Simd s) {
+  switch (s) {
+    case Simd::kAuto: return "auto";
+    case Simd::kScalar: return "scalar";
+    case Simd::kAvx2: return "avx2";
+    case Simd::kAvx512: return "avx512";
+  }
+  return "?";
+}
+
+#if defined(__x86_64__)
+// First index >= lo (capped at hi) where the destination is `align`-byte
+// aligned, as streaming vector stores require.
+template <Op kOp>
+static inline size_t aligned_start(const Arrays& x, size_t lo, size_t hi, size_t align) {
+  const uint64_t* dst = (kOp == Op::kCopy) ? x.b : x.a;
+  const size_t mis = (reinterpret_cast<uintptr_t>(dst + lo) & (align - 1)) / sizeof(uint64_t);
+  const size_t skip = mis ? align / sizeof(uint64_t) - mis : 0;
+  return std::min(hi, lo + skip);
+}
+
+// Aligned vector store, streaming when kNt.
+template <bool kNt>
+__attribute__((target("avx2"))) static inline void put256(uint64_t* p, __m256i v) {
+  if (kNt) _mm256_stream_si256(reinterpret_cast<__m256i*>(p), v);
+  else _mm256_store_si256(reinterpret_cast<__m256i*>(p), v);
+}
+
+template <bool kNt>
+__attribute__((target("avx512f"))) static inline void put512(uint64_t* p, __m512i v) {
+  if (kNt) _mm512_stream_si512(reinterpret_cast<__m512i*>(p), v);
+  else _mm512_store_si512(p, v);
+}
+
+// AVX2 has no 64-bit multiply; c * kScalar = lo32(c) * s + (hi32(c) * s) << 32.
+template <Op kOp, bool kNt>
+__attribute__((target("avx2"))) static uint64_t kernel_avx2(const Arrays& x, size_t lo, size_t hi, size_t pf) {
+  const size_t vlo = aligned_start<kOp>(x, lo, hi, 32);
+  const size_t vhi = vlo + ((hi - vlo) & ~size_t{3});
+  uint64_t sum = kernel_scalar<kOp, kNt>(x, lo, vlo, 0) + kernel_scalar<kOp, kNt>(x, vhi, hi, 0);
+  const __m256i s = _mm256_set1_epi64x(kScalar);
+  __m256i idx = _mm256_add_epi64(_mm256_set1_epi64x(static_cast<long long>(vlo)), _mm256_set_epi64x(3, 2, 1, 0));
+  const __m256i step = _mm256_set1_epi64x(4);
+  __m256i acc0 = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+  size_t i = vlo;
+  if (kOp == Op::kRead) {
+    for (; i + 8 <= vhi; i += 8) {
+      if (pf) prefetch_sources<kOp>(x, i + pf);
+      acc0 = _mm256_add_epi64(acc0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.a + i)));
+      acc1 = _mm256_add_epi64(acc1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.a + i + 4)));
+    }
+  }
+  for (; i < vhi; i += 4) {
+    if (pf && (i & (kLineElems - 1)) < 4) prefetch_sources<kOp>(x, i + pf);
+    if (kOp == Op::kRead) {
+      acc0 = _mm256_add_epi64(acc0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.a + i)));
+    }
+    if (kOp == Op::kWrite) {
+      put256<kNt>(x.a + i, idx);
+      idx = _mm256_add_epi64(idx, step);
+    }
+    if (kOp == Op::kCopy) put256<kNt>(x.b + i, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.a + i)));
+    if (kOp == Op::kTriad) {
+      const __m256i cv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.c + i));
+      const __m256i bv = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x.b + i));
+      const __m256i m = _mm256_add_epi64(_mm256_mul_epu32(cv, s),
+                                         _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(cv, 32), s), 32));
+      put256<kNt>(x.a + i, _mm256_add_epi64(bv, m));
+    }
+  }
+  if (kNt) store_fence();
+  if (kOp == Op::kRead) {
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(acc0, acc1));
+    sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+  return sum;
+}
+
+template <Op kOp, bool kNt>
+__attribute__((target("avx512f"))) static uint64_t kernel_avx512(const Arrays& x, size_t lo, size_t hi, size_t pf) {
+  const size_t vlo = aligned_start<kOp>(x, lo, hi, 64);
+  const size_t vhi = vlo + ((hi - vlo) & ~size_t{7});
+  uint64_t sum = kernel_scalar<kOp, kNt>(x, lo, vlo, 0) + kernel_scalar<kOp, kNt>(x, vhi, hi, 0);
+  const __m512i s = _mm512_set1_epi64(kScalar);
+  __m512i idx = _mm512_add_epi64(_mm512_set1_epi64(static_cast<long long>(vlo)),
+                                 _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0));
+  const __m512i step = _mm512_set1_epi64(8);
+  __m512i acc0 = _mm512_setzero_si512();
+  __m512i acc1 = _mm512_setzero_si512();
+  size_t i = vlo;
+  if (kOp == Op::kRead) {
+    for (; i + 16 <= vhi; i += 16) {
+      if (pf) {
+        prefetch_sources<kOp>(x, i + pf);
+        prefetch_sources<kOp>(x, i + pf + 8);
+      }
+      acc0 = _mm512_add_epi64(acc0, _mm512_loadu_si512(x.a + i));
+      acc1 = _mm512_add_epi64(acc1, _mm512_loadu_si512(x.a + i + 8));
+    }
+  }
+  for (; i < vhi; i += 8) {
+    if (pf) prefetch_sources<kOp>(x, i + pf);
+    if (kOp == Op::kRead) acc0 = _mm512_add_epi64(acc0, _mm512_loadu_si512(x.a + i));
+    if (kOp == Op::kWrite) {
+      put512<kNt>(x.a + i, idx);
+      idx = _mm512_add_epi64(idx, step);
+    }
+    if (kOp == Op::kCopy) put512<kNt>(x.b + i, _mm512_loadu_si512(x.a + i));
+    if (kOp == Op::kTriad) {
+      const __m512i cv = _mm512_loadu_si512(x.c + i);
+      const __m512i m = _mm512_add_epi64(_mm512_mul_epu32(cv, s),
+                                         _mm512_slli_epi64(_mm512_mul_epu32(_mm512_srli_epi64(cv, 32), s), 32));
+      put512<kNt>(x.a + i, _mm512_add_epi64(_mm512_loadu_si512(x.b + i), m));
+    }
+  }
+  if (kNt) store_fence();
+  if (kOp == Op::kRead) sum += static_cast<uint64_t>(_mm512_reduce_add_epi64(_mm512_add_epi64(acc0, acc1)));
+  return sum;
+}
+
+// Resolve kAuto, and fall back to scalar if the CPU lacks the requested set.
+static Simd resolve_simd(Simd want) {
+  __builtin_cpu_init();
+  const bool avx512 = __builtin_cpu_supports("avx512f");
+  const bool avx2 = __builtin_cpu_supports("avx2");
+  if (want == Simd::kAuto) return avx512 ? Simd::kAvx512 : avx2 ? Simd::kAvx2 : Simd::kScalar;
+  if ((want == Simd::kAvx512 && !avx512) || (want == Simd::kAvx2 && !avx2)) return Simd::kScalar;
+  return want;
+}
+#else
+static Simd resolve_simd(Simd) { return Simd::kScalar; }
+#endif
+
+// Contiguous [lo, hi) with the selected instruction set.
+template <Op kOp, bool kNt>
+static inline uint64_t run_range(Simd simd, const Arrays& x, size_t lo, size_t hi, size_t pf) {
+#if defined(__x86_64__)
+  if (simd == Simd::kAvx512) return kernel_avx512<kOp, kNt>(x, lo, hi, pf);
+  if (simd == Simd::kAvx2) return kernel_avx2<kOp, kNt>(x, lo, hi, pf);
+#endif
+  (void)simd;
+  return kernel_scalar<kOp, kNt>(x, lo, hi, pf);
+}
+
+// Strided pass for the interleave pattern: i = (base + off) % n for
+// off = first, first + stride, ... < len. Split at the wrap point so the
+// inner loops have no modulo.
+template <Op kOp, bool kNt>
+static uint64_t run_strided(const Arrays& x, size_t base, size_t len, size_t first, size_t stride, size_t pf) {
+  uint64_t* __restrict a = x.a;
+  uint64_t* __restrict b = x.b;
+  const uint64_t* __restrict c = x.c;
+  uint64_t sum = 0;
+  const size_t split = std::min(len, x.n - base);  // offsets below this do not wrap
+  size_t off = first;
+  for (; off < split; off += stride) {
+    if (pf) prefetch_sources<kOp>(x, base + off + pf);
+    sum += elem<kOp, kNt>(a, b, c, base + off);
+  }
+  for (; off < len; off += stride) {
+    if (pf) prefetch_sources<kOp>(x, base + off - x.n + pf);
+    sum += elem<kOp, kNt>(a, b, c, base + off - x.n);
+  }
+  if (kNt) store_fence();
+  return sum;
+}
+
+// Live per-thread progress for the --timeline reporter. One cache line per
+// thread, written only by its owner once per pass.
+struct alignas(64) ThreadCounters {
+  std::atomic<uint64_t> elems{0};
+  std::atomic<uint64_t> passes{0};
+};
+
+// Raised once by the main thread at the deadline. It sits alone on its cache
+// line, so polling it costs workers an L1 hit until the single write.
+// `agreed` carries one thread's reading of `set` to the others under
+// --sync-phases (see run_worker).
+struct alignas(64) StopFlag {
+  std::atomic<bool> set{false};
+  std::atomic<bool> agreed{false};
+};
+
+// State shared by all workers.
+struct LoopCtx {
+  const Config* cfg;
+  Arrays arr;
+  Simd simd;
+  size_t prefetch_elems;  // 0 => no software prefetch
+  size_t elems_per_page;
+  size_t window_elems;
+  size_t step_elems;
+  pthread_barrier_t* barrier;
+  StopFlag* stop;
+  ThreadCounters* counters;  // one per thread
+};
+
+struct WorkerResult {
+  uint64_t sink = 0;
+  uint64_t elems = 0;   // elements processed (bytes = elems * *_bytes_per_elem)
+  uint64_t passes = 0;
+  uint64_t active_ns = 0;  // first pass start to last pass end
+  uint64_t pass_min_ns = UINT64_MAX;
+  uint64_t pass_max_ns = 0;
+  uint64_t pass_sum_ns = 0;  // kernel time only (no barrier/sleep)
+  double best_elems_per_ns = 0;
+};
+
+// The pass loop, specialized on Op and Pattern.
+template <Op kOp, Pattern kPattern, bool kNt>
+static WorkerResult run_worker(const LoopCtx& ctx, int tid) {
+  const Config& cfg = *ctx.cfg;
+  const Arrays& x = ctx.arr;
+  WorkerResult r;
+  size_t pass = 0;
+
+  // Work on a single array-length (elems_per_array). All ops confined within that.
+  const size_t n = x.n;
+  const int T = cfg.threads;
+  const size_t window_elems = ctx.window_elems;
+  const size_t step_elems = ctx.step_elems;
+
+  // Chunk assignment
+  const size_t chunk = (n + static_cast<size_t>(T) - 1) / static_cast<size_t>(T);
+  const size_t chunk_lo0 = std::min(n, static_cast<size_t>(tid) * chunk);
+  const size_t chunk_hi0 = std::min(n, chunk_lo0 + chunk);
+
+  ThreadCounters& live = ctx.counters[tid];
+  const size_t per_check = static_cast<size_t>(std::max(1, cfg.passes_per_check));
+  // Passes are timed in groups: one clock read per stop check, or per pass
+  // when barriers/sleeps sit between passes (they are not pass time).
+  const bool pauses = ctx.barrier != nullptr || (cfg.phase_sleep_us > 0 && window_elems > 0);
+  const auto t_first = std::chrono::steady_clock::now();
+  auto t_group = t_first;
+  auto t_last = t_first;
+  uint64_t group_passes = 0;
+  uint64_t group_elems0 = 0;
+  auto close_group = [&](std::chrono::steady_clock::time_point t) {
+    const uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t - t_group).count());
+    const uint64_t avg = ns / group_passes;
+    r.pass_min_ns = std::min(r.pass_min_ns, avg);
+    r.pass_max_ns = std::max(r.pass_max_ns, avg);
+    r.pass_sum_ns += ns;
+    if (ns > 0) {
+      r.best_elems_per_ns = std::max(r.best_elems_per_ns, static_cast<double>(r.elems - group_elems0) / ns);
+    }
+    group_passes = 0;
+    group_elems0 = r.elems;
+    t_last = t;
+  };
+
+  while (true) {
+    // Phase shift moves the starting index each pass, creating visible diagonals if enabled.
+    const size_t phase_shift = (cfg.phase_pages == 0) ? 0 : ((pass * cfg.phase_pages) * ctx.elems_per_page) % n;
+
+    if (kPattern == Pattern::kChunk) {
+      // Rotate within the thread's chunk by an optional window (for visualization).
+      const size_t chunk_len = (chunk_hi0 > chunk_lo0) ? (chunk_hi0 - chunk_lo0) : 0;
+      size_t sub_len = chunk_len;
+      if (window_elems > 0 && chunk_len > 0) {
+        sub_len = std::min(chunk_len, window_elems);
+      }
+      // Step inside the chunk when windowing is enabled.
+      const size_t per_thread_step = (window_elems > 0 && step_elems > 0 && chunk_len > 0) ? (step_elems % chunk_len) : 0;
+      const size_t per_thread_phase = (window_elems > 0 && chunk_len > 0) ? ((pass * per_thread_step) % chunk_len) : 0;
+
+      // Compare against n instead of reducing hi mod n: a full-length range
+      // (one thread, no window) would otherwise come out empty.
+      const size_t lo = (chunk_lo0 + per_thread_phase + phase_shift) % n;
+      const size_t hi = lo + sub_len;
+      if (hi <= n) {
+        // Single interval [lo, hi)
+        r.sink += run_range<kOp, kNt>(ctx.simd, x, lo, hi, ctx.prefetch_elems);
+      } else {
+        // Wrapped intervals [lo, n) + [0, hi - n)
+        r.sink += run_range<kOp, kNt>(ctx.simd, x, lo, n, ctx.prefetch_elems);
+        r.sink += run_range<kOp, kNt>(ctx.simd, x, 0, hi - n, ctx.prefetch_elems);
+      }
+      r.elems += sub_len;
+    } else {
+      // Interleaved pattern (stride = threads).
+      // Optional: windowed scanning for visualization (shared window across threads).
+      size_t base = phase_shift;
+      size_t len = n;
+      if (window_elems > 0) {
+        const size_t w = std::min(n, window_elems);
+        const size_t st = (step_elems > 0) ? ((pass * step_elems) % n) : 0;
+        base = (st + phase_shift) % n;
+        len = w;
+      }
+      r.sink += run_strided<kOp, kNt>(x, base, len, static_cast<size_t>(tid), static_cast<size_t>(T),
+                                   ctx.prefetch_elems);
+      if (static_cast<size_t>(tid) < len) r.elems += (len - static_cast<size_t>(tid) + static_cast<size_t>(T) - 1) / static_cast<size_t>(T);
+    }
+
+    pass++;
+    group_passes++;
+    live.elems.store(r.elems, std::memory_order_relaxed);
+    live.passes.store(pass, std::memory_order_relaxed);
+
+    int barrier_rc = 0;
+    if (pauses) {
+      close_group(std::chrono::steady_clock::now());
+      if (ctx.barrier) {
+        barrier_rc = pthread_barrier_wait(ctx.barrier);
+      }
+      if (cfg.phase_sleep_us > 0 && window_elems > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(cfg.phase_sleep_us));
+      }
+    }
+
+    if ((pass % per_check) == 0) {
+      if (!pauses) {
+        const auto now = std::chrono::steady_clock::now();
+        close_group(now);
+        t_group = now;
+      }
+      bool stop;
+      if (ctx.barrier) {
+        // Every thread must leave after the same pass, or the rest would wait
+        // at the next barrier forever: the barrier's serial thread samples
+        // the flag, and a second barrier publishes its reading.
+        if (barrier_rc == PTHREAD_BARRIER_SERIAL_THREAD) {
+          ctx.stop->agreed.store(ctx.stop->set.load(std::memory_order_acquire), std::memory_order_relaxed);
+        }
+        (void)pthread_barrier_wait(ctx.barrier);
+        stop = ctx.stop->agreed.load(std::memory_order_relaxed);
+      } else {
+        stop = ctx.stop->set.load(std::memory_order_relaxed);
+      }
+      if (stop) break;
+    }
+    // Under pauses the next group starts here, after the stop-check
+    // barrier, so that wait is not charged to the next pass either.
+    if (pauses) t_group = std::chrono::steady_clock::now();
+  }
+
+  r.passes = pass;
+  r.active_ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t_last - t_first).count());
+
+  // Make sure compiler can't drop loops.
+  compiler_fence();
+  return r;
+}
+
+template <Op kOp, bool kNt>
+static WorkerResult run_worker_pattern(const LoopCtx& ctx, int tid) {
+  return (ctx.cfg->pattern == Pattern::kChunk) ? run_worker<kOp, Pattern::kChunk, kNt>(ctx, tid)
+                                               : run_worker<kOp, Pattern::kInterleave, kNt>(ctx, tid);
+}
+
+// Reads have nothing to stream, so they ignore --store.
+template <Op kOp>
+static WorkerResult run_worker_op(const LoopCtx& ctx, int tid) {
+  return (kOp != Op::kRead && ctx.cfg->store == Store::kNt) ? run_worker_pattern<kOp, true>(ctx, tid)
+                                                            : run_worker_pattern<kOp, false>(ctx, tid);
+}
+
+static WorkerResult run_worker_dispatch(const LoopCtx& ctx, int tid) {
+  switch (ctx.cfg->op) {
+    case Op::kRead: return run_worker_op<Op::kRead>(ctx, tid);
+    case Op::kWrite: return run_worker_op<Op::kWrite>(ctx, tid);
+    case Op::kCopy: return run_worker_op<Op::kCopy>(ctx, tid);
+    case Op::kTriad: return run_worker_op<Op::kTriad>(ctx, tid);
+  }
+  return {};
+}
+
+// Per-thread bandwidth timeline for --timeline: one row per thread per
+// interval until `stop`, then a final partial interval. time_sec is
+// CLOCK_MONOTONIC (perf time under `perf record -k CLOCK_MONOTONIC`).
+static void run_timeline(const ThreadCounters* counters, int threads, Op op, int interval_ms, FILE* out,
+                         const std::atomic<bool>& stop) {
+  std::vector<uint64_t> prev(static_cast<size_t>(threads), 0);
+  auto mono_ns = [] {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+  };
+  uint64_t prev_t = mono_ns();
+  auto next = std::chrono::steady_clock::now();
+  bool last = false;
+  while (!last) {
+    next += std::chrono::milliseconds(interval_ms);
+    while (!stop.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < next) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(std::min(interval_ms, 20)));
+    }
+    last = stop.load(std::memory_order_acquire);
+    const uint64_t t = mono_ns();
+    const double dt = static_cast<double>(t - prev_t) * 1e-9;
+    prev_t = t;
+    for (int i = 0; i < threads; i++) {
+      const uint64_t e = counters[i].elems.load(std::memory_order_relaxed);
+      const uint64_t d = e - prev[static_cast<size_t>(i)];
+      prev[static_cast<size_t>(i)] = e;
+      const uint64_t rd = d * read_bytes_per_elem(op);
+      const uint64_t wr = d * write_bytes_per_elem(op);
+      std::fprintf(out, "%.6f,%d,%.6f,%" PRIu64 ",%" PRIu64 ",%.3f\n", static_cast<double>(t) * 1e-9, i, dt, rd, wr,
+                   dt > 0 ? static_cast<double>(rd + wr) / dt / 1e9 : 0.0);
+    }
+    std::fflush(out);
+  }
+}
+
 }  // namespace
 
 int main(int argc, char** argv) {
@@ -192,9 +826,16 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  std::string numa_err;
+  if (!bench_memory::resolve_numa(&cfg.numa, &numa_err)) {
+    std::cerr << numa_err << "\n";
+    return 1;
+  }
+
   const size_t total_bytes = cfg.mem_mb * 1024ULL * 1024ULL;
-  const size_t total_pages = (total_bytes + kPageSize - 1) / kPageSize;
-  const size_t map_bytes = total_pages * kPageSize;
+  const size_t page_size = bench_memory::backing_page_bytes(cfg.page_backing);
+  const size_t total_pages = (total_bytes + page_size - 1) / page_size;
+  const size_t map_bytes = total_pages * page_size;
 
   // 3 arrays for triad, 2 for copy, 1 for read/write.
   const int n_arrays = (cfg.op == Op::kTriad) ? 3 : (cfg.op == Op::kCopy) ? 2 : 1;
@@ -208,45 +849,66 @@ int main(int argc, char** argv) {
             << " duration=" << cfg.duration_sec
             << " cpu_start=" << cfg.cpu_start
             << " pattern=" << (cfg.pattern == Pattern::kChunk ? "chunk" : "interleave")
-            << " op=";
-  switch (cfg.op) {
-    case Op::kRead: std::cout << "read"; break;
-    case Op::kWrite: std::cout << "write"; break;
-    case Op::kCopy: std::cout << "copy"; break;
-    case Op::kTriad: std::cout << "triad"; break;
-  }
-  std::cout << " touch=" << (cfg.touch ? 1 : 0)
+            << " op=" << op_name(cfg.op)
+            << " touch=" << (cfg.touch ? 1 : 0)
+            << " populate=" << bench_memory::populate_name(cfg.populate)
+            << " page_backing=" << bench_memory::backing_name(cfg.page_backing)
+            << " numa=" << bench_memory::numa_name(cfg.numa)
             << " phase_pages=" << cfg.phase_pages
             << " window_pages=" << cfg.window_pages
             << " step_pages=" << cfg.step_pages
             << " phase_sleep_us=" << cfg.phase_sleep_us
             << " sync_phases=" << (cfg.sync_phases ? 1 : 0)
+            << " passes_per_check=" << cfg.passes_per_check
             << " arrays=" << n_arrays
             << "\n";
-  std::cout << "Mapping bytes: " << map_bytes << " (" << total_pages << " pages)\n";
+  std::cout << "Mapping bytes: " << map_bytes << " (" << total_pages << " pages of " << (page_size >> 10)
+            << " KiB)\n";
   std::cout << "Array elements per array: " << elems_per_array
             << " (bytes_used=" << bytes_used << ")\n";
   std::cout << std::flush;
 
-  void* base = mmap(nullptr, bytes_used, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-  if (base == MAP_FAILED) {
-    std::cerr << "mmap failed: " << std::strerror(errno) << "\n";
+  bench_memory::Region region;
+  std::string map_err;
+  if (!bench_memory::map_region(bytes_used, cfg.page_backing,
+                                cfg.touch ? cfg.populate : bench_memory::Populate::kSerial, cfg.numa, &region,
+                                &map_err)) {
+    std::cerr << map_err << "\n";
     return 2;
   }
+  if (!region.note.empty()) std::cerr << "--page-backing: " << region.note << "\n";
+  void* base = region.base;
 
   auto* raw = reinterpret_cast<uint64_t*>(base);
   uint64_t* a = raw;
   uint64_t* b = (n_arrays >= 2) ? (raw + elems_per_array) : nullptr;
   uint64_t* c = (n_arrays >= 3) ? (raw + 2 * elems_per_array) : nullptr;
 
+  long long populate_ms = -1;  // -1 => not populated (--touch=0)
   if (cfg.touch) {
     std::cout << "Populating memory (" << base << " - " << (void*)((char*)base + bytes_used) << ")...\n";
     std::cout << std::flush; // important when stdout is redirected to a file
-    // Touch one byte per page. Also seed values so ops have real loads.
-    volatile uint8_t* p = reinterpret_cast<volatile uint8_t*>(base);
-    for (size_t off = 0; off < bytes_used; off += kPageSize) {
-      p[off] = 1;
+    // Give each worker the pages it streams over: the same chunk of every array
+    // for the chunk pattern, an even split otherwise (interleave touches every
+    // page from every thread, so there is no better owner).
+    const size_t array_bytes = elems_per_array * sizeof(uint64_t);
+    bench_memory::Parts parts;
+    if (cfg.pattern == Pattern::kChunk) {
+      for (uint64_t* arr : {a, b, c}) {
+        if (arr) {
+          bench_memory::add_chunks(&parts, reinterpret_cast<char*>(arr), array_bytes, cfg.threads,
+                                   sizeof(uint64_t), region.page);
+        }
+      }
+    } else {
+      parts = bench_memory::split_even(reinterpret_cast<char*>(base), bytes_used, cfg.threads, region.page);
     }
+    const auto populate_t0 = std::chrono::steady_clock::now();
+    const std::string note = bench_memory::populate(parts, cfg.populate, cfg.cpu_start);
+    if (!note.empty()) std::cerr << "--populate: " << note << "\n";
+    populate_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - populate_t0).count();
+    std::cout << "Populate: " << bench_memory::populate_name(cfg.populate) << " (" << populate_ms << " ms)\n";
     // Initialize arrays sparsely (cheap) so triad has non-zero inputs.
     for (size_t i = 0; i < elems_per_array; i += 1024) {
       a[i] = static_cast<uint64_t>(i);
@@ -257,8 +919,13 @@ int main(int argc, char** argv) {
     std::cout << "Populating memory (" << base << " - " << (void*)((char*)base + bytes_used) << ")... (touch disabled)\n";
     std::cout << std::flush;
   }
+  const std::string backing_str = bench_memory::backing_report(region);
+  const std::string numa_str = cfg.touch ? bench_memory::numa_report(region) : std::string();
+  std::cout << "Page backing: " << backing_str << "\n";
+  if (cfg.touch) std::cout << "NUMA pages: " << numa_str << "\n";
 
   // Signal to profiling scripts that the mapping is ready and the hot loop is about to start.
+  const double ready_sec = bench_report::monotonic_sec();
   std::cout << "READY: begin streaming loop\n" << std::flush;
 
   if (cfg.warmup_sec > 0) {
@@ -266,10 +933,14 @@ int main(int argc, char** argv) {
     std::this_thread::sleep_for(std::chrono::seconds(cfg.warmup_sec));
   }
 
-  std::atomic<bool> stop{false};
+  const Simd simd = resolve_simd(cfg.simd);
+  if (cfg.simd != Simd::kAuto && simd != cfg.simd) {
+    std::cerr << "Warning: --simd=" << simd_name(cfg.simd) << " not supported by this CPU; using scalar\n";
+  }
+
+  StopFlag stop;
   const auto t_start = std::chrono::steady_clock::now();
   const auto t_end = t_start + std::chrono::seconds(cfg.duration_sec);
-  const uint64_t scalar = 3;
 
   // Optional phase barrier (C++17: use pthread_barrier_t).
   pthread_barrier_t barrier;
@@ -282,209 +953,210 @@ int main(int argc, char** argv) {
     }
   }
 
-  const size_t elems_per_page = kPageSize / sizeof(uint64_t);
+  // Window, step and phase sizes are in pages of the backing actually mapped.
+  const size_t elems_per_page = region.page / sizeof(uint64_t);
   const size_t window_elems = (cfg.window_pages > 0) ? (cfg.window_pages * elems_per_page) : 0;
   const size_t eff_step_pages = (cfg.window_pages > 0) ? ((cfg.step_pages > 0) ? cfg.step_pages : cfg.window_pages) : 0;
   const size_t step_elems = (eff_step_pages > 0) ? (eff_step_pages * elems_per_page) : 0;
 
-  auto worker = [&](int tid) {
-    pin_to_cpu_if_needed(cfg.cpu_start < 0 ? -1 : (cfg.cpu_start + tid));
-
-    uint64_t local = 0;
-    size_t pass = 0;
-
-    // Work on a single array-length (elems_per_array). All ops confined within that.
-    const size_t n = elems_per_array;
-    const int T = cfg.threads;
-
-    // Chunk assignment
-    const size_t chunk = (n + static_cast<size_t>(T) - 1) / static_cast<size_t>(T);
-    const size_t chunk_lo0 = std::min(n, static_cast<size_t>(tid) * chunk);
-    const size_t chunk_hi0 = std::min(n, chunk_lo0 + chunk);
-
-    while (true) {
-      // Phase shift moves the starting index each pass, creating visible diagonals if enabled.
-      const size_t phase_shift = (cfg.phase_pages == 0) ? 0 : ((pass * cfg.phase_pages) * elems_per_page) % n;
-
-      if (cfg.pattern == Pattern::kChunk) {
-        // Rotate within the thread's chunk by an optional window (for visualization).
-        const size_t chunk_len = (chunk_hi0 > chunk_lo0) ? (chunk_hi0 - chunk_lo0) : 0;
-        size_t sub_len = chunk_len;
-        if (window_elems > 0 && chunk_len > 0) {
-          sub_len = std::min(chunk_len, window_elems);
-        }
-        // Step inside the chunk when windowing is enabled.
-        const size_t per_thread_step = (window_elems > 0 && step_elems > 0 && chunk_len > 0) ? (step_elems % chunk_len) : 0;
-        const size_t per_thread_phase = (window_elems > 0 && chunk_len > 0) ? ((pass * per_thread_step) % chunk_len) : 0;
-
-        const size_t lo = (chunk_lo0 + per_thread_phase + phase_shift) % n;
-        const size_t hi = (chunk_lo0 + per_thread_phase + sub_len + phase_shift) % n;
-        if (lo <= hi) {
-          // Single interval [lo, hi)
-          for (size_t i = lo; i < hi; i++) {
-            switch (cfg.op) {
-              case Op::kRead: {
-                uint64_t v = a[i];
-                local += v;
-                break;
-              }
-              case Op::kWrite: {
-                uint64_t v = static_cast<uint64_t>(i) + local;
-                a[i] = v;
-                local += v;
-                break;
-              }
-              case Op::kCopy: {
-                uint64_t v = a[i];
-                b[i] = v;
-                local += v;
-                break;
-              }
-              case Op::kTriad: {
-                uint64_t v = b[i] + scalar * c[i];
-                a[i] = v;
-                local += v;
-                break;
-              }
-            }
-          }
-        } else {
-          // Wrapped intervals [lo, n) + [0, hi)
-          for (size_t i = lo; i < n; i++) {
-            switch (cfg.op) {
-              case Op::kRead: {
-                uint64_t v = a[i];
-                local += v;
-                break;
-              }
-              case Op::kWrite: {
-                uint64_t v = static_cast<uint64_t>(i) + local;
-                a[i] = v;
-                local += v;
-                break;
-              }
-              case Op::kCopy: {
-                uint64_t v = a[i];
-                b[i] = v;
-                local += v;
-                break;
-              }
-              case Op::kTriad: {
-                uint64_t v = b[i] + scalar * c[i];
-                a[i] = v;
-                local += v;
-                break;
-              }
-            }
-          }
-          for (size_t i = 0; i < hi; i++) {
-            switch (cfg.op) {
-              case Op::kRead: {
-                uint64_t v = a[i];
-                local += v;
-                break;
-              }
-              case Op::kWrite: {
-                uint64_t v = static_cast<uint64_t>(i) + local;
-                a[i] = v;
-                local += v;
-                break;
-              }
-              case Op::kCopy: {
-                uint64_t v = a[i];
-                b[i] = v;
-                local += v;
-                break;
-              }
-              case Op::kTriad: {
-                uint64_t v = b[i] + scalar * c[i];
-                a[i] = v;
-                local += v;
-                break;
-              }
-            }
-          }
-        }
-      } else {
-        // Interleaved pattern (stride = threads).
-        // Optional: windowed scanning for visualization (shared window across threads).
-        size_t base = phase_shift;
-        size_t len = n;
-        if (window_elems > 0) {
-          const size_t w = std::min(n, window_elems);
-          const size_t st = (step_elems > 0) ? ((pass * step_elems) % n) : 0;
-          base = (st + phase_shift) % n;
-          len = w;
-        }
-        for (size_t off = static_cast<size_t>(tid); off < len; off += static_cast<size_t>(T)) {
-          const size_t i = (base + off) % n;
-          switch (cfg.op) {
-            case Op::kRead: {
-              uint64_t v = a[i];
-              local += v;
-              break;
-            }
-            case Op::kWrite: {
-              uint64_t v = static_cast<uint64_t>(i) + local;
-              a[i] = v;
-              local += v;
-              break;
-            }
-            case Op::kCopy: {
-              uint64_t v = a[i];
-              b[i] = v;
-              local += v;
-              break;
-            }
-            case Op::kTriad: {
-              uint64_t v = b[i] + scalar * c[i];
-              a[i] = v;
-              local += v;
-              break;
-            }
-          }
-        }
-      }
+  LoopCtx ctx;
+  ctx.cfg = &cfg;
+  ctx.arr = Arrays{a, b, c, elems_per_array};
+  ctx.simd = simd;
+  ctx.prefetch_elems = cfg.prefetch_lines * kLineElems;
+  ctx.elems_per_page = elems_per_page;
+  ctx.window_elems = window_elems;
+  ctx.step_elems = step_elems;
+  ctx.barrier = barrier_ptr;
+  ctx.stop = &stop;
 
-      pass++;
-
-      if (barrier_ptr) {
-        (void)pthread_barrier_wait(barrier_ptr);
-      }
-      if (cfg.phase_sleep_us > 0 && window_elems > 0) {
-        std::this_thread::sleep_for(std::chrono::microseconds(cfg.phase_sleep_us));
-      }
+  std::unique_ptr<ThreadCounters[]> counters(new ThreadCounters[static_cast<size_t>(cfg.threads)]);
+  ctx.counters = counters.get();
 
-      if ((pass % static_cast<size_t>(std::max(1, cfg.passes_per_check))) == 0) {
-        const auto now = std::chrono::steady_clock::now();
-        if (now >= t_end) break;
-        if (stop.load(std::memory_order_relaxed)) break;
-      }
+  FILE* timeline = nullptr;
+  if (!cfg.timeline.empty()) {
+    timeline = std::fopen(cfg.timeline.c_str(), "w");
+    if (!timeline) {
+      std::cerr << "Cannot open " << cfg.timeline << ": " << std::strerror(errno) << "\n";
+      return 2;
     }
+    std::fprintf(timeline, "time_sec,thread,interval_sec,read_bytes,write_bytes,gbps\n");
+  }
+  std::atomic<bool> timeline_stop{false};
+  std::thread timeline_thread;
+  if (timeline) {
+    timeline_thread = std::thread(run_timeline, counters.get(), cfg.threads, cfg.op, cfg.timeline_interval_ms,
+                                  timeline, std::cref(timeline_stop));
+  }
 
-    // Make sure compiler can't drop loops.
-    compiler_fence();
-    g_sink.fetch_add(local, std::memory_order_relaxed);
+  std::vector<WorkerResult> results(static_cast<size_t>(cfg.threads));
+  auto worker = [&](int tid) {
+    bench_memory::pin_to_cpu(cfg.cpu_start < 0 ? -1 : (cfg.cpu_start + tid));
+    results[static_cast<size_t>(tid)] = run_worker_dispatch(ctx, tid);
   };
 
+  // --ready-file fires after the warmup sleep, right before the workers start.
+  const double start_sec = bench_report::monotonic_sec();
+  if (!cfg.ready_file.empty()) {
+    std::string ready_err;
+    if (!bench_report::signal_ready(cfg.ready_file,
+                                    bench_report::ready_line(start_sec, base, (char*)base + bytes_used),
+                                    &ready_err)) {
+      std::cerr << "--ready-file: " << ready_err << "\n";
+    }
+  }
   std::vector<std::thread> th;
   th.reserve(static_cast<size_t>(cfg.threads));
   for (int t = 0; t < cfg.threads; t++) {
     th.emplace_back(worker, t);
   }
+  // The main thread is the timer: workers only poll the flag.
+  std::this_thread::sleep_until(t_end);
+  stop.set.store(true, std::memory_order_release);
   for (auto& x : th) x.join();
 
   const auto t_done = std::chrono::steady_clock::now();
+  const double end_sec = bench_report::monotonic_sec();
   const double sec = std::chrono::duration<double>(t_done - t_start).count();
+  timeline_stop.store(true, std::memory_order_release);
+  if (timeline_thread.joinable()) timeline_thread.join();
+  if (timeline) std::fclose(timeline);
 
-  // Rough bytes/touched per full pass (per thread ranges may not cover entire array if chunk rounding).
-  // This is informational only.
+  // STREAM-style rate: bytes the kernel names (each array touched once per
+  // element, no write-allocate) over wall time, in 1e9 bytes/s.
+  const bool nt = cfg.store == Store::kNt && cfg.op != Op::kRead;
+  const size_t rd_per = read_bytes_per_elem(cfg.op);
+  const size_t wr_per = write_bytes_per_elem(cfg.op);
+  uint64_t elems = 0;
+  uint64_t passes = 0;
+  uint64_t pass_min_ns = UINT64_MAX;
+  uint64_t pass_max_ns = 0;
+  uint64_t pass_sum_ns = 0;
+  for (const auto& r : results) {
+    elems += r.elems;
+    passes += r.passes;
+    pass_min_ns = std::min(pass_min_ns, r.pass_min_ns);
+    pass_max_ns = std::max(pass_max_ns, r.pass_max_ns);
+    pass_sum_ns += r.pass_sum_ns;
+    g_sink.fetch_add(r.sink, std::memory_order_relaxed);
+  }
+  const double bytes_rd = static_cast<double>(elems) * static_cast<double>(rd_per);
+  const double bytes_wr = static_cast<double>(elems) * static_cast<double>(wr_per);
+  const double bytes = bytes_rd + bytes_wr;
+  auto gbps = [](double b, double s) { return s > 0 ? b / s / 1e9 : 0.0; };
   std::cout << "Done. elapsed_sec=" << sec << " sink=" << g_sink.load() << "\n";
+  std::cout << "STREAM bandwidth: " << gbps(bytes, sec) << " GB/s (" << elems
+            << " elements x " << stream_bytes_per_elem(cfg.op) << " B, simd=" << simd_name(simd)
+            << " store=" << (nt ? "nt" : "regular")
+            << " prefetch_lines=" << cfg.prefetch_lines << ")\n";
+  // Regular stores read every destination line before writing it.
+  const double bytes_rfo = nt ? 0.0 : bytes_wr;
+  std::cout << "Bytes: read=" << static_cast<uint64_t>(bytes_rd) << " written=" << static_cast<uint64_t>(bytes_wr)
+            << " write_allocate=" << static_cast<uint64_t>(bytes_rfo)
+            << " total_with_write_allocate_GBps=" << gbps(bytes + bytes_rfo, sec) << "\n";
+  if (passes > 0) {
+    std::cout << "Pass time (sec): min=" << pass_min_ns * 1e-9 << " avg=" << (pass_sum_ns * 1e-9 / passes)
+              << " max=" << pass_max_ns * 1e-9 << " passes=" << passes << "\n";
+  }
+  for (int t = 0; t < cfg.threads; t++) {
+    const WorkerResult& r = results[static_cast<size_t>(t)];
+    const double tb = static_cast<double>(r.elems) * static_cast<double>(rd_per + wr_per);
+    std::cout << "Thread " << t << ": passes=" << r.passes << " bytes=" << static_cast<uint64_t>(tb)
+              << " GBps=" << gbps(tb, r.active_ns * 1e-9);
+    if (r.passes > 0) {
+      std::cout << " pass_sec_min=" << r.pass_min_ns * 1e-9 << " avg=" << (r.pass_sum_ns * 1e-9 / r.passes)
+                << " max=" << r.pass_max_ns * 1e-9
+                << " best_pass_GBps=" << r.best_elems_per_ns * static_cast<double>(rd_per + wr_per);
+    }
+    std::cout << "\n";
+  }
+
+  if (!cfg.json.empty()) {
+    bench_report::Json j;
+    j.begin_object();
+    j.field("benchmark", "stream_bench").field("pid", static_cast<int>(getpid()));
+    j.begin_object("config")
+        .field("mem_mb", cfg.mem_mb)
+        .field("threads", cfg.threads)
+        .field("cpu_start", cfg.cpu_start)
+        .field("duration_sec", cfg.duration_sec)
+        .field("warmup_sec", cfg.warmup_sec)
+        .field("op", op_name(cfg.op))
+        .field("pattern", cfg.pattern == Pattern::kChunk ? "chunk" : "interleave")
+        .field("simd", simd_name(simd))
+        .field("store", nt ? "nt" : "regular")
+        .field("prefetch_lines", cfg.prefetch_lines)
+        .field("touch", cfg.touch)
+        .field("populate", bench_memory::populate_name(cfg.populate))
+        .field("page_backing", bench_memory::backing_name(region.backing))
+        .field("numa", bench_memory::numa_name(cfg.numa))
+        .field("phase_pages", cfg.phase_pages)
+        .field("window_pages", cfg.window_pages)
+        .field("step_pages", cfg.step_pages)
+        .field("phase_sleep_us", cfg.phase_sleep_us)
+        .field("sync_phases", cfg.sync_phases)
+        .field("passes_per_check", cfg.passes_per_check)
+        .end_object();
+    j.begin_object("mapping")
+        .field("addr_lo", bench_report::hex_addr(base))
+        .field("addr_hi", bench_report::hex_addr((char*)base + bytes_used))
+        .field("bytes", bytes_used)
+        .field("page_bytes", region.page)
+        .field("arrays", n_arrays)
+        .field("elems_per_array", elems_per_array)
+        .field("page_backing", backing_str)
+        .field("numa_pages", numa_str)
+        .field("populate_ms", populate_ms)
+        .end_object();
+    j.begin_object("timestamps")
+        .field("clock", "CLOCK_MONOTONIC")
+        .field("ready_sec", ready_sec)
+        .field("start_sec", start_sec)
+        .field("end_sec", end_sec)
+        .end_object();
+    j.begin_object("results")
+        .field("elapsed_sec", sec)
+        .field("elements", elems)
+        .field("passes", passes)
+        .field("stream_gbps", gbps(bytes, sec))
+        .field("read_bytes", bytes_rd)
+        .field("written_bytes", bytes_wr)
+        .field("write_allocate_bytes", bytes_rfo)
+        .field("total_with_write_allocate_gbps", gbps(bytes + bytes_rfo, sec))
+        .field("pass_sec_min", passes > 0 ? pass_min_ns * 1e-9 : 0.0)
+        .field("pass_sec_avg", passes > 0 ? pass_sum_ns * 1e-9 / passes : 0.0)
+        .field("pass_sec_max", pass_max_ns * 1e-9)
+        .end_object();
+    j.begin_array("per_thread");
+    for (int t = 0; t < cfg.threads; t++) {
+      const WorkerResult& r = results[static_cast<size_t>(t)];
+      const double tb = static_cast<double>(r.elems) * static_cast<double>(rd_per + wr_per);
+      j.begin_object()
+          .field("thread", t)
+          .field("cpu", cfg.cpu_start < 0 ? -1 : cfg.cpu_start + t)
+          .field("passes", r.passes)
+          .field("bytes", tb)
+          .field("active_sec", r.active_ns * 1e-9)
+          .field("gbps", gbps(tb, r.active_ns * 1e-9))
+          .field("pass_sec_min", r.passes > 0 ? r.pass_min_ns * 1e-9 : 0.0)
+          .field("pass_sec_avg", r.passes > 0 ? r.pass_sum_ns * 1e-9 / r.passes : 0.0)
+          .field("pass_sec_max", r.pass_max_ns * 1e-9)
+          .field("best_pass_gbps", r.best_elems_per_ns * static_cast<double>(rd_per + wr_per))
+          .end_object();
+    }
+    j.end_array();
+    j.end_object();
+    std::string json_err;
+    if (!bench_report::write_file_atomic(cfg.json, j.str() + "\n", &json_err)) {
+      std::cerr << "--json: " << json_err << "\n";
+      return 2;
+    }
+  }
 
   if (barrier_ptr) {
     pthread_barrier_destroy(barrier_ptr);
   }
-  munmap(base, bytes_used);
+  region.unmap();
   return 0;
 }
 
@@ -11,9 +11,158 @@
 #include <atomic>
 #include <pthread.h>
 #include <sched.h>
+#include <memory>
+#include <string>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
-// Page size
-const size_t PAGE_SIZE = 4096;
+#include "bench_memory.hpp"
+#include "bench_report.hpp"
+
+// splitmix64: seeds the per-thread xoshiro state from a single 64-bit seed.
+static inline uint64_t splitmix64(uint64_t& x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256** (Blackman/Vigna). Much cheaper per draw than std::mt19937 and
+// good enough for choosing pages.
+class Xoshiro256 {
+public:
+    explicit Xoshiro256(uint64_t seed) {
+        for (auto& w : s_) w = splitmix64(seed);
+    }
+
+    inline uint64_t next() {
+        const uint64_t result = rotl(s_[1] * 5, 7) * 9;
+        const uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, n) via multiply-high (Lemire), no modulo.
+    inline uint32_t below(uint32_t n) {
+        return (uint32_t)(((next() >> 32) * n) >> 32);
+    }
+
+private:
+    static inline uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+    uint64_t s_[4];
+};
+
+// ---- zeta(n, theta) = sum_{i=1..n} 1/i^theta -------------------------------
+//
+// ZipfianGenerator needs zeta(num_keys), which is O(n) std::pow calls: seconds
+// for 16M keys, and it used to be recomputed by every worker. main() now
+// computes it once (exact, Euler-Maclaurin, or from the cache file) and hands
+// the value to every generator.
+
+enum class ZetaMode { kAuto, kExact, kApprox };
+
+// Exact sum, split across `threads` contiguous chunks. Each chunk adds its
+// terms smallest-first, and chunks are combined smallest-first, to keep
+// rounding error at the level of the serial loop.
+static double zeta_exact(uint64_t n, double theta, int threads) {
+    threads = (int)std::max<uint64_t>(1, std::min<uint64_t>((uint64_t)std::max(1, threads), n / 65536 + 1));
+    std::vector<double> part((size_t)threads, 0.0);
+    std::vector<std::thread> th;
+    for (int t = 0; t < threads; t++) {
+        th.emplace_back([&, t]() {
+            const uint64_t lo = n * (uint64_t)t / (uint64_t)threads;
+            const uint64_t hi = n * (uint64_t)(t + 1) / (uint64_t)threads;
+            double sum = 0.0;
+            for (uint64_t i = hi; i > lo; i--) sum += 1 / std::pow((double)i, theta);
+            part[(size_t)t] = sum;
+        });
+    }
+    for (auto& x : th) x.join();
+    double sum = 0.0;
+    for (int t = threads - 1; t >= 0; t--) sum += part[(size_t)t];
+    return sum;
+}
+
+// Euler-Maclaurin: exact head up to m-1, then integral + endpoint and
+// Bernoulli correction terms (B2, B4, B6) for the tail m..n. With m = 1024 the
+// truncation error is ~m^-(theta+7), far below double precision.
+static double zeta_approx(uint64_t n, double theta) {
+    const uint64_t m = 1024;
+    if (n <= 4 * m) return zeta_exact(n, theta, 1);
+    double head = 0.0;
+    for (uint64_t i = m - 1; i >= 1; i--) head += 1 / std::pow((double)i, theta);
+
+    const double s = theta;
+    const double a = (double)m;
+    const double b = (double)n;
+    auto f = [&](double x) { return std::pow(x, -s); };
+    auto d1 = [&](double x) { return -s * std::pow(x, -s - 1); };
+    auto d3 = [&](double x) { return -s * (s + 1) * (s + 2) * std::pow(x, -s - 3); };
+    auto d5 = [&](double x) { return -s * (s + 1) * (s + 2) * (s + 3) * (s + 4) * std::pow(x, -s - 5); };
+    // (b^(1-s) - a^(1-s)) / (1-s), written with expm1 so theta -> 1 does not cancel.
+    const double lr = std::log(b / a);
+    const double integral = (s == 1.0) ? lr : std::pow(a, 1 - s) * std::expm1((1 - s) * lr) / (1 - s);
+    const double tail = integral + (f(a) + f(b)) / 2 + (d1(b) - d1(a)) / 12 - (d3(b) - d3(a)) / 720 +
+                        (d5(b) - d5(a)) / 30240;
+    return head + tail;
+}
+
+// Optional on-disk cache: one "n theta zeta" line per entry (theta and zeta
+// printed with %.17g so they round-trip exactly). Exact and approximate
+// values are never mixed: approximate entries are stored with a trailing "~".
+static bool zeta_cache_lookup(const std::string& path, uint64_t n, double theta, bool exact, double* out) {
+    FILE* f = std::fopen(path.c_str(), "r");
+    if (!f) return false;
+    unsigned long long cn;
+    double ct, cz;
+    char tag[8];
+    bool found = false;
+    while (std::fscanf(f, "%llu %lg %lg %7s", &cn, &ct, &cz, tag) == 4) {
+        if (cn == n && ct == theta && (std::strcmp(tag, "=") == 0) == exact) {
+            *out = cz;
+            found = true;
+        }
+    }
+    std::fclose(f);
+    return found;
+}
+
+static void zeta_cache_store(const std::string& path, uint64_t n, double theta, bool exact, double z) {
+    FILE* f = std::fopen(path.c_str(), "a");
+    if (!f) {
+        std::cerr << "zeta cache: cannot write " << path << ": " << std::strerror(errno) << std::endl;
+        return;
+    }
+    std::fprintf(f, "%llu %.17g %.17g %s\n", (unsigned long long)n, theta, z, exact ? "=" : "~");
+    std::fclose(f);
+}
+
+static double compute_zeta(uint64_t n, double theta, ZetaMode mode, int threads, const std::string& cache_path,
+                           const char** how) {
+    // Auto: the exact sum is cheap below ~1M keys; above that Euler-Maclaurin
+    // agrees with it to ~1e-13 relative, the same order as the rounding error
+    // of the old serial loop.
+    const bool exact = (mode == ZetaMode::kExact) || (mode == ZetaMode::kAuto && n <= (1u << 20));
+    double z = 0.0;
+    if (!cache_path.empty() && zeta_cache_lookup(cache_path, n, theta, exact, &z)) {
+        *how = "cache";
+        return z;
+    }
+    z = exact ? zeta_exact(n, theta, threads) : zeta_approx(n, theta);
+    *how = exact ? "exact" : "euler-maclaurin";
+    if (!cache_path.empty()) zeta_cache_store(cache_path, n, theta, exact, z);
+    return z;
+}
 
 template <bool sorted>
 class ZipfianGenerator {
@@ -29,14 +178,23 @@ public:
 
     explicit ZipfianGenerator(int num_keys,
                               double zipfian_constant = ZIPFIAN_CONSTANT)
-        : num_keys_(num_keys), dis_(0, 1), zipfian_constant_(zipfian_constant) {
+        : num_keys_(num_keys), zipfian_constant_(zipfian_constant), dis_(0, 1) {
         
         // Calculate Zeta(N) correctly for the given number of keys
-        zetan_ = zeta(num_keys);
-        
+        init(zeta(num_keys));
+    }
+
+    // Use a precomputed zeta(num_keys) (see compute_zeta) instead of the O(n) loop.
+    ZipfianGenerator(int num_keys, double zipfian_constant, double zetan)
+        : num_keys_(num_keys), zipfian_constant_(zipfian_constant), dis_(0, 1) {
+        init(zetan);
+    }
+
+    void init(double zetan) {
+        zetan_ = zetan;
         double zeta2theta = zeta(2);
-        alpha_ = 1. / (1. - zipfian_constant);
-        eta_ = (1 - std::pow(2. / num_keys_, 1 - zipfian_constant)) /
+        alpha_ = 1. / (1. - zipfian_constant_);
+        eta_ = (1 - std::pow(2. / num_keys_, 1 - zipfian_constant_)) /
                (1 - zeta2theta / zetan_);
     }
 
@@ -93,41 +251,764 @@ public:
     }
 };
 
+// Keyed permutation of [0, n). permute_bits is a bijection on [0, 2^bits)
+// (adding a constant, xor with a constant, xorshift-right and multiplying by
+// an odd constant are each invertible mod 2^bits); cycle-walking it until the
+// value is below n restricts it to a bijection on [0, n). 2^bits < 2n, so that
+// takes fewer than two steps on average. inverse() walks the cycle backwards.
+struct Scrambler {
+    static constexpr uint32_t kMul1 = 0x9e3779b1u;
+    static constexpr uint32_t kMul2 = 0x85ebca6bu;
+
+    uint32_t n;
+    uint32_t mask;
+    int bits;
+    int shift;
+    uint32_t k0;
+    uint32_t k1;
+
+    explicit Scrambler(uint32_t num_keys, uint64_t key = 0x6a09e667u)
+        : n(num_keys), k0((uint32_t)key), k1((uint32_t)(key >> 32)) {
+        bits = (num_keys <= 1) ? 0 : 32 - __builtin_clz(num_keys - 1);
+        mask = (bits == 32) ? UINT32_MAX : (1u << bits) - 1;
+        shift = std::max(1, (bits + 1) / 2);
+    }
+
+    uint32_t permute_bits(uint32_t x) const {
+        x = (x + k0) & mask;
+        x ^= x >> shift;
+        x = (x * kMul1) & mask;
+        x = (x ^ k1) & mask;
+        x ^= x >> shift;
+        x = (x * kMul2) & mask;
+        x ^= x >> shift;
+        return x;
+    }
+
+    uint32_t unpermute_bits(uint32_t x) const {
+        x = unxorshift(x);
+        x = (x * inverse_mul(kMul2)) & mask;
+        x = unxorshift(x);
+        x = (x ^ k1) & mask;
+        x = (x * inverse_mul(kMul1)) & mask;
+        x = unxorshift(x);
+        return (x - k0) & mask;
+    }
+
+    uint32_t operator()(uint32_t x) const {
+        do {
+            x = permute_bits(x);
+        } while (x >= n);
+        return x;
+    }
+
+    uint32_t inverse(uint32_t x) const {
+        do {
+            x = unpermute_bits(x);
+        } while (x >= n);
+        return x;
+    }
+
+private:
+    // Undo y = x ^ (x >> shift) for x < 2^bits: each round fixes `shift`
+    // more of the high bits.
+    uint32_t unxorshift(uint32_t y) const {
+        uint32_t x = y;
+        for (int done = shift; done < bits; done += shift) x = y ^ (x >> shift);
+        return x;
+    }
+
+    // Multiplicative inverse of an odd c mod 2^32 (Newton, 5 doublings).
+    static constexpr uint32_t inverse_mul(uint32_t c) {
+        uint32_t inv = c;
+        for (int i = 0; i < 5; i++) inv *= 2u - c * inv;
+        return inv;
+    }
+};
+
+// Fast drop-in for ZipfianGenerator<false>.
+//
+// The legacy generator maps u ~ U(0,1) to a rank with std::pow on every draw
+// (YCSB's approximation), then scrambles the rank with a byte-wise FNV hash.
+// Here the exact rank distribution that mapping induces is tabulated once into
+// a Walker/Vose alias table shared by all threads, so a draw is one 64-bit RNG
+// output, one table load and a compare. Instead of hashing each draw with
+// FNV, ranks are mapped to pages by a permutation of [0, n) while the table is
+// built, so every page is reachable and no two ranks share a page: hot pages
+// still land at scattered addresses and the popularity distribution is
+// unchanged, only which pages are hot differs.
+class FastZipfianGenerator {
+public:
+    struct Entry {
+        uint32_t threshold;  // keep `rank` if low 32 RNG bits < threshold
+        uint32_t alias;
+    };
+
+    FastZipfianGenerator(uint32_t num_keys, double zipfian_constant, double zetan)
+        : num_keys_(num_keys), table_(num_keys) {
+
+        // Probability mass of each rank under ZipfianGenerator::nextValue:
+        //   u < 1/zetan                      -> 0
+        //   u < (1 + 0.5^theta)/zetan        -> 1
+        //   otherwise floor(n * (eta*u - eta + 1)^alpha)
+        // so rank k (from the formula) owns u in [G(k), G(k+1)) with
+        //   G(k) = 1 - (1 - (k/n)^(1-theta)) / eta.
+        const double theta = zipfian_constant;
+        const double n = (double)num_keys;
+        const double zeta2 = 1.0 + std::pow(0.5, theta);
+        const double eta = (1 - std::pow(2. / n, 1 - theta)) / (1 - zeta2 / zetan);
+        const double c0 = 1.0 / zetan;
+        const double c1 = zeta2 / zetan;
+        auto G = [&](double k) { return 1.0 - (1.0 - std::pow(k / n, 1 - theta)) / eta; };
+
+        std::vector<double> p(num_keys);
+        double g_lo = G(0);
+        for (uint32_t k = 0; k < num_keys; k++) {
+            const double g_hi = (k + 1 == num_keys) ? 1.0 : G(k + 1);
+            p[k] = std::max(0.0, std::min(g_hi, 1.0) - std::max(g_lo, c1));
+            g_lo = g_hi;
+        }
+        p[0] += c0;
+        if (num_keys > 1) p[1] += c1 - c0;
+
+        // Scramble ranks into pages here, once: the table then samples pages
+        // directly and a draw needs no per-rank hashing.
+        {
+            const Scrambler sc(num_keys);
+            std::vector<double> by_page(num_keys);
+            for (uint32_t k = 0; k < num_keys; k++) by_page[sc(k)] = p[k];
+            p.swap(by_page);
+        }
+
+        // Vose's alias method on probabilities scaled to mean 1.
+        double total = 0.0;
+        for (double v : p) total += v;
+        const double scale = n / total;
+        std::vector<uint32_t> small, large;
+        for (uint32_t k = 0; k < num_keys; k++) {
+            p[k] *= scale;
+            (p[k] < 1.0 ? small : large).push_back(k);
+        }
+        while (!small.empty() && !large.empty()) {
+            const uint32_t s = small.back();
+            small.pop_back();
+            const uint32_t l = large.back();
+            table_[s] = {to_threshold(p[s]), l};
+            p[l] -= 1.0 - p[s];
+            if (p[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // Leftovers are 1.0 up to rounding.
+        for (uint32_t k : large) table_[k] = {UINT32_MAX, k};
+        for (uint32_t k : small) table_[k] = {UINT32_MAX, k};
+    }
+
+    inline uint32_t nextValue(Xoshiro256& gen) const {
+        const uint64_t r = gen.next();
+        const uint32_t idx = (uint32_t)(((r >> 32) * num_keys_) >> 32);
+        const Entry e = table_[idx];
+        return ((uint32_t)r < e.threshold) ? idx : e.alias;
+    }
+
+    // Fill `out` with n draws; the RNG/index/compare steps are independent
+    // across draws so the loop pipelines (and vectorizes where gathers exist).
+    inline void fill(Xoshiro256& gen, uint32_t* out, int n) const {
+        uint64_t r[kBatch];
+        for (int i = 0; i < n; i++) r[i] = gen.next();
+        for (int i = 0; i < n; i++) {
+            const uint32_t idx = (uint32_t)(((r[i] >> 32) * num_keys_) >> 32);
+            const Entry e = table_[idx];
+            out[i] = ((uint32_t)r[i] < e.threshold) ? idx : e.alias;
+        }
+    }
+
+    static constexpr int kBatch = 16;
+
+    size_t table_bytes() const { return table_.size() * sizeof(Entry); }
+
+private:
+    static uint32_t to_threshold(double p) {
+        const double t = p * 4294967296.0;
+        return t >= 4294967295.0 ? UINT32_MAX : (uint32_t)t;
+    }
+
+    uint32_t num_keys_;
+    std::vector<Entry> table_;
+};
+
+// ---- Shifting hot set ------------------------------------------------------
+//
+// The generators always make the same pages hot. With --shift-every the main
+// thread bumps a shift counter every period, and each drawn page index is then
+// remapped to a new page. --shift-fraction=f moves only a fraction f of
+// the pages per shift. A seeded permutation puts the pages in a fixed order
+// that is cut into slices of round(f*n) pages (the last one may be shorter).
+// Shift e moves slice (e-1) mod #slices: its pages are permuted among
+// themselves with a key derived from e, and keep that placement until the
+// slice comes round again. Consecutive shifts therefore move disjoint slices,
+// and after 1/f shifts every page has moved once. Every remap is a bijection
+// on the pages, so the working set and the Zipf distribution are preserved.
+// Small periods and fractions give a slow, gradual drift. The exact moment and
+// size of each shift are logged, which gives hot_persistence a known answer:
+// across k shifts about min(1, k*f) of the hot set is replaced.
+class HotSetShift {
+public:
+    HotSetShift(uint32_t num_keys, double fraction, uint64_t seed)
+        : num_keys_(num_keys),
+          slice_((uint32_t)std::min<double>(num_keys, std::max(1.0, std::round(fraction * num_keys)))),
+          slices_((uint32_t)(((uint64_t)num_keys + slice_ - 1) / slice_)),
+          seed_(seed),
+          order_(num_keys, mix(seed)) {}
+
+    // Page that `page` maps to after `shift` shifts (shift 0 = no change).
+    inline uint32_t apply(uint32_t page, uint32_t shift) const {
+        if (shift == 0) return page;
+        if (slices_ == 1) return Scrambler(num_keys_, epoch_key(shift))(page);
+        const uint32_t pos = order_(page);
+        const uint32_t slice = pos / slice_;
+        if (shift - 1 < slice) return page;  // slice s first moves at shift s + 1
+        const uint32_t moved_at = shift - (shift - 1 - slice) % slices_;
+        const uint32_t base = slice * slice_;
+        const Scrambler within(slice_len(slice), epoch_key(moved_at));
+        return order_.inverse(base + within(pos - base));
+    }
+
+    // Fraction of the pages that shift `shift` moves.
+    double moved_fraction(uint32_t shift) const {
+        return (double)slice_len((shift - 1) % slices_) / (double)num_keys_;
+    }
+
+    // True if apply(., shift) is one-to-one on [0, num_keys).
+    bool is_permutation(uint32_t shift) const {
+        std::vector<bool> hit(num_keys_, false);
+        for (uint32_t p = 0; p < num_keys_; p++) {
+            const uint32_t q = apply(p, shift);
+            if (q >= num_keys_ || hit[q]) return false;
+            hit[q] = true;
+        }
+        return true;
+    }
+
+    double fraction() const { return (double)slice_ / (double)num_keys_; }
+
+private:
+    // splitmix64 finalizer.
+    static inline uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    uint64_t epoch_key(uint32_t shift) const { return mix(seed_ + shift * 0x9e3779b97f4a7c15ull); }
+
+    uint32_t slice_len(uint32_t slice) const { return std::min(slice_, num_keys_ - slice * slice_); }
+
+    uint32_t num_keys_;
+    uint32_t slice_;   // pages per slice
+    uint32_t slices_;  // shifts per full cycle
+    uint64_t seed_;
+    Scrambler order_;  // page -> position in slice order
+};
+
+// ---- Per-thread statistics ----------------------------------------------
+//
+// Each worker owns one cache-line-aligned ThreadStats slot and is its only
+// writer, so counting is a plain store to a line no other core writes. The
+// reporter thread reads all slots every --stats-interval-ms and writes the
+// interval deltas. Timestamps are CLOCK_MONOTONIC seconds: run_zipf_profile.sh
+// records with `perf record -k CLOCK_MONOTONIC`, so they match points.txt time.
+
+static inline uint64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Serialized TSC read (falls back to the monotonic clock off x86).
+static inline uint64_t read_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+    const uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+#else
+    return monotonic_ns();
+#endif
+}
+
+// Latency bucket b holds [2^b, 2^(b+1)) cycles (bucket 0 also holds 0).
+constexpr int kLatBuckets = 40;
+
+static inline int lat_bucket(uint64_t cycles) {
+    if (cycles == 0) return 0;
+    return std::min(kLatBuckets - 1, 63 - __builtin_clzll(cycles));
+}
+
+struct alignas(64) ThreadStats {
+    std::atomic<uint64_t> accesses{0};
+    std::atomic<uint64_t> writes{0};  // stores among accesses, set when the worker exits
+    std::atomic<uint64_t> sink{0};    // sum of loaded bytes, set when the worker exits
+    std::atomic<uint64_t> lat[kLatBuckets] = {};
+
+    // Single writer: no locked RMW needed.
+    static void add(std::atomic<uint64_t>& c, uint64_t d) {
+        c.store(c.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+    }
+};
+
+// Flags the main thread writes and every worker polls. They sit alone on
+// their own cache line, so the workers' reads never contend with stores to
+// anything else (their ThreadStats slots, the main thread's locals).
+struct alignas(64) RunControl {
+    std::atomic<bool> stop{false};
+    std::atomic<uint32_t> shifts{0};  // hot-set shifts so far (--shift-every)
+};
+
+// --false-sharing: every access also bumps a per-thread counter in a small
+// area after the Zipf objects. "shared" packs the counters 8 per cache line,
+// so threads on different cores keep stealing the line from each other (HITM
+// loads, RFO stores). "padded" gives each counter its own line: same
+// instructions, no coherence traffic. Comparing the two shows what false
+// sharing looks like in the heatmap and latency tooling.
+enum class FalseSharing { kOff, kShared, kPadded };
+
+static const char* false_sharing_name(FalseSharing f) {
+    switch (f) {
+        case FalseSharing::kOff: return "off";
+        case FalseSharing::kShared: return "shared";
+        case FalseSharing::kPadded: return "padded";
+    }
+    return "?";
+}
+
+struct StatsOptions {
+    std::string csv;        // per-thread ops/s per interval ("" = off)
+    std::string lat_csv;    // per-thread latency histograms per interval ("" = off)
+    int interval_ms = 1000;
+    uint32_t lat_every = 0; // time one access in this many (0 = off)
+};
+
+// Writes one row per thread per interval until `stop`, then a final partial
+// interval. Cycle buckets are converted to ns with a TSC rate measured against
+// CLOCK_MONOTONIC over the whole run so far.
+static void run_reporter(const ThreadStats* slots, int n, const StatsOptions& opt, FILE* tput, FILE* lat,
+                         const std::atomic<bool>& stop) {
+    const uint64_t c0 = read_cycles();
+    const uint64_t t0 = monotonic_ns();
+    std::vector<uint64_t> prev_acc((size_t)n, 0);
+    std::vector<uint64_t> prev_lat((size_t)n * kLatBuckets, 0);
+    uint64_t prev_t = t0;
+    auto next = std::chrono::steady_clock::now();
+    bool last = false;
+    while (!last) {
+        next += std::chrono::milliseconds(opt.interval_ms);
+        while (!stop.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::min(opt.interval_ms, 20)));
+        }
+        last = stop.load(std::memory_order_acquire);
+        const uint64_t t = monotonic_ns();
+        const uint64_t cyc = read_cycles();
+        const double now_sec = (double)t * 1e-9;
+        const double dt = (double)(t - prev_t) * 1e-9;
+        prev_t = t;
+        if (tput) {
+            for (int i = 0; i < n; i++) {
+                const uint64_t a = slots[i].accesses.load(std::memory_order_relaxed);
+                const uint64_t d = a - prev_acc[(size_t)i];
+                prev_acc[(size_t)i] = a;
+                std::fprintf(tput, "%.6f,%d,%.6f,%llu,%.1f\n", now_sec, i, dt, (unsigned long long)d,
+                             dt > 0 ? (double)d / dt : 0.0);
+            }
+            std::fflush(tput);
+        }
+        if (lat) {
+            const double ns_per_cycle = (t > t0 && cyc > c0) ? (double)(t - t0) / (double)(cyc - c0) : 1.0;
+            for (int i = 0; i < n; i++) {
+                for (int b = 0; b < kLatBuckets; b++) {
+                    const uint64_t c = slots[i].lat[b].load(std::memory_order_relaxed);
+                    uint64_t& p = prev_lat[(size_t)i * kLatBuckets + (size_t)b];
+                    if (c == p) continue;
+                    const uint64_t lo = b == 0 ? 0 : (1ull << b);
+                    const uint64_t hi = 1ull << (b + 1);
+                    std::fprintf(lat, "%.6f,%d,%llu,%llu,%.1f,%.1f,%llu\n", now_sec, i, (unsigned long long)lo,
+                                 (unsigned long long)hi, (double)lo * ns_per_cycle, (double)hi * ns_per_cycle,
+                                 (unsigned long long)(c - p));
+                    p = c;
+                }
+            }
+            std::fflush(lat);
+        }
+    }
+}
+
+// Upper bound for --mlp; far beyond any core's miss buffers.
+constexpr int kMaxMlp = 4096;
+
+static bool parse_flag(const char* arg, const char* name, const char** out_val) {
+    const size_t n = std::strlen(name);
+    if (std::strncmp(arg, name, n) != 0) return false;
+    if (arg[n] == '\0') {
+        *out_val = nullptr;
+        return true;
+    }
+    if (arg[n] != '=') return false;
+    *out_val = arg + n + 1;
+    return true;
+}
+
+static void usage(const char* argv0) {
+    std::cerr
+        << "Usage: " << argv0 << " [mem_mb] [zipf_alpha] [duration_sec] [threads] [cpu_start] [options]\n"
+        << "\n"
+        << "Positional args default to 1024 0.99 60 1 0 (zipf_alpha < 0.01 => uniform).\n"
+        << "\n"
+        << "Options:\n"
+        << "  --gen=legacy|fast        Page generator (default: legacy)\n"
+        << "                           legacy: std::pow per draw + FNV scramble, mt19937\n"
+        << "                           fast:   shared alias table + xoshiro256**, same distribution\n"
+        << "  --zeta=auto|exact|approx Zipf normalization: exact parallel sum, Euler-Maclaurin,\n"
+        << "                           or auto (exact up to 1M pages; default)\n"
+        << "  --zeta-cache=<file>      Reuse/append zeta(n, theta) values in this file\n"
+        << "  --populate=MODE          How pages are faulted in before the run (default: serial)\n"
+        << "                           serial:        main thread touches every page\n"
+        << "                           parallel:      each pinned worker first-touches its share\n"
+        << "                           madv_populate: like parallel, via MADV_POPULATE_WRITE\n"
+        << "                           map_populate:  MAP_POPULATE at mmap time\n"
+        << "  --page-backing=4k|thp|huge2m|huge1g\n"
+        << "                           Page size of the region (default: 4k). Zipf ranks index\n"
+        << "                           pages of this size unless --object-size is given.\n"
+        << "                           thp: MADV_HUGEPAGE, huge2m/huge1g: MAP_HUGETLB\n"
+        << "  --numa=local|interleave[:N]|bind:N|split:R[:F,S]\n"
+        << "                           NUMA placement via mbind (default: local = first touch).\n"
+        << "                           split:0.2 puts the first 20% of pages on the fast node F\n"
+        << "                           and the rest on the slow node S (default: CPU node and\n"
+        << "                           first memory-only node). N is a node list like 0,2-3\n"
+        << "  --object-size=<bytes>    Zipf over objects of this size (multiple of 64; default:\n"
+        << "                           one page of --page-backing)\n"
+        << "  --lines-per-access=<n>   Cache lines touched per access, from the object start\n"
+        << "                           (default: min(64, object lines); 1 under --mlp=chase)\n"
+        << "  --write-ratio=<f>        Fraction of accesses that store to their lines instead\n"
+        << "                           of loading (default: 0)\n"
+        << "  --mlp=<n>|chase          Outstanding misses per thread. n>0: draw n keys ahead and\n"
+        << "                           prefetch them before the access (bandwidth-bound). chase:\n"
+        << "                           each address depends on the previous load, so one miss\n"
+        << "                           at a time (latency-bound; one line per access).\n"
+        << "                           Default 0: draw, then touch\n"
+        << "  --false-sharing=off|shared|padded\n"
+        << "                           Also bump a per-thread counter on every access, with the\n"
+        << "                           counters packed in shared lines or one per line\n"
+        << "                           (default: off). The counters sit after the objects\n"
+        << "  --shift-every=<sec>      Move the hot set every <sec> seconds (default: 0 = static)\n"
+        << "  --shift-fraction=<f>     Fraction of pages remapped per shift (default: 1); each\n"
+        << "                           shift moves a new slice, so small values drift gradually\n"
+        << "  --shift-log=<file>       Also log shifts as CSV (time_sec,shift,fraction)\n"
+        << "  --stats-csv=<file>       Per-thread accesses and ops/s per interval\n"
+        << "                           (time_sec,thread,interval_sec,accesses,ops_per_sec)\n"
+        << "  --stats-interval-ms=<ms> Reporting interval (default: 1000)\n"
+        << "  --lat-csv=<file>         Per-thread access latency histograms per interval\n"
+        << "                           (time_sec,thread,lo_cycles,hi_cycles,lo_ns,hi_ns,count)\n"
+        << "  --lat-sample=<N>         Time one page access in N with rdtsc (default: 1024\n"
+        << "                           when --lat-csv is given)\n"
+        << "  --json=<file>            Write a JSON summary (config, mapping, timestamps, results,\n"
+        << "                           per-thread stats) on exit\n"
+        << "  --ready-file=<path>      When the workers start, write \"ready pid= time_sec= addr_lo=\n"
+        << "                           addr_hi=\" to <path> (a FIFO, or a file created by rename)\n"
+        << "  time_sec is CLOCK_MONOTONIC, i.e. perf time under `perf record -k CLOCK_MONOTONIC`.\n";
+}
+
 int main(int argc, char* argv[]) {
     size_t mem_size_mb = 1024; // Default 1GB
     double zipf_alpha = 0.99;
     int duration_sec = 60;
     int num_threads = 1;
     int cpu_start = 0;
-    
-    if (argc > 1) mem_size_mb = std::stoul(argv[1]);
-    if (argc > 2) zipf_alpha = std::stod(argv[2]);
-    if (argc > 3) duration_sec = std::stoi(argv[3]);
-    if (argc > 4) num_threads = std::max(1, std::stoi(argv[4]));
-    if (argc > 5) cpu_start = std::max(0, std::stoi(argv[5]));
+    bool fast_gen = false;
+    ZetaMode zeta_mode = ZetaMode::kAuto;
+    std::string zeta_cache;
+    bench_memory::Populate populate = bench_memory::Populate::kSerial;
+    bench_memory::Backing backing = bench_memory::Backing::k4k;
+    bench_memory::NumaPolicy numa;
+    StatsOptions stats;
+    long long lat_sample = -1;
+    size_t object_size = 0;      // 0 => one page
+    long lines_per_access = 0;   // 0 => min(64, object lines)
+    double write_ratio = 0.0;
+    FalseSharing false_sharing = FalseSharing::kOff;
+    int mlp = 0;                 // keys drawn and prefetched ahead (0 => off)
+    bool chase = false;          // dependent accesses, one miss at a time
+    double shift_every_sec = 0.0;
+    double shift_fraction = 1.0;
+    std::string shift_log;
+    std::string json_path;
+    std::string ready_file;
 
-    size_t num_pages = (mem_size_mb * 1024 * 1024) / PAGE_SIZE;
-    size_t total_size = num_pages * PAGE_SIZE;
+    // Positional args first (kept for the run scripts), then --options.
+    int npos = 0;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = nullptr;
+        if (std::strcmp(a, "--help") == 0 || std::strcmp(a, "-h") == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (parse_flag(a, "--gen", &v) && v) {
+            if (std::strcmp(v, "legacy") == 0) {
+                fast_gen = false;
+            } else if (std::strcmp(v, "fast") == 0) {
+                fast_gen = true;
+            } else {
+                std::cerr << "Invalid --gen: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--zeta", &v) && v) {
+            if (std::strcmp(v, "auto") == 0) {
+                zeta_mode = ZetaMode::kAuto;
+            } else if (std::strcmp(v, "exact") == 0) {
+                zeta_mode = ZetaMode::kExact;
+            } else if (std::strcmp(v, "approx") == 0) {
+                zeta_mode = ZetaMode::kApprox;
+            } else {
+                std::cerr << "Invalid --zeta: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--zeta-cache", &v) && v) {
+            zeta_cache = v;
+            continue;
+        }
+        if (parse_flag(a, "--page-backing", &v) && v) {
+            if (!bench_memory::parse_backing(v, &backing)) {
+                std::cerr << "Invalid --page-backing: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--numa", &v) && v) {
+            if (!bench_memory::parse_numa(v, &numa)) {
+                std::cerr << "Invalid --numa: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--object-size", &v) && v) {
+            object_size = std::strtoull(v, nullptr, 10);
+            if (object_size == 0 || object_size % 64 != 0) {
+                std::cerr << "Invalid --object-size (need a multiple of 64): " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--lines-per-access", &v) && v) {
+            lines_per_access = std::atol(v);
+            if (lines_per_access <= 0) {
+                std::cerr << "Invalid --lines-per-access: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--write-ratio", &v) && v) {
+            write_ratio = std::atof(v);
+            if (!(write_ratio >= 0.0 && write_ratio <= 1.0)) {
+                std::cerr << "Invalid --write-ratio: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--false-sharing", &v) && v) {
+            if (std::strcmp(v, "off") == 0) {
+                false_sharing = FalseSharing::kOff;
+            } else if (std::strcmp(v, "shared") == 0) {
+                false_sharing = FalseSharing::kShared;
+            } else if (std::strcmp(v, "padded") == 0) {
+                false_sharing = FalseSharing::kPadded;
+            } else {
+                std::cerr << "Invalid --false-sharing: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--mlp", &v) && v) {
+            if (std::strcmp(v, "chase") == 0) {
+                chase = true;
+                mlp = 0;
+            } else {
+                char* end = nullptr;
+                const long n = std::strtol(v, &end, 10);
+                if (*end != '\0' || n < 0 || n > kMaxMlp) {
+                    std::cerr << "Invalid --mlp (0.." << kMaxMlp << " or chase): " << v << std::endl;
+                    return 1;
+                }
+                chase = false;
+                mlp = (int)n;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--shift-every", &v) && v) {
+            shift_every_sec = std::atof(v);
+            if (!(shift_every_sec >= 0.0)) {
+                std::cerr << "Invalid --shift-every: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--shift-fraction", &v) && v) {
+            shift_fraction = std::atof(v);
+            if (!(shift_fraction > 0.0 && shift_fraction <= 1.0)) {
+                std::cerr << "Invalid --shift-fraction: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--json", &v) && v) {
+            json_path = v;
+            continue;
+        }
+        if (parse_flag(a, "--ready-file", &v) && v) {
+            ready_file = v;
+            continue;
+        }
+        if (parse_flag(a, "--shift-log", &v) && v) {
+            shift_log = v;
+            continue;
+        }
+        if (parse_flag(a, "--stats-csv", &v) && v) {
+            stats.csv = v;
+            continue;
+        }
+        if (parse_flag(a, "--stats-interval-ms", &v) && v) {
+            stats.interval_ms = std::atoi(v);
+            if (stats.interval_ms <= 0) {
+                std::cerr << "Invalid --stats-interval-ms: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--lat-csv", &v) && v) {
+            stats.lat_csv = v;
+            continue;
+        }
+        if (parse_flag(a, "--lat-sample", &v) && v) {
+            lat_sample = std::atoll(v);
+            if (lat_sample < 0 || lat_sample > UINT32_MAX) {
+                std::cerr << "Invalid --lat-sample: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (parse_flag(a, "--populate", &v) && v) {
+            if (!bench_memory::parse_populate(v, &populate)) {
+                std::cerr << "Invalid --populate: " << v << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        if (std::strncmp(a, "--", 2) == 0) {
+            std::cerr << "Unknown arg: " << a << std::endl;
+            usage(argv[0]);
+            return 1;
+        }
+        switch (npos++) {
+            case 0: mem_size_mb = std::stoul(a); break;
+            case 1: zipf_alpha = std::stod(a); break;
+            case 2: duration_sec = std::stoi(a); break;
+            case 3: num_threads = std::max(1, std::stoi(a)); break;
+            case 4: cpu_start = std::max(0, std::stoi(a)); break;
+            default:
+                std::cerr << "Too many positional args" << std::endl;
+                usage(argv[0]);
+                return 1;
+        }
+    }
 
-    std::cout << "Allocating " << mem_size_mb << " MB (" << num_pages << " pages)..." << std::endl;
     std::cout << "Zipfian constant: " << zipf_alpha << std::endl;
     std::cout << "Duration: " << duration_sec << " seconds" << std::endl;
     std::cout << "Threads: " << num_threads << " (cpu_start=" << cpu_start << ")" << std::endl;
 
-    // Use mmap to ensure we get a clean anonymous mapping
-    char* memory = (char*)mmap(NULL, total_size, PROT_READ | PROT_WRITE, 
-                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    
-    if (memory == MAP_FAILED) {
-        std::cerr << "mmap failed" << std::endl;
+    std::string err;
+    if (!bench_memory::resolve_numa(&numa, &err)) {
+        std::cerr << err << std::endl;
         return 1;
     }
+    std::cout << "NUMA policy: " << bench_memory::numa_name(numa) << std::endl;
 
-    // Touch all pages once to fault them in
-    std::cout << "Populating memory (" << (void*)memory << " - " << (void*)(memory + total_size) << ")..." << std::endl;
-    for (size_t i = 0; i < num_pages; i++) {
-        memory[i * PAGE_SIZE] = 1;
+    // Use mmap to ensure we get a clean anonymous mapping. By default the Zipf
+    // ranks index pages of the backing's size, so huge pages mean fewer, larger
+    // hot items; --object-size makes them sub-page (or multi-page) objects.
+    // With --false-sharing the counters get their own page(s) at the end of
+    // the same mapping, so they fall inside the heap range the tooling plots.
+    const size_t share_stride = false_sharing == FalseSharing::kShared ? sizeof(uint64_t) : 64;
+    const size_t share_want = false_sharing == FalseSharing::kOff ? 0 : (size_t)num_threads * share_stride;
+    bench_memory::Region region;
+    if (!bench_memory::map_region(mem_size_mb * 1024 * 1024 + share_want, backing, populate, numa, &region, &err)) {
+        std::cerr << err << std::endl;
+        return 1;
     }
+    if (!region.note.empty()) std::cerr << "--page-backing: " << region.note << std::endl;
+    char* memory = region.base;
+    const size_t page_size = region.page;
+    const size_t share_bytes = share_want == 0 ? 0 : bench_memory::round_up(share_want, page_size);
+    if (share_bytes >= region.bytes) {
+        std::cerr << "--false-sharing: mapping too small for the counter area" << std::endl;
+        return 1;
+    }
+    const size_t total_size = region.bytes - share_bytes;
+    char* const share_area = share_bytes ? memory + total_size : nullptr;
+    const size_t num_pages = total_size / page_size;
+    std::cout << "Allocating " << (total_size >> 20) << " MB (" << num_pages << " pages of "
+              << (page_size >> 10) << " KiB)..." << std::endl;
+    if (object_size == 0) object_size = page_size;
+    const size_t num_objects = total_size / object_size;
+    const size_t object_lines = object_size / 64;
+    if (num_objects == 0 || num_objects > (size_t)INT32_MAX) {
+        std::cerr << "--object-size=" << object_size << " gives " << num_objects
+                  << " objects; need 1.." << INT32_MAX << std::endl;
+        return 1;
+    }
+    if (chase && lines_per_access > 1) {
+        // Only the first line carries the dependency; further lines would
+        // miss in parallel and the chase would no longer be one at a time.
+        std::cerr << "--mlp=chase touches one line per access; drop --lines-per-access="
+                  << lines_per_access << std::endl;
+        return 1;
+    }
+    if (lines_per_access == 0) lines_per_access = chase ? 1 : (long)std::min<size_t>(64, object_lines);
+    if ((size_t)lines_per_access > object_lines) {
+        std::cerr << "--lines-per-access=" << lines_per_access << " exceeds the " << object_lines
+                  << " lines of a " << object_size << " B object" << std::endl;
+        return 1;
+    }
+    std::cout << "Objects: " << num_objects << " x " << object_size << " B, " << lines_per_access
+              << " lines per access, write_ratio=" << write_ratio << std::endl;
+    if (share_area) {
+        std::cout << "False sharing: " << false_sharing_name(false_sharing) << " (" << num_threads << " counters, "
+                  << share_stride << " B apart, at " << (void*)share_area << " - "
+                  << (void*)(share_area + share_want) << ")" << std::endl;
+    }
+    std::cout << "MLP: " << (chase ? std::string("chase (dependent, 1 outstanding)")
+                                   : mlp == 0 ? std::string("off") : std::to_string(mlp) + " keys ahead")
+              << std::endl;
+
+    // Fault all pages in. Accesses are spread over the whole region by every
+    // thread, so the parallel modes just split it evenly across the workers.
+    std::cout << "Populating memory (" << (void*)memory << " - " << (void*)(memory + region.bytes) << ")..." << std::endl;
+    auto populate_t0 = std::chrono::steady_clock::now();
+    const std::string populate_note = bench_memory::populate(
+        bench_memory::split_even(memory, region.bytes, num_threads, page_size), populate, cpu_start);
+    if (!populate_note.empty()) std::cerr << "--populate: " << populate_note << std::endl;
+    const auto populate_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - populate_t0).count();
+    std::cout << "Populate: " << bench_memory::populate_name(populate) << " (" << populate_ms << " ms)" << std::endl;
+    const std::string backing_str = bench_memory::backing_report(region);
+    const std::string numa_str = bench_memory::numa_report(region);
+    std::cout << "Page backing: " << backing_str << std::endl;
+    std::cout << "NUMA pages: " << numa_str << std::endl;
 
     // Initialize generator
     // Using sorted=false to scatter hot pages (random-looking access pattern)
@@ -136,74 +1017,390 @@ int main(int argc, char* argv[]) {
     // Hack to support Uniform distribution for testing
     bool use_uniform = (zipf_alpha < 0.01);
     
-    ZipfianGenerator<false> zipf(num_pages, use_uniform ? 0.99 : zipf_alpha);
-    std::mt19937 gen(std::random_device{}());
-    std::uniform_int_distribution<int> uniform_dist(0, num_pages - 1);
+    const double theta = use_uniform ? 0.99 : zipf_alpha;
+    const char* zeta_how = "";
+    auto zeta_t0 = std::chrono::steady_clock::now();
+    const int zeta_threads = std::max(num_threads, (int)std::thread::hardware_concurrency());
+    const double zetan = compute_zeta(num_objects, theta, zeta_mode, zeta_threads, zeta_cache, &zeta_how);
+    std::cout << "zeta(" << num_objects << ", " << theta << ") = " << zetan << " (" << zeta_how << ", "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - zeta_t0).count()
+              << " ms)" << std::endl;
+
+    // The alias table reproduces the legacy mapping, which is only defined for
+    // 0 < theta < 1.
+    if (fast_gen && !use_uniform && !(zipf_alpha > 0.0 && zipf_alpha < 1.0)) {
+        std::cerr << "--gen=fast needs 0 < zipf_alpha < 1; using legacy generator" << std::endl;
+        fast_gen = false;
+    }
+    std::unique_ptr<FastZipfianGenerator> fast_zipf;
+    if (fast_gen && !use_uniform) {
+        auto t0 = std::chrono::steady_clock::now();
+        fast_zipf.reset(new FastZipfianGenerator((uint32_t)num_objects, zipf_alpha, zetan));
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+        std::cout << "Generator: fast (alias table " << (fast_zipf->table_bytes() >> 20) << " MB, built in "
+                  << ms << " ms)" << std::endl;
+    } else {
+        std::cout << "Generator: " << (fast_gen ? "fast" : "legacy") << std::endl;
+    }
 
+    std::unique_ptr<HotSetShift> hot_shift;
+    FILE* shift_csv = nullptr;
+    if (shift_every_sec > 0.0) {
+        hot_shift.reset(new HotSetShift((uint32_t)num_objects, shift_fraction, std::random_device{}()));
+        // The first two shifts cover both moved and not-yet-moved slices.
+        for (uint32_t e = 1; e <= 2; e++) {
+            if (!hot_shift->is_permutation(e)) {
+                std::cerr << "Internal error: hot set shift " << e << " is not one-to-one" << std::endl;
+                return 1;
+            }
+        }
+        std::cout << "Hot set: shifting " << hot_shift->fraction() << " of pages every " << shift_every_sec
+                  << " sec" << std::endl;
+        if (!shift_log.empty()) {
+            shift_csv = std::fopen(shift_log.c_str(), "w");
+            if (!shift_csv) {
+                std::cerr << "Cannot open " << shift_log << ": " << std::strerror(errno) << std::endl;
+                return 1;
+            }
+            std::fprintf(shift_csv, "time_sec,shift,fraction\n");
+        }
+    }
+
+    const double ready_sec = bench_report::monotonic_sec();
     std::cout << "Starting benchmark (PID: " << getpid() << ")..." << std::endl;
     if (use_uniform) std::cout << "Mode: UNIFORM (sanity check)" << std::endl;
 
-    auto start_time = std::chrono::steady_clock::now();
-    std::atomic<bool> stop{false};
-    std::atomic<uint64_t> accesses_total{0};
+    // Per-thread slots and the optional reporter.
+    std::unique_ptr<ThreadStats[]> slots(new ThreadStats[(size_t)num_threads]);
+    stats.lat_every = stats.lat_csv.empty() ? 0 : (lat_sample < 0 ? 1024u : (uint32_t)lat_sample);
+    FILE* tput_csv = nullptr;
+    FILE* lat_csv = nullptr;
+    if (!stats.csv.empty()) {
+        tput_csv = std::fopen(stats.csv.c_str(), "w");
+        if (!tput_csv) {
+            std::cerr << "Cannot open " << stats.csv << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        std::fprintf(tput_csv, "time_sec,thread,interval_sec,accesses,ops_per_sec\n");
+    }
+    if (!stats.lat_csv.empty()) {
+        lat_csv = std::fopen(stats.lat_csv.c_str(), "w");
+        if (!lat_csv) {
+            std::cerr << "Cannot open " << stats.lat_csv << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        std::fprintf(lat_csv, "time_sec,thread,lo_cycles,hi_cycles,lo_ns,hi_ns,count\n");
+        std::cout << "Latency sampling: 1 in " << stats.lat_every << " accesses" << std::endl;
+    }
 
-    auto pin_to_cpu = [](int cpu) {
-        cpu_set_t set;
-        CPU_ZERO(&set);
-        CPU_SET(cpu, &set);
-        (void)pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
-    };
+    auto start_time = std::chrono::steady_clock::now();
+    RunControl ctl;
+    std::atomic<bool> reporter_stop{false};
+    std::thread reporter;
+    if (tput_csv || lat_csv) {
+        reporter = std::thread(run_reporter, slots.get(), num_threads, std::cref(stats), tput_csv, lat_csv,
+                               std::cref(reporter_stop));
+    }
 
     auto worker = [&](int tid) {
         // Pin each thread to a different CPU to scale sampling across cores.
-        pin_to_cpu(cpu_start + tid);
-
-        std::mt19937 lgen(std::random_device{}() + tid * 1337);
-        ZipfianGenerator<false> lzipf((int)num_pages, use_uniform ? 0.99 : zipf_alpha);
-        std::uniform_int_distribution<int> luniform(0, (int)num_pages - 1);
+        bench_memory::pin_to_cpu(cpu_start + tid);
 
-        volatile char val;
+        // Everything a worker writes per access is either in registers/its own
+        // stack or in its own ThreadStats slot; loads are summed into `sink`
+        // rather than stored to a volatile, so they add no stores.
+        ThreadStats& st = slots[(size_t)tid];
+        uint64_t sink = 0;
+        volatile uint64_t* const share_ctr =
+            share_area ? reinterpret_cast<volatile uint64_t*>(share_area + (size_t)tid * share_stride) : nullptr;
         uint64_t local_accesses = 0;
+        uint64_t local_writes = 0;
+        const uint32_t lat_every = stats.lat_every;
+        uint32_t lat_countdown = lat_every;
+        const long lines = lines_per_access;
+        // Store iff the top 32 bits of a per-thread xorshift draw fall below
+        // write_cut; kept apart from the key RNG so the key stream is unchanged.
+        const uint64_t write_cut = (uint64_t)(write_ratio * 4294967296.0);
+        uint64_t wstate = 0x9e3779b97f4a7c15ull * (uint64_t)(tid + 1);
 
-        while (!stop.load(std::memory_order_relaxed)) {
-            int page_idx;
-            if (use_uniform) {
-                page_idx = luniform(lgen);
+        auto touch = [&](char* obj, bool is_write) {
+            if (is_write) {
+                volatile char* w = obj;
+                for (long j = 0; j < lines; j++) {
+                    w[j * 64] = (char)j;
+                }
+            } else {
+                for (long j = 0; j < lines; j++) {
+                    sink += (unsigned char)obj[j * 64];
+                }
+            }
+            if (share_ctr) *share_ctr = *share_ctr + 1;
+        };
+
+        // One access loads (or, for --write-ratio of them, stores) the first
+        // `lines` cache lines of the object; every lat_every-th one is timed
+        // with the TSC.
+        auto access = [&](size_t obj_idx) {
+            char* obj = memory + obj_idx * object_size;
+            bool is_write = false;
+            if (write_cut != 0) {
+                wstate ^= wstate << 13;
+                wstate ^= wstate >> 7;
+                wstate ^= wstate << 17;
+                is_write = (wstate >> 32) < write_cut;
+                local_writes += is_write;
+            }
+            if (lat_every != 0 && --lat_countdown == 0) {
+                lat_countdown = lat_every;
+                const uint64_t c0 = read_cycles();
+                touch(obj, is_write);
+                ThreadStats::add(st.lat[lat_bucket(read_cycles() - c0)], 1);
+                return;
+            }
+            touch(obj, is_write);
+        };
+
+        // Route every drawn key through issue(). With --mlp=n the key is
+        // prefetched and parked in a ring, and the key from n draws ago is
+        // accessed, so up to n objects are in flight. With --mlp=chase the
+        // key is offset by a value loaded from the previous object. The value
+        // is always 0, but the compiler cannot see that, so each address
+        // waits for the previous load to complete.
+        std::vector<uint32_t> ring((size_t)std::max(mlp, 1));
+        size_t ring_pos = 0;
+        size_t ring_fill = 0;
+        uint64_t chase_dep = 0;
+        auto issue = [&](uint32_t obj_idx) {
+            if (chase) {
+                obj_idx += (uint32_t)chase_dep;
+                const char* obj = memory + (size_t)obj_idx * object_size;
+                uint64_t zero = 0;
+                asm volatile("" : "+r"(zero));
+                chase_dep = (uint64_t)*(const volatile unsigned char*)obj & zero;
+                access(obj_idx);
+                return;
+            }
+            if (mlp == 0) {
+                access(obj_idx);
+                return;
+            }
+            const char* obj = memory + (size_t)obj_idx * object_size;
+            for (long j = 0; j < lines; j++) __builtin_prefetch(obj + j * 64);
+            if (ring_fill == ring.size()) {
+                access(ring[ring_pos]);
             } else {
-                page_idx = lzipf(lgen);
+                ring_fill++;
+            }
+            ring[ring_pos] = obj_idx;
+            ring_pos = (ring_pos + 1 == ring.size()) ? 0 : ring_pos + 1;
+        };
+        auto drain = [&]() {
+            for (size_t k = 0; k < ring_fill; k++) access(ring[k]);
+            ring_fill = 0;
+        };
+
+        if (fast_gen) {
+            Xoshiro256 xgen(std::random_device{}() + (uint64_t)tid * 1337);
+            uint32_t batch[FastZipfianGenerator::kBatch];
+            while (!ctl.stop.load(std::memory_order_relaxed)) {
+                if (fast_zipf) {
+                    fast_zipf->fill(xgen, batch, FastZipfianGenerator::kBatch);
+                } else {
+                    for (auto& b : batch) b = xgen.below((uint32_t)num_objects);
+                }
+                if (hot_shift) {
+                    const uint32_t sh = ctl.shifts.load(std::memory_order_relaxed);
+                    for (auto& b : batch) b = hot_shift->apply(b, sh);
+                }
+                for (uint32_t obj_idx : batch) {
+                    issue(obj_idx);
+                }
+                local_accesses += FastZipfianGenerator::kBatch;
+                st.accesses.store(local_accesses, std::memory_order_relaxed);
             }
-            if (page_idx >= (int)num_pages) page_idx = page_idx % (int)num_pages;
+            drain();
+            st.writes.store(local_writes, std::memory_order_relaxed);
+            st.sink.store(sink, std::memory_order_relaxed);
+            return;
+        }
+
+        std::mt19937 lgen(std::random_device{}() + tid * 1337);
+        ZipfianGenerator<false> lzipf((int)num_objects, theta, zetan);
+        std::uniform_int_distribution<int> luniform(0, (int)num_objects - 1);
 
-            char* page_ptr = memory + (size_t)page_idx * PAGE_SIZE;
-            for (int j = 0; j < 64; j++) {
-                val = page_ptr[j * 64];
+        while (!ctl.stop.load(std::memory_order_relaxed)) {
+            int obj_idx;
+            if (use_uniform) {
+                obj_idx = luniform(lgen);
+            } else {
+                obj_idx = lzipf(lgen);
             }
-            (void)val;
+            if (obj_idx >= (int)num_objects) obj_idx = obj_idx % (int)num_objects;
+            if (hot_shift) {
+                obj_idx = (int)hot_shift->apply((uint32_t)obj_idx, ctl.shifts.load(std::memory_order_relaxed));
+            }
+
+            issue((uint32_t)obj_idx);
             local_accesses++;
+            st.accesses.store(local_accesses, std::memory_order_relaxed);
         }
-        accesses_total.fetch_add(local_accesses, std::memory_order_relaxed);
+        drain();
+        st.writes.store(local_writes, std::memory_order_relaxed);
+        st.sink.store(sink, std::memory_order_relaxed);
     };
 
+    // The ready signal goes out just before the workers start, so a runner
+    // blocked on the FIFO attaches perf as the hot loop begins.
+    const double start_sec = bench_report::monotonic_sec();
+    if (!ready_file.empty()) {
+        std::string ready_err;
+        if (!bench_report::signal_ready(ready_file, bench_report::ready_line(start_sec, memory, memory + region.bytes),
+                                        &ready_err)) {
+            std::cerr << "--ready-file: " << ready_err << std::endl;
+        }
+    }
     std::vector<std::thread> threads;
     threads.reserve((size_t)num_threads);
     for (int t = 0; t < num_threads; t++) {
         threads.emplace_back(worker, t);
     }
 
-    // Sleep until duration elapses, then stop all workers.
+    // Sleep until duration elapses, shifting the hot set on schedule, then
+    // stop all workers.
+    const auto end_time = start_time + std::chrono::seconds(duration_sec);
+    const auto shift_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(shift_every_sec));
+    auto next_shift = start_time + shift_period;
+    std::vector<double> shift_times;
     while (true) {
         auto now = std::chrono::steady_clock::now();
-        if (std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count() >= duration_sec) {
-            break;
+        if (now >= end_time) break;
+        if (hot_shift && now >= next_shift) {
+            const uint32_t n = ctl.shifts.load(std::memory_order_relaxed) + 1;
+            ctl.shifts.store(n, std::memory_order_relaxed);
+            const double t = (double)monotonic_ns() * 1e-9;
+            std::cout << "Hot set shift " << n << " at " << std::fixed << std::setprecision(6) << t
+                      << std::defaultfloat << " (CLOCK_MONOTONIC): moved " << hot_shift->moved_fraction(n)
+                      << " of pages" << std::endl;
+            shift_times.push_back(t);
+            if (shift_csv) {
+                std::fprintf(shift_csv, "%.6f,%u,%g\n", t, n, hot_shift->moved_fraction(n));
+                std::fflush(shift_csv);
+            }
+            next_shift += shift_period;
+            continue;
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        auto wake = now + std::chrono::milliseconds(50);
+        if (hot_shift) wake = std::min(wake, next_shift);
+        std::this_thread::sleep_until(std::min(wake, end_time));
     }
-    stop.store(true, std::memory_order_relaxed);
+    ctl.stop.store(true, std::memory_order_relaxed);
     for (auto& th : threads) th.join();
+    const double end_sec = bench_report::monotonic_sec();
+    // The reporter's last row covers everything up to the join.
+    reporter_stop.store(true, std::memory_order_release);
+    if (reporter.joinable()) reporter.join();
+    if (tput_csv) std::fclose(tput_csv);
+    if (lat_csv) std::fclose(lat_csv);
+    if (shift_csv) std::fclose(shift_csv);
 
-    std::cout << "Finished. Total accesses: " << accesses_total.load() << std::endl;
+    uint64_t accesses_total = 0;
+    uint64_t writes_total = 0;
+    for (int t = 0; t < num_threads; t++) {
+        accesses_total += slots[(size_t)t].accesses.load();
+        writes_total += slots[(size_t)t].writes.load();
+    }
+    std::cout << "Finished. Total accesses: " << accesses_total;
+    if (write_ratio > 0.0) std::cout << " (writes: " << writes_total << ")";
+    std::cout << std::endl;
+    std::cout << "Throughput: " << std::fixed << std::setprecision(0)
+              << (double)accesses_total / std::max(1, duration_sec) << std::defaultfloat << " ops/s" << std::endl;
+    if (accesses_total > 0) {
+        // Thread-time per access: the load-to-use latency of one line under
+        // --mlp=chase, the inverse per-thread rate otherwise.
+        std::cout << (chase ? "Load-to-use latency: " : "Time per access: ") << std::fixed
+                  << std::setprecision(1)
+                  << (double)duration_sec * num_threads * 1e9 / (double)accesses_total << std::defaultfloat
+                  << " ns/thread" << std::endl;
+    }
+
+    if (!json_path.empty()) {
+        const double run_sec = end_sec - start_sec;
+        bench_report::Json j;
+        j.begin_object();
+        j.field("benchmark", "zipf_bench").field("pid", (int)getpid());
+        j.begin_object("config")
+            .field("mem_mb", mem_size_mb)
+            .field("zipf_alpha", zipf_alpha)
+            .field("uniform", use_uniform)
+            .field("duration_sec", duration_sec)
+            .field("threads", num_threads)
+            .field("cpu_start", cpu_start)
+            .field("gen", fast_gen ? "fast" : "legacy")
+            .field("populate", bench_memory::populate_name(populate))
+            .field("page_backing", bench_memory::backing_name(region.backing))
+            .field("numa", bench_memory::numa_name(numa))
+            .field("object_size", object_size)
+            .field("lines_per_access", lines_per_access)
+            .field("write_ratio", write_ratio)
+            .field("false_sharing", false_sharing_name(false_sharing))
+            .field("mlp", chase ? std::string("chase") : std::to_string(mlp))
+            .field("shift_every_sec", shift_every_sec)
+            .field("shift_fraction", shift_fraction)
+            .field("lat_sample", stats.lat_every)
+            .end_object();
+        j.begin_object("mapping")
+            .field("addr_lo", bench_report::hex_addr(memory))
+            .field("addr_hi", bench_report::hex_addr(memory + region.bytes))
+            .field("bytes", region.bytes)
+            .field("object_bytes", total_size)
+            .field("page_bytes", page_size)
+            .field("objects", num_objects)
+            .field("page_backing", backing_str)
+            .field("numa_pages", numa_str)
+            .field("populate_ms", (long long)populate_ms)
+            .field("false_sharing_lo", share_area ? bench_report::hex_addr(share_area) : std::string())
+            .field("false_sharing_hi", share_area ? bench_report::hex_addr(share_area + share_want) : std::string())
+            .end_object();
+        j.begin_object("timestamps")
+            .field("clock", "CLOCK_MONOTONIC")
+            .field("ready_sec", ready_sec)
+            .field("start_sec", start_sec)
+            .field("end_sec", end_sec)
+            .end_object();
+        j.field("zeta", zetan);
+        j.begin_object("results")
+            .field("accesses", accesses_total)
+            .field("writes", writes_total)
+            .field("run_sec", run_sec)
+            .field("ops_per_sec", run_sec > 0 ? (double)accesses_total / run_sec : 0.0)
+            .field("ns_per_access_per_thread",
+                   accesses_total > 0 ? run_sec * num_threads * 1e9 / (double)accesses_total : 0.0)
+            .end_object();
+        j.begin_array("per_thread");
+        for (int t = 0; t < num_threads; t++) {
+            const uint64_t acc = slots[(size_t)t].accesses.load();
+            j.begin_object()
+                .field("thread", t)
+                .field("cpu", cpu_start + t)
+                .field("accesses", acc)
+                .field("writes", slots[(size_t)t].writes.load())
+                .field("ops_per_sec", run_sec > 0 ? (double)acc / run_sec : 0.0)
+                .end_object();
+        }
+        j.end_array();
+        j.begin_array("shift_times_sec");
+        for (double t : shift_times) j.value(t);
+        j.end_array();
+        j.end_object();
+        std::string json_err;
+        if (!bench_report::write_file_atomic(json_path, j.str() + "\n", &json_err)) {
+            std::cerr << "--json: " << json_err << std::endl;
+            return 1;
+        }
+    }
 
-    munmap(memory, total_size);
+    region.unmap();
     return 0;
 }
 